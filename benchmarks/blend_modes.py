@@ -0,0 +1,70 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+""" Times filling a canvas sized ellipse with each ``BlendMode``. Modes with
+vectorized span compositing run several times faster than the others, which
+go through AGG's generic compositing.
+"""
+import argparse
+import timeit
+
+import numpy as np
+
+import celiagg as agg
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-r', '--repeat', type=int, default=5)
+    parser.add_argument('--size', type=int, default=1000)
+    args = parser.parse_args()
+
+    size = args.size
+    canvas = agg.CanvasRGBA32(np.zeros((size, size, 4), dtype=np.uint8))
+    path = agg.Path()
+    path.ellipse(size / 2, size / 2, size / 2 - 1, size / 2 - 1)
+    transform = agg.Transform()
+    paints = (
+        agg.SolidPaint(0.2, 0.6, 1.0, 0.5),
+        agg.LinearGradientPaint(
+            0, 0, size, 0,
+            [(0.0, 1.0, 0.2, 0.0, 0.3), (1.0, 0.0, 0.5, 1.0, 0.9)],
+            agg.GradientSpread.SpreadPad, agg.GradientUnits.UserSpace,
+        ),
+    )
+
+    for mode in agg.BlendMode:
+        gs = agg.GraphicsState(blend_mode=mode,
+                               drawing_mode=agg.DrawingMode.DrawFill)
+        times = []
+        for paint in paints:
+            def draw():
+                canvas.clear(0.5, 0.5, 0.5)
+                canvas.draw_shape(path, transform, gs, fill=paint)
+
+            times.append(min(timeit.repeat(draw, number=1,
+                                           repeat=args.repeat)))
+        print('{:>16}: solid {:.1f} ms, gradient {:.1f} ms'.format(
+            mode.name, times[0] * 1000, times[1] * 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,81 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+""" Compares binning points with a ``DensityCanvas`` against faint points on
+a ``CanvasRGBA32`` and ``numpy.histogram2d``.
+"""
+import argparse
+import timeit
+
+import numpy as np
+
+import celiagg as agg
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-n', '--points', type=int, default=1000000)
+    parser.add_argument('-r', '--repeat', type=int, default=5)
+    parser.add_argument('--width', type=int, default=1000)
+    parser.add_argument('--height', type=int, default=1000)
+    args = parser.parse_args()
+
+    rs = np.random.RandomState(0)
+    points = rs.normal(size=(args.points, 2)) * (args.width / 6, args.height / 6)
+    points += (args.width / 2, args.height / 2)
+    dot = agg.Path()
+    dot.rect(0, 0, 1, 1)
+    transform = agg.Transform()
+    state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+
+    density = agg.DensityCanvas(
+        np.zeros((args.height, args.width), dtype=np.float32)
+    )
+    canvas = agg.CanvasRGBA32(
+        np.zeros((args.height, args.width, 4), dtype=np.uint8)
+    )
+    paint = agg.SolidPaint(0.0, 0.0, 0.0, 0.01)
+
+    def draw_density():
+        density.clear()
+        density.draw_shape_at_points(dot, points, transform, state)
+
+    def draw_canvas():
+        canvas.clear(1, 1, 1, 0)
+        canvas.draw_shape_at_points(dot, points, transform, state, fill=paint)
+
+    def histogram():
+        np.histogram2d(points[:, 1], points[:, 0],
+                       bins=(args.height, args.width),
+                       range=((0, args.height), (0, args.width)))
+
+    for name, func in (('DensityCanvas', draw_density),
+                       ('CanvasRGBA32, alpha 0.01', draw_canvas),
+                       ('numpy.histogram2d', histogram)):
+        best = min(timeit.repeat(func, number=1, repeat=args.repeat))
+        print('{:>24}: {:.1f} ms'.format(name, best * 1000))
+
+    counts = density.array
+    print('{:>24}: {:.0f}'.format('densest pixel', counts.max()))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,75 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+""" Times draw_image with transforms that can copy image rows directly
+(whole pixel translations and upscales) against nearly identical transforms
+that have to go through the rasterizer.
+"""
+import argparse
+import timeit
+
+import numpy as np
+
+import celiagg as agg
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-r', '--repeat', type=int, default=5)
+    parser.add_argument('--size', type=int, default=1000)
+    args = parser.parse_args()
+
+    size = args.size
+    image = np.random.RandomState(0).randint(0, 256, (size, size, 4))
+    image = image.astype(np.uint8)
+    canvas = agg.CanvasRGBA32(np.zeros((size, size, 4), dtype=np.uint8))
+    stencil = agg.Image(np.full((size, size), 255, dtype=np.uint8),
+                        agg.PixelFormat.Gray8)
+
+    cases = (
+        ('translate', 1, 10.0),
+        ('translate, stencil', 1, 10.0),
+        ('upscale x2', 2, 0.0),
+        ('upscale x2, stencil', 2, 0.0),
+    )
+    for name, scale, offset in cases:
+        state = agg.GraphicsState()
+        if 'stencil' in name:
+            state.stencil = stencil
+        times = []
+        # A tiny fractional offset forces the rasterized path
+        for nudge in (0.0, 1e-6):
+            transform = agg.Transform()
+            transform.translate(offset + nudge, offset)
+            transform.scale(scale, scale)
+
+            def draw():
+                canvas.draw_image(image, agg.PixelFormat.RGBA32, transform,
+                                  state)
+
+            times.append(min(timeit.repeat(draw, number=1,
+                                           repeat=args.repeat)))
+        print('{:>20}: blit {:.2f} ms, rasterized {:.2f} ms'.format(
+            name, times[0] * 1000, times[1] * 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+""" Times filling a 1920x1080 canvas with linear and radial gradients in each
+``GradientSpread``, the way a full screen background is drawn.
+"""
+import argparse
+import timeit
+
+import numpy as np
+
+import celiagg as agg
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-r', '--repeat', type=int, default=5)
+    parser.add_argument('--width', type=int, default=1920)
+    parser.add_argument('--height', type=int, default=1080)
+    args = parser.parse_args()
+
+    width, height = args.width, args.height
+    canvas = agg.CanvasRGBA32(np.zeros((height, width, 4), dtype=np.uint8))
+    path = agg.Path()
+    path.rect(0, 0, width, height)
+    transform = agg.Transform()
+    gs = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+    stops = [(0.0, 1.0, 0.2, 0.0, 1.0), (0.5, 0.3, 0.9, 0.1, 1.0),
+             (1.0, 0.0, 0.5, 1.0, 1.0)]
+
+    for spread in agg.GradientSpread:
+        paints = (
+            agg.LinearGradientPaint(0, 0, width / 3, height / 5, stops,
+                                    spread, agg.GradientUnits.UserSpace),
+            agg.RadialGradientPaint(width / 2, height / 2, height / 3,
+                                    width / 2 + 40, height / 2 - 30, stops,
+                                    spread, agg.GradientUnits.UserSpace),
+        )
+        times = []
+        for paint in paints:
+            def draw():
+                canvas.draw_shape(path, transform, gs, fill=paint)
+
+            times.append(min(timeit.repeat(draw, number=1,
+                                           repeat=args.repeat)))
+        print('{:>14}: linear {:.1f} ms, radial {:.1f} ms'.format(
+            spread.name, times[0] * 1000, times[1] * 1000))
+
+
+if __name__ == '__main__':
+    main()
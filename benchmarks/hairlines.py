@@ -0,0 +1,75 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+""" Compares stroking a long polyline with and without
+``GraphicsState.fast_hairlines`` and ``GraphicsState.decimate_lines``.
+"""
+import argparse
+import timeit
+
+import numpy as np
+
+import celiagg as agg
+
+
+def make_polyline(segments, width, height):
+    x = np.linspace(0, width, segments + 1)
+    y = height / 2 + height * 0.4 * np.sin(x / 7) + 3 * np.sin(x * 5)
+    path = agg.Path()
+    path.lines(np.stack((x, y), axis=1))
+    return path
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-n', '--segments', type=int, default=1000000)
+    parser.add_argument('-r', '--repeat', type=int, default=5)
+    parser.add_argument('--width', type=int, default=1000)
+    parser.add_argument('--height', type=int, default=500)
+    args = parser.parse_args()
+
+    path = make_polyline(args.segments, args.width, args.height)
+    canvas = agg.CanvasRGBA32(
+        np.zeros((args.height, args.width, 4), dtype=np.uint8)
+    )
+    transform = agg.Transform()
+    paint = agg.SolidPaint(0.0, 0.0, 0.0)
+
+    for fast, decimate in ((False, False), (True, False),
+                           (False, True), (True, True)):
+        gs = agg.GraphicsState(
+            drawing_mode=agg.DrawingMode.DrawStroke, line_width=1.0,
+            fast_hairlines=fast, decimate_lines=decimate,
+        )
+
+        def draw():
+            canvas.clear(1, 1, 1)
+            canvas.draw_shape(path, transform, gs, stroke=paint)
+
+        best = min(timeit.repeat(draw, number=1, repeat=args.repeat))
+        name = 'outline renderer' if fast else 'polygon stroke'
+        if decimate:
+            name += ', decimated'
+        print('{:>27}: {:.1f} ms'.format(name, best * 1000))
+
+
+if __name__ == '__main__':
+    main()
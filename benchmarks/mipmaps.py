@@ -0,0 +1,71 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+""" Times drawing a large image at a small scale with and without mip levels,
+and how long the first draw which builds the levels takes.
+"""
+import argparse
+import time
+import timeit
+
+import numpy as np
+
+import celiagg as agg
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-r', '--repeat', type=int, default=3)
+    parser.add_argument('--size', type=int, default=4096)
+    parser.add_argument('--scale', type=float, default=1/16)
+    args = parser.parse_args()
+
+    size = args.size
+    pixels = np.random.RandomState(0).randint(0, 256, (size, size, 4))
+    pixels = pixels.astype(np.uint8)
+    out_size = max(int(size * args.scale), 1)
+    canvas = agg.CanvasRGBA32(np.zeros((out_size, out_size, 4),
+                                       dtype=np.uint8))
+    transform = agg.Transform()
+    transform.scale(args.scale, args.scale)
+
+    for mipmap in (False, True):
+        image = agg.Image(pixels, agg.PixelFormat.RGBA32, mipmap=mipmap)
+        start = time.perf_counter()
+        canvas.draw_image(image, None, transform, agg.GraphicsState())
+        first = time.perf_counter() - start
+        print('mipmap={}: first draw {:.2f} ms'.format(mipmap, first * 1000))
+
+        for image_filter in (agg.ImageFilter.Nearest,
+                             agg.ImageFilter.Bilinear,
+                             agg.ImageFilter.Lanczos):
+            state = agg.GraphicsState(image_filter=image_filter)
+
+            def draw():
+                canvas.draw_image(image, None, transform, state)
+
+            elapsed = min(timeit.repeat(draw, number=1, repeat=args.repeat))
+            print('{:>20}: {:.2f} ms'.format(image_filter.name,
+                                             elapsed * 1000))
+
+
+if __name__ == '__main__':
+    main()
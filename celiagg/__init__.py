@@ -28,11 +28,12 @@ import sys
 
 from . import _celiagg
 from ._celiagg import (
-    AggError, BSpline, BlendMode, DrawingMode, FontCache, FontWeight,
-    FreeTypeFont, GradientSpread, GradientUnits, GraphicsState, Image,
-    InnerJoin, LineCap, LineJoin, LinearGradientPaint, Path, PatternPaint,
-    PatternStyle, PixelFormat, RadialGradientPaint, Rect, ShapeAtPoints,
-    SolidPaint, TextDrawingMode, Transform, Win32Font,
+    AggError, BSpline, BlendMode, DensityCanvas, DrawingMode, FontCache,
+    FontWeight, FreeTypeFont, GradientSpread, GradientUnits, GraphicsState,
+    Image, ImageFilter, InnerJoin, LineCap, LineJoin, LinearGradientPaint,
+    MarkerType, Path, PatternPaint, PatternStyle, Picture, PixelFormat,
+    RadialGradientPaint, Rect, ShapeAtPoints, SolidPaint, TextDrawingMode,
+    Transform, Win32Font, convert_image,
 )
 
 # Query the library
@@ -63,17 +64,19 @@ def example_font():
 
 # Be explicit
 __all__ = [
-    'HAS_TEXT', 'example_font',
+    'HAS_TEXT', 'convert_image', 'example_font',
 
-    'AggError', 'BlendMode', 'BSpline', 'DrawingMode', 'Font', 'FontCache',
+    'AggError', 'BlendMode', 'BSpline', 'DensityCanvas', 'DrawingMode',
+    'Font', 'FontCache',
     'FontWeight', 'FreeTypeFont', 'GradientSpread', 'GradientUnits',
-    'GraphicsState', 'Image', 'InnerJoin', 'LinearGradientPaint', 'LineCap',
-    'LineJoin', 'RadialGradientPaint', 'Path', 'PatternPaint', 'PatternStyle',
-    'PixelFormat', 'Rect', 'ShapeAtPoints', 'SolidPaint', 'TextDrawingMode',
-    'Transform', 'Win32Font',
+    'GraphicsState', 'Image', 'ImageFilter', 'InnerJoin', 'LinearGradientPaint', 'LineCap',
+    'LineJoin', 'MarkerType', 'RadialGradientPaint', 'Path', 'PatternPaint', 'PatternStyle',
+    'Picture', 'PixelFormat', 'Rect', 'ShapeAtPoints', 'SolidPaint',
+    'TextDrawingMode', 'Transform', 'Win32Font',
 
     'CanvasG8', 'CanvasGA16', 'CanvasRGB24', 'CanvasRGBA32', 'CanvasBGRA32',
-    'CanvasRGBA128',
+    'CanvasRGBA128', 'CanvasRGBA32Pre', 'CanvasBGRA32Pre', 'CanvasRGBA128Pre',
+    'CanvasG16', 'CanvasRGB48', 'CanvasRGBA64', 'CanvasG32',
 ]
 
 # Select the correct font class for the platform
@@ -85,7 +88,7 @@ else:
 # Keep a font cache for callers that don't want to mess with it
 __global_font_cache = None
 
-_canvas_doc_string = """{klass_name}(array, bottom_up=False, font_cache=None)
+_canvas_doc_string = """{klass_name}(array, bottom_up=False, font_cache=None, threads=1)
 Provides AGG (Anti-Grain Geometry) drawing routines that render to the
 numpy array passed as the constructor argument. Because this array is
 modified in place, it must be of type ``{array_type}``, must be
@@ -94,6 +97,10 @@ C-contiguous, and must be {channel_desc}.
 :param array: A ``{array_type}`` array with shape {array_shape}.
 :param bottom_up: If True, the origin is the bottom left, instead of top-left
 :param font_cache: A ``FontCache`` instance. Defaults to a global instance.
+:param threads: The number of threads used to draw large shapes. When greater
+                than 1, the rows covered by a shape are split into bands which
+                are painted in parallel. The output is identical to drawing
+                with a single thread.
 """
 
 
@@ -114,9 +121,9 @@ def _build_canvas_factory(klass_name, array_type, array_shape, channel_desc):
     """
     klass = getattr(_celiagg, klass_name)
 
-    def factory(array, bottom_up=False, font_cache=None):
+    def factory(array, bottom_up=False, font_cache=None, threads=1):
         cache = _use_global_cache() if font_cache is None else font_cache
-        return klass(array, cache, bottom_up=bottom_up)
+        return klass(array, cache, bottom_up=bottom_up, threads=threads)
 
     factory.__doc__ = _canvas_doc_string.format(
         klass_name=klass_name,
@@ -159,9 +166,51 @@ CanvasBGRA32 = _build_canvas_factory(
     '(H, W, 4)',
     'MxNx4 (4 channels: blue, green, red, and alpha)',
 )
+CanvasG16 = _build_canvas_factory(
+    'CanvasG16',
+    'numpy.uint16',
+    '(H, W)',
+    'MxN (1 channel: intensity)',
+)
+CanvasG32 = _build_canvas_factory(
+    'CanvasG32',
+    'numpy.float32',
+    '(H, W)',
+    'MxN (1 channel: intensity)',
+)
+CanvasRGB48 = _build_canvas_factory(
+    'CanvasRGB48',
+    'numpy.uint16',
+    '(H, W, 3)',
+    'MxNx3 (3 channels: red, green, and blue)',
+)
+CanvasRGBA64 = _build_canvas_factory(
+    'CanvasRGBA64',
+    'numpy.uint16',
+    '(H, W, 4)',
+    'MxNx4 (4 channels: red, green, blue, and alpha)',
+)
 CanvasRGBA128 = _build_canvas_factory(
     'CanvasRGBA128',
     'numpy.float32',
     '(H, W, 4)',
     'MxNx4 (2 channels: red, green, blue, and alpha)',
 )
+CanvasRGBA32Pre = _build_canvas_factory(
+    'CanvasRGBA32Pre',
+    'numpy.uint8',
+    '(H, W, 4)',
+    'MxNx4 (4 channels: premultiplied red, green, blue, and alpha)',
+)
+CanvasBGRA32Pre = _build_canvas_factory(
+    'CanvasBGRA32Pre',
+    'numpy.uint8',
+    '(H, W, 4)',
+    'MxNx4 (4 channels: premultiplied blue, green, red, and alpha)',
+)
+CanvasRGBA128Pre = _build_canvas_factory(
+    'CanvasRGBA128Pre',
+    'numpy.float32',
+    '(H, W, 4)',
+    'MxNx4 (4 channels: premultiplied red, green, blue, and alpha)',
+)
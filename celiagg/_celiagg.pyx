@@ -26,11 +26,15 @@
 # cython: language_level=3
 # distutils: language=c++
 from libcpp cimport bool
+from libcpp.vector cimport vector
 import cython
 from cython.operator cimport dereference
 cimport numpy
 import numpy
 
+cimport _clip_path
+cimport _conversion
+cimport _density_canvas
 cimport _enums
 cimport _font_cache
 cimport _font
@@ -38,6 +42,7 @@ cimport _graphics_state
 cimport _image
 cimport _ndarray_canvas
 cimport _paint
+cimport _picture
 cimport _vertex_source
 cimport _text_support
 cimport _transform
@@ -69,6 +74,8 @@ include "graphics_state.pxi"
 include "image.pxi"
 include "ndarray_canvas.pxi"
 include "paint.pxi"
+include "picture.pxi"
 include "transform.pxi"
 include "vertex_source.pxi"
 include "conversion.pxi"
+include "density_canvas.pxi"
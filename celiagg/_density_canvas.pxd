@@ -0,0 +1,59 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016 WUSTL ZPLAB
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Authors: John Wiggins
+
+from libcpp cimport bool
+
+cimport _graphics_state
+cimport _transform
+cimport _vertex_source
+
+
+cdef extern from "density_canvas.h":
+    cdef cppclass density_canvas_base:
+        unsigned width() const
+        unsigned height() const
+        void clear() nogil
+        void draw_shape(_vertex_source.VertexSource& shape,
+                        const _transform.trans_affine& transform,
+                        const double weight,
+                        const _graphics_state.GraphicsState& gs) except + nogil
+        void draw_shape_at_points(_vertex_source.VertexSource& shape,
+                                  const double* points,
+                                  const double* weights,
+                                  const size_t point_count,
+                                  const _transform.trans_affine& transform,
+                                  const _graphics_state.GraphicsState& gs) except + nogil
+        void draw_line_segments(const double* segments,
+                                const double* weights,
+                                const size_t segment_count,
+                                const _transform.trans_affine& transform,
+                                const _graphics_state.GraphicsState& gs) except + nogil
+
+    cdef cppclass density_canvas[value_T](density_canvas_base):
+        density_canvas(unsigned char* buf,
+                       const unsigned width,
+                       const unsigned height,
+                       const int stride,
+                       const bool bottom_up)
@@ -66,6 +66,28 @@ cdef extern from "image.h":
         k_PixelFormatRGBA128
         k_PixelFormatARGB128
         k_PixelFormatABGR128
+        k_PixelFormatBGRA32Pre
+        k_PixelFormatRGBA32Pre
+        k_PixelFormatRGBA128Pre
+
+    cdef enum ImageFilter:
+        k_ImageFilterNearest
+        k_ImageFilterBilinear
+        k_ImageFilterBicubic
+        k_ImageFilterSpline16
+        k_ImageFilterSpline36
+        k_ImageFilterHanning
+        k_ImageFilterHamming
+        k_ImageFilterHermite
+        k_ImageFilterKaiser
+        k_ImageFilterQuadric
+        k_ImageFilterCatrom
+        k_ImageFilterGaussian
+        k_ImageFilterBessel
+        k_ImageFilterMitchell
+        k_ImageFilterSinc
+        k_ImageFilterLanczos
+        k_ImageFilterBlackman
 
 
 cdef extern from "graphics_state.h" namespace "GraphicsState":
@@ -131,6 +153,20 @@ cdef extern from "graphics_state.h" namespace "GraphicsState":
         BlendExclusion
 
 
+cdef extern from "markers.h":
+    cdef enum MarkerType:
+        k_MarkerSquare
+        k_MarkerDiamond
+        k_MarkerCircle
+        k_MarkerTriangleUp
+        k_MarkerTriangleDown
+        k_MarkerTriangleLeft
+        k_MarkerTriangleRight
+        k_MarkerCross
+        k_MarkerX
+        k_MarkerDash
+
+
 cdef extern from "paint.h" namespace "Paint":
     cdef enum PaintType:
         k_PaintTypeSolid
@@ -35,3 +35,4 @@ cdef extern from "font_cache.h":
         # All text measurement happens with raster glyphs, for speed reasons.
         void activate(_font.Font& font, _transform.trans_affine& transform);
         double measure_width(char* str)
+        double width(_font.Font& font, const char* str) nogil
@@ -29,6 +29,7 @@ import numpy
 from libcpp cimport bool
 from libcpp.vector cimport vector
 
+cimport _clip_path
 cimport _enums
 cimport _image
 
@@ -51,6 +52,12 @@ cdef extern from "graphics_state.h":
         void anti_aliased(bool aa)
         bool anti_aliased() const
 
+        void fast_hairlines(bool fast)
+        bool fast_hairlines() const
+
+        void decimate_lines(bool decimate)
+        bool decimate_lines() const
+
         void clip_box(Rect r)
         Rect clip_box() const
 
@@ -66,6 +73,12 @@ cdef extern from "graphics_state.h":
         void image_blend_mode(_enums.BlendMode m)
         _enums.BlendMode image_blend_mode() const
 
+        void image_filter(_enums.ImageFilter f)
+        _enums.ImageFilter image_filter() const
+
+        void image_filter_radius(double r)
+        double image_filter_radius() const
+
         void master_alpha(double a)
         double master_alpha() const
 
@@ -95,3 +108,13 @@ cdef extern from "graphics_state.h":
 
         void stencil(const _image.Image* image)
         const _image.Image* stencil() const
+
+        void stencil_offset(int x, int y)
+        int stencil_x() const
+        int stencil_y() const
+
+        void compact_stencil(const _clip_path.ClipPath* clip)
+        const _clip_path.ClipPath* compact_stencil() const
+
+        void clip_path(const _clip_path.ClipPath* clip)
+        const _clip_path.ClipPath* clip_path() const
@@ -23,9 +23,15 @@
 #
 # Authors: John Wiggins
 
+from libcpp cimport bool
+
 cdef extern from "image.h":
     cdef cppclass Image:
         Image(unsigned char* buf, unsigned width, unsigned height, int stride)
 
         unsigned height()
         unsigned width()
+
+        void mipmap(bool enable)
+        bool mipmap()
+        void invalidate()
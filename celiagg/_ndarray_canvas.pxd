@@ -28,11 +28,13 @@ cimport numpy
 import numpy
 from libcpp cimport bool
 
+cimport _enums
 cimport _font_cache
 cimport _font
 cimport _graphics_state
 cimport _image
 cimport _paint
+cimport _picture
 cimport _vertex_source
 cimport _transform
 
@@ -44,10 +46,18 @@ cdef extern from "ndarray_canvas.h" namespace "agg":
         pass
     cdef cppclass pixfmt_rgba32:
         pass
+    cdef cppclass pixfmt_rgba128_pre:
+        pass
+    cdef cppclass pixfmt_bgra32_pre:
+        pass
+    cdef cppclass pixfmt_rgba32_pre:
+        pass
     cdef cppclass pixfmt_rgb24:
         pass
     cdef cppclass pixfmt_gray16:
         pass
+    cdef cppclass pixfmt_gray32:
+        pass
     cdef cppclass pixfmt_gray8:
         pass
     cdef cppclass pixfmt_rgb48:
@@ -61,23 +71,45 @@ cdef extern from "ndarray_canvas.h":
         const size_t channel_count() const
         unsigned width() const
         unsigned height() const
-        void clear(const double r, const double g, const double b, const double a)
+        unsigned threads() const
+        void clear(const double r, const double g, const double b,
+                   const double a) nogil
         void draw_image(_image.Image& img, const _transform.trans_affine& transform,
-                        const _graphics_state.GraphicsState& gs)
+                        const _graphics_state.GraphicsState& gs) nogil
+        void draw_scalar_image(_image.Image& img, const double* colormap,
+                               const size_t colormap_size,
+                               const double vmin, const double vmax,
+                               const _transform.trans_affine& transform,
+                               const _graphics_state.GraphicsState& gs) nogil
         void draw_shape(_vertex_source.VertexSource& shape,
                         const _transform.trans_affine& transform,
                         _paint.Paint& linePaint, _paint.Paint& fillPaint,
-                        const _graphics_state.GraphicsState& gs) except +
+                        const _graphics_state.GraphicsState& gs) except + nogil
         void draw_shape_at_points(_vertex_source.VertexSource& shape,
                                   const double* points,
                                   const size_t point_count,
                                   const _transform.trans_affine& transform,
                                   _paint.Paint& linePaint, _paint.Paint& fillPaint,
-                                  const _graphics_state.GraphicsState& gs) except +
+                                  const _graphics_state.GraphicsState& gs) except + nogil
+        void draw_markers(const double* points,
+                          const size_t point_count,
+                          const _enums.MarkerType type,
+                          const double size,
+                          const _transform.trans_affine& transform,
+                          _paint.Paint& paint,
+                          const _graphics_state.GraphicsState& gs) except + nogil
+        void draw_shapes_compound(_vertex_source.VertexSource** shapes,
+                                  const unsigned* styles,
+                                  const size_t shape_count,
+                                  _paint.Paint** paints,
+                                  const size_t paint_count,
+                                  const _transform.trans_affine& transform,
+                                  const _graphics_state.GraphicsState& gs) except + nogil
         void draw_text(const char* text, _font.Font& font,
                        const _transform.trans_affine& transform,
                        _paint.Paint& linePaint, _paint.Paint& fillPaint,
-                       const _graphics_state.GraphicsState& gs)
+                       const _graphics_state.GraphicsState& gs) nogil
+        void draw_picture(const _picture.Picture& picture) except + nogil
 
     cdef cppclass ndarray_canvas[pixfmt_T]:
         ndarray_canvas(unsigned char* buf,
@@ -86,4 +118,5 @@ cdef extern from "ndarray_canvas.h":
                        const int stride,
                        const size_t channel_count,
                        _font_cache.FontCache& cache,
-                       const bool bottom_up)
+                       const bool bottom_up,
+                       const unsigned threads)
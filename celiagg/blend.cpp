@@ -0,0 +1,462 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "blend.h"
+#include "simd.h"
+
+// All of the operators work on premultiplied colors. With S and D as a
+// source and destination channel and Sa and Da as their alphas, every channel
+// (alpha included) is computed with the same formula.
+
+static inline int mul8(int a, int b)
+{
+    const int t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+#if defined(CELIAGG_HAVE_SSE2)
+static inline __m128i mul8_sse2(__m128i a, __m128i b)
+{
+    const __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+#endif
+
+#if defined(CELIAGG_HAVE_AVX2)
+CELIAGG_TARGET_AVX2
+static inline __m256i mul8_avx2(__m256i a, __m256i b)
+{
+    const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+#endif
+
+// Dca' = Sca + Dca.(1 - Sa)
+struct BlendSrcOver
+{
+    static int scalar(int s, int d, int sa, int)
+    {
+        return s + d - mul8(d, sa);
+    }
+#if defined(CELIAGG_HAVE_SSE2)
+    static __m128i sse2(__m128i s, __m128i d, __m128i sa, __m128i)
+    {
+        return _mm_add_epi16(s, _mm_sub_epi16(d, mul8_sse2(d, sa)));
+    }
+#endif
+#if defined(CELIAGG_HAVE_AVX2)
+    CELIAGG_TARGET_AVX2
+    static __m256i avx2(__m256i s, __m256i d, __m256i sa, __m256i)
+    {
+        return _mm256_add_epi16(s, _mm256_sub_epi16(d, mul8_avx2(d, sa)));
+    }
+#endif
+};
+
+// Dca' = Sca + Dca
+struct BlendPlus
+{
+    static int scalar(int s, int d, int, int)
+    {
+        return s + d;
+    }
+#if defined(CELIAGG_HAVE_SSE2)
+    static __m128i sse2(__m128i s, __m128i d, __m128i, __m128i)
+    {
+        return _mm_add_epi16(s, d);
+    }
+#endif
+#if defined(CELIAGG_HAVE_AVX2)
+    CELIAGG_TARGET_AVX2
+    static __m256i avx2(__m256i s, __m256i d, __m256i, __m256i)
+    {
+        return _mm256_add_epi16(s, d);
+    }
+#endif
+};
+
+// Dca' = Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)
+struct BlendMultiply
+{
+    static int scalar(int s, int d, int sa, int da)
+    {
+        return mul8(s, d) + s - mul8(s, da) + d - mul8(d, sa);
+    }
+#if defined(CELIAGG_HAVE_SSE2)
+    static __m128i sse2(__m128i s, __m128i d, __m128i sa, __m128i da)
+    {
+        const __m128i sd = mul8_sse2(s, d);
+        const __m128i sum = _mm_add_epi16(_mm_add_epi16(sd, s), d);
+        return _mm_sub_epi16(sum, _mm_add_epi16(mul8_sse2(s, da), mul8_sse2(d, sa)));
+    }
+#endif
+#if defined(CELIAGG_HAVE_AVX2)
+    CELIAGG_TARGET_AVX2
+    static __m256i avx2(__m256i s, __m256i d, __m256i sa, __m256i da)
+    {
+        const __m256i sd = mul8_avx2(s, d);
+        const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(sd, s), d);
+        return _mm256_sub_epi16(sum, _mm256_add_epi16(mul8_avx2(s, da), mul8_avx2(d, sa)));
+    }
+#endif
+};
+
+// Dca' = Sca + Dca - Sca.Dca
+struct BlendScreen
+{
+    static int scalar(int s, int d, int, int)
+    {
+        return s + d - mul8(s, d);
+    }
+#if defined(CELIAGG_HAVE_SSE2)
+    static __m128i sse2(__m128i s, __m128i d, __m128i, __m128i)
+    {
+        return _mm_sub_epi16(_mm_add_epi16(s, d), mul8_sse2(s, d));
+    }
+#endif
+#if defined(CELIAGG_HAVE_AVX2)
+    CELIAGG_TARGET_AVX2
+    static __m256i avx2(__m256i s, __m256i d, __m256i, __m256i)
+    {
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), mul8_avx2(s, d));
+    }
+#endif
+};
+
+// Dca' = min(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+struct BlendDarken
+{
+    static int scalar(int s, int d, int sa, int da)
+    {
+        return s + d - std::max(mul8(s, da), mul8(d, sa));
+    }
+#if defined(CELIAGG_HAVE_SSE2)
+    static __m128i sse2(__m128i s, __m128i d, __m128i sa, __m128i da)
+    {
+        const __m128i m = _mm_max_epi16(mul8_sse2(s, da), mul8_sse2(d, sa));
+        return _mm_sub_epi16(_mm_add_epi16(s, d), m);
+    }
+#endif
+#if defined(CELIAGG_HAVE_AVX2)
+    CELIAGG_TARGET_AVX2
+    static __m256i avx2(__m256i s, __m256i d, __m256i sa, __m256i da)
+    {
+        const __m256i m = _mm256_max_epi16(mul8_avx2(s, da), mul8_avx2(d, sa));
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), m);
+    }
+#endif
+};
+
+// Dca' = max(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+struct BlendLighten
+{
+    static int scalar(int s, int d, int sa, int da)
+    {
+        return s + d - std::min(mul8(s, da), mul8(d, sa));
+    }
+#if defined(CELIAGG_HAVE_SSE2)
+    static __m128i sse2(__m128i s, __m128i d, __m128i sa, __m128i da)
+    {
+        const __m128i m = _mm_min_epi16(mul8_sse2(s, da), mul8_sse2(d, sa));
+        return _mm_sub_epi16(_mm_add_epi16(s, d), m);
+    }
+#endif
+#if defined(CELIAGG_HAVE_AVX2)
+    CELIAGG_TARGET_AVX2
+    static __m256i avx2(__m256i s, __m256i d, __m256i sa, __m256i da)
+    {
+        const __m256i m = _mm256_min_epi16(mul8_avx2(s, da), mul8_avx2(d, sa));
+        return _mm256_sub_epi16(_mm256_add_epi16(s, d), m);
+    }
+#endif
+};
+
+// ----------------------------------------------------------------------------
+
+// Premultiplies a straight color and scales it by a cover
+static inline void _premultiply(const agg::int8u* c, const int cover, int* s)
+{
+    s[3] = mul8(c[3], cover);
+    for (int i = 0; i < 3; ++i)
+    {
+        s[i] = mul8(mul8(c[i], c[3]), cover);
+    }
+}
+
+template<typename op_t>
+static inline void _blend_pixel(agg::int8u* p, const int* s)
+{
+    const int da = p[3];
+    for (int i = 0; i < 4; ++i)
+    {
+        const int v = op_t::scalar(s[i], p[i], s[3], da);
+        p[i] = agg::int8u(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+}
+
+template<typename op_t>
+static void _blend_span_scalar(agg::int8u* p, unsigned len,
+    const agg::int8u* src, const unsigned src_step,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+    int s[4];
+    for (; len > 0; --len, p += 4, src += src_step)
+    {
+        _premultiply(src, covers ? *covers++ : cover, s);
+        _blend_pixel<op_t>(p, s);
+    }
+}
+
+#if defined(CELIAGG_HAVE_SSE2)
+// Broadcasts the alpha of two pixels of 16 bit channels to all channels
+static inline __m128i _alphas_sse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Premultiplies and covers two pixels of 16 bit channels
+static inline __m128i _premultiply_sse2(__m128i s, __m128i covers)
+{
+    const __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i pre = mul8_sse2(s, _alphas_sse2(s));
+    s = _mm_or_si128(_mm_andnot_si128(alpha_mask, pre), _mm_and_si128(alpha_mask, s));
+    return mul8_sse2(s, covers);
+}
+
+template<typename op_t>
+static inline __m128i _blend_sse2(__m128i s, __m128i d)
+{
+    return op_t::sse2(s, d, _alphas_sse2(s), _alphas_sse2(d));
+}
+
+template<typename op_t>
+static void _blend_span_sse2(agg::int8u* p, unsigned len,
+    const agg::int8u* src, const unsigned src_step,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i fixed_cover = _mm_set1_epi16(cover);
+
+    for (; len >= 4; len -= 4, p += 16, src += src_step * 4)
+    {
+        __m128i sv;
+        if (src_step == 0)
+        {
+            int32_t c;
+            memcpy(&c, src, 4);
+            sv = _mm_set1_epi32(c);
+        }
+        else
+        {
+            sv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        }
+
+        __m128i cover_lo = fixed_cover, cover_hi = fixed_cover;
+        if (covers != NULL)
+        {
+            int32_t c;
+            memcpy(&c, covers, 4);
+            covers += 4;
+            __m128i cv = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c), zero);
+            cv = _mm_unpacklo_epi16(cv, cv);
+            cover_lo = _mm_unpacklo_epi32(cv, cv);
+            cover_hi = _mm_unpackhi_epi32(cv, cv);
+        }
+
+        const __m128i s_lo = _premultiply_sse2(_mm_unpacklo_epi8(sv, zero), cover_lo);
+        const __m128i s_hi = _premultiply_sse2(_mm_unpackhi_epi8(sv, zero), cover_hi);
+
+        __m128i* dst = reinterpret_cast<__m128i*>(p);
+        const __m128i dv = _mm_loadu_si128(dst);
+        const __m128i r_lo = _blend_sse2<op_t>(s_lo, _mm_unpacklo_epi8(dv, zero));
+        const __m128i r_hi = _blend_sse2<op_t>(s_hi, _mm_unpackhi_epi8(dv, zero));
+        _mm_storeu_si128(dst, _mm_packus_epi16(r_lo, r_hi));
+    }
+
+    _blend_span_scalar<op_t>(p, len, src, src_step, covers, cover);
+}
+#endif
+
+#if defined(CELIAGG_HAVE_AVX2)
+CELIAGG_TARGET_AVX2
+static inline __m256i _alphas_avx2(__m256i v)
+{
+    v = _mm256_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+CELIAGG_TARGET_AVX2
+static inline __m256i _premultiply_avx2(__m256i s, __m256i covers)
+{
+    const __m256i alpha_mask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0,
+                                                -1, 0, 0, 0, -1, 0, 0, 0);
+    const __m256i pre = mul8_avx2(s, _alphas_avx2(s));
+    s = _mm256_or_si256(_mm256_andnot_si256(alpha_mask, pre), _mm256_and_si256(alpha_mask, s));
+    return mul8_avx2(s, covers);
+}
+
+template<typename op_t>
+CELIAGG_TARGET_AVX2
+static inline __m256i _blend_avx2(__m256i s, __m256i d)
+{
+    return op_t::avx2(s, d, _alphas_avx2(s), _alphas_avx2(d));
+}
+
+// Unpacking works within each 128 bit half, so the low half of a 256 bit
+// register holds pixels 0, 1, 4 and 5 and the high half 2, 3, 6 and 7.
+template<typename op_t>
+CELIAGG_TARGET_AVX2
+static void _blend_span_avx2(agg::int8u* p, unsigned len,
+    const agg::int8u* src, const unsigned src_step,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i fixed_cover = _mm256_set1_epi16(cover);
+
+    for (; len >= 8; len -= 8, p += 32, src += src_step * 8)
+    {
+        __m256i sv;
+        if (src_step == 0)
+        {
+            int32_t c;
+            memcpy(&c, src, 4);
+            sv = _mm256_set1_epi32(c);
+        }
+        else
+        {
+            sv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        }
+
+        __m256i cover_lo = fixed_cover, cover_hi = fixed_cover;
+        if (covers != NULL)
+        {
+            const __m128i cv = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(covers)),
+                _mm_setzero_si128());
+            covers += 8;
+            const __m128i c03 = _mm_unpacklo_epi16(cv, cv);
+            const __m128i c47 = _mm_unpackhi_epi16(cv, cv);
+            cover_lo = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_unpacklo_epi32(c03, c03)),
+                _mm_unpacklo_epi32(c47, c47), 1);
+            cover_hi = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_unpackhi_epi32(c03, c03)),
+                _mm_unpackhi_epi32(c47, c47), 1);
+        }
+
+        const __m256i s_lo = _premultiply_avx2(_mm256_unpacklo_epi8(sv, zero), cover_lo);
+        const __m256i s_hi = _premultiply_avx2(_mm256_unpackhi_epi8(sv, zero), cover_hi);
+
+        __m256i* dst = reinterpret_cast<__m256i*>(p);
+        const __m256i dv = _mm256_loadu_si256(dst);
+        const __m256i r_lo = _blend_avx2<op_t>(s_lo, _mm256_unpacklo_epi8(dv, zero));
+        const __m256i r_hi = _blend_avx2<op_t>(s_hi, _mm256_unpackhi_epi8(dv, zero));
+        _mm256_storeu_si256(dst, _mm256_packus_epi16(r_lo, r_hi));
+    }
+
+    _blend_span_scalar<op_t>(p, len, src, src_step, covers, cover);
+}
+
+#endif
+
+template<typename op_t>
+static void _blend_span(agg::int8u* p, const unsigned len,
+    const agg::int8u* src, const unsigned src_step,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+#if defined(CELIAGG_HAVE_AVX2)
+    static const bool has_avx2 = cpu_has_avx2();
+    if (has_avx2)
+    {
+        _blend_span_avx2<op_t>(p, len, src, src_step, covers, cover);
+        return;
+    }
+#endif
+#if defined(CELIAGG_HAVE_SSE2)
+    _blend_span_sse2<op_t>(p, len, src, src_step, covers, cover);
+#else
+    _blend_span_scalar<op_t>(p, len, src, src_step, covers, cover);
+#endif
+}
+
+static void _blend_span_op(const unsigned op, agg::int8u* p, const unsigned len,
+    const agg::int8u* src, const unsigned src_step,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+    switch (op)
+    {
+    case agg::comp_op_src_over:
+        _blend_span<BlendSrcOver>(p, len, src, src_step, covers, cover);
+        break;
+    case agg::comp_op_plus:
+        _blend_span<BlendPlus>(p, len, src, src_step, covers, cover);
+        break;
+    case agg::comp_op_multiply:
+        _blend_span<BlendMultiply>(p, len, src, src_step, covers, cover);
+        break;
+    case agg::comp_op_screen:
+        _blend_span<BlendScreen>(p, len, src, src_step, covers, cover);
+        break;
+    case agg::comp_op_darken:
+        _blend_span<BlendDarken>(p, len, src, src_step, covers, cover);
+        break;
+    case agg::comp_op_lighten:
+        _blend_span<BlendLighten>(p, len, src, src_step, covers, cover);
+        break;
+    default:
+        break;
+    }
+}
+
+bool blend_span_supported(const unsigned op)
+{
+    switch (op)
+    {
+    case agg::comp_op_src_over:
+    case agg::comp_op_plus:
+    case agg::comp_op_multiply:
+    case agg::comp_op_screen:
+    case agg::comp_op_darken:
+    case agg::comp_op_lighten:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void blend_solid_span_rgba8(const unsigned op, agg::int8u* pixels,
+    const unsigned len, const agg::int8u* color,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+    _blend_span_op(op, pixels, len, color, 0, covers, cover);
+}
+
+void blend_color_span_rgba8(const unsigned op, agg::int8u* pixels,
+    const unsigned len, const agg::int8u* colors,
+    const agg::int8u* covers, const agg::int8u cover)
+{
+    _blend_span_op(op, pixels, len, colors, 4, covers, cover);
+}
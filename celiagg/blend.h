@@ -0,0 +1,212 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_BLEND_H
+#define CELIAGG_BLEND_H
+
+#include <algorithm>
+
+#include <agg_basics.h>
+#include <agg_pixfmt_rgba.h>
+#include <agg_rendering_buffer.h>
+
+// Span compositing for 8 bit RGBA pixels with alpha in the last byte. Source
+// colors are not premultiplied and have their channels in the same order as
+// the pixels. `covers` may be NULL, in which case `cover` is used for every
+// pixel. These use SSE2 or AVX2 when the CPU has them.
+
+// True if `op` (an agg::comp_op_e) has a span function
+bool blend_span_supported(const unsigned op);
+
+// Blend one color into `len` pixels
+void blend_solid_span_rgba8(const unsigned op, agg::int8u* pixels,
+                            const unsigned len, const agg::int8u* color,
+                            const agg::int8u* covers, const agg::int8u cover);
+
+// Blend `len` colors into `len` pixels
+void blend_color_span_rgba8(const unsigned op, agg::int8u* pixels,
+                            const unsigned len, const agg::int8u* colors,
+                            const agg::int8u* covers, const agg::int8u cover);
+
+// A pixel format which composites with any agg::comp_op_e. The horizontal
+// spans that renderers draw go through the span functions above when they
+// support the operator.
+template<typename order_t>
+class pixfmt_comp_op_rgba32
+: public agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba<agg::rgba8, order_t>, agg::rendering_buffer>
+{
+    typedef agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba<agg::rgba8, order_t>, agg::rendering_buffer> base_t;
+
+public:
+    typedef agg::rgba8 color_type;
+
+    explicit pixfmt_comp_op_rgba32(agg::rendering_buffer& rb, unsigned comp_op = agg::comp_op_src_over)
+    : base_t(rb, comp_op)
+    {}
+
+    void blend_hline(int x, int y, unsigned len, const color_type& c, agg::int8u cover)
+    {
+        if (!blend_span_supported(this->comp_op()))
+        {
+            base_t::blend_hline(x, y, len, c, cover);
+            return;
+        }
+
+        agg::int8u color[4];
+        _set(color, c);
+        blend_solid_span_rgba8(this->comp_op(), _pixels(x, y, len), len, color, NULL, cover);
+    }
+
+    void blend_solid_hspan(int x, int y, unsigned len, const color_type& c, const agg::int8u* covers)
+    {
+        if (!blend_span_supported(this->comp_op()))
+        {
+            base_t::blend_solid_hspan(x, y, len, c, covers);
+            return;
+        }
+
+        agg::int8u color[4];
+        _set(color, c);
+        blend_solid_span_rgba8(this->comp_op(), _pixels(x, y, len), len, color, covers, agg::cover_full);
+    }
+
+    void blend_color_hspan(int x, int y, unsigned len, const color_type* colors,
+                           const agg::int8u* covers, agg::int8u cover)
+    {
+        if (!blend_span_supported(this->comp_op()))
+        {
+            base_t::blend_color_hspan(x, y, len, colors, covers, cover);
+            return;
+        }
+
+        agg::int8u* pixels = _pixels(x, y, len);
+        if (order_t::R == 0 && order_t::G == 1 && order_t::B == 2 && order_t::A == 3)
+        {
+            blend_color_span_rgba8(this->comp_op(), pixels, len,
+                                   reinterpret_cast<const agg::int8u*>(colors), covers, cover);
+            return;
+        }
+
+        // Put the colors into pixel order a piece at a time
+        enum { k_Chunk = 256 };
+        agg::int8u chunk[k_Chunk * 4];
+        while (len > 0)
+        {
+            const unsigned count = std::min(len, unsigned(k_Chunk));
+            for (unsigned i = 0; i < count; ++i)
+            {
+                _set(chunk + i*4, colors[i]);
+            }
+            blend_color_span_rgba8(this->comp_op(), pixels, count, chunk, covers, cover);
+
+            len -= count;
+            colors += count;
+            pixels += count * 4;
+            if (covers != NULL) covers += count;
+        }
+    }
+
+private:
+    agg::int8u* _pixels(int x, int y, unsigned len)
+    {
+        return reinterpret_cast<agg::int8u*>(this->pix_value_ptr(x, y, len));
+    }
+
+    static void _set(agg::int8u* p, const color_type& c)
+    {
+        p[order_t::R] = c.r;
+        p[order_t::G] = c.g;
+        p[order_t::B] = c.b;
+        p[order_t::A] = c.a;
+    }
+};
+
+// The pixel format which draws with blend modes onto a canvas of `pixfmt_t`.
+// Canvases without an alpha channel don't support blend modes, and keep
+// their own pixel format.
+template<typename pixfmt_t>
+struct blend_pixfmt
+{
+    typedef pixfmt_t type;
+    enum { supported = 0 };
+    static void comp_op(type&, unsigned) {}
+};
+
+template<>
+struct blend_pixfmt<agg::pixfmt_rgba32>
+{
+    typedef pixfmt_comp_op_rgba32<agg::order_rgba> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+template<>
+struct blend_pixfmt<agg::pixfmt_bgra32>
+{
+    typedef pixfmt_comp_op_rgba32<agg::order_bgra> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+template<>
+struct blend_pixfmt<agg::pixfmt_rgba64>
+{
+    typedef agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba<agg::rgba16, agg::order_rgba>, agg::rendering_buffer> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+template<>
+struct blend_pixfmt<agg::pixfmt_rgba128>
+{
+    typedef agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba<agg::rgba32, agg::order_rgba>, agg::rendering_buffer> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+// Premultiplied canvases are drawn with premultiplied colors, which AGG's
+// operators take as they are
+template<>
+struct blend_pixfmt<agg::pixfmt_rgba32_pre>
+{
+    typedef agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_rgba>, agg::rendering_buffer> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+template<>
+struct blend_pixfmt<agg::pixfmt_bgra32_pre>
+{
+    typedef agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_bgra>, agg::rendering_buffer> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+template<>
+struct blend_pixfmt<agg::pixfmt_rgba128_pre>
+{
+    typedef agg::pixfmt_custom_blend_rgba<agg::comp_op_adaptor_rgba_pre<agg::rgba32, agg::order_rgba>, agg::rendering_buffer> type;
+    enum { supported = 1 };
+    static void comp_op(type& pixfmt, unsigned op) { pixfmt.comp_op(op); }
+};
+
+#endif // CELIAGG_BLEND_H
@@ -0,0 +1,377 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <climits>
+
+#include <agg_conv_contour.h>
+#include <agg_conv_transform.h>
+#include <agg_rasterizer_scanline_aa.h>
+#include <agg_renderer_scanline.h>
+#include <agg_scanline_boolean_algebra.h>
+#include <agg_scanline_u.h>
+
+#include "clip_path.h"
+
+ClipPath::ClipPath(VertexSource& path, const agg::trans_affine& transform)
+: m_x1(0)
+, m_x2(0)
+, m_y1(0)
+{
+    agg::rasterizer_scanline_aa<> rasterizer;
+    agg::scanline_u8 scanline;
+    agg::trans_affine mtx = transform;
+    agg::conv_transform<VertexSource> trans_path(path, mtx);
+    // Covers the same pixels as filling the path on a canvas
+    agg::conv_contour<agg::conv_transform<VertexSource> > contour(trans_path);
+    contour.auto_detect_orientation(true);
+
+    rasterizer.add_path(contour);
+    agg::render_scanlines(rasterizer, scanline, m_storage);
+    _index();
+}
+
+ClipPath::ClipPath(const ClipPath& first, const ClipPath& second)
+: m_x1(0)
+, m_x2(0)
+, m_y1(0)
+{
+    // Rewinding is the only change sbool makes to the inputs
+    agg::scanline_storage_aa8& storage1 = const_cast<agg::scanline_storage_aa8&>(first.m_storage);
+    agg::scanline_storage_aa8& storage2 = const_cast<agg::scanline_storage_aa8&>(second.m_storage);
+    agg::scanline_u8 scanline1, scanline2, scanline;
+
+    agg::sbool_intersect_shapes_aa(storage1, storage2, scanline1, scanline2, scanline, m_storage);
+    _index();
+}
+
+ClipPath::ClipPath(Image& mask, int x, int y)
+: m_x1(0)
+, m_x2(0)
+, m_y1(y)
+{
+    // Runs shorter than this are cheaper to store pixel by pixel
+    enum { k_MinRun = 4 };
+
+    const agg::rendering_buffer& buf = mask.get_buffer();
+    const int width = int(buf.width());
+    const int height = int(buf.height());
+    for (int row = 0; row < height; ++row)
+    {
+        _add_row(row);
+
+        const cover_type* covers = buf.row_ptr(row);
+        int i = 0;
+        while (i < width)
+        {
+            if (covers[i] == 0)
+            {
+                ++i;
+                continue;
+            }
+
+            int start = i;
+            while (i < width && covers[i] != 0)
+            {
+                int run = 1;
+                while (i + run < width && covers[i + run] == covers[i]) ++run;
+                if (run >= k_MinRun)
+                {
+                    _add_span(x + start, i - start, covers + start);
+                    _add_span(x + i, -run, covers + i);
+                    start = i + run;
+                }
+                i += run;
+            }
+            _add_span(x + start, i - start, covers + start);
+        }
+    }
+    _add_row(height);
+}
+
+ClipPath::cover_type ClipPath::pixel(int x, int y) const
+{
+    cover_type cover;
+    fill_hspan(x, y, &cover, 1);
+    return cover;
+}
+
+void ClipPath::fill_hspan(int x, int y, cover_type* covers, int len) const
+{
+    std::fill(covers, covers + len, cover_type(0));
+
+    const int row = y - m_y1;
+    if (row < 0 || row + 1 >= int(m_rows.size()))
+    {
+        return;
+    }
+
+    const int x2 = x + len;
+    for (unsigned i = m_rows[row]; i < m_rows[row + 1]; ++i)
+    {
+        const Span& span = m_spans[i];
+        if (span.x >= x2) break;
+
+        const int span_len = span.len < 0 ? -span.len : span.len;
+        const int start = std::max(span.x, x);
+        const int end = std::min(span.x + span_len, x2);
+        if (start >= end) continue;
+
+        if (span.len < 0)
+        {
+            std::fill(covers + (start - x), covers + (end - x), m_covers[span.covers]);
+        }
+        else
+        {
+            std::copy(m_covers.begin() + (span.covers + (start - span.x)),
+                      m_covers.begin() + (span.covers + (end - span.x)),
+                      covers + (start - x));
+        }
+    }
+}
+
+void ClipPath::combine_hspan(int x, int y, cover_type* covers, int len) const
+{
+    const int row = y - m_y1;
+    if (row < 0 || row + 1 >= int(m_rows.size()))
+    {
+        std::fill(covers, covers + len, cover_type(0));
+        return;
+    }
+
+    // Pixels between `x` and `pos` are done
+    const int x2 = x + len;
+    int pos = x;
+    for (unsigned i = m_rows[row]; i < m_rows[row + 1] && pos < x2; ++i)
+    {
+        const Span& span = m_spans[i];
+        const int span_len = span.len < 0 ? -span.len : span.len;
+        const int start = std::max(span.x, pos);
+        const int end = std::min(span.x + span_len, x2);
+        if (start >= end) continue;
+
+        std::fill(covers + (pos - x), covers + (start - x), cover_type(0));
+        if (span.len >= 0)
+        {
+            const cover_type* src = &m_covers[span.covers + (start - span.x)];
+            for (cover_type* dst = covers + (start - x); dst < covers + (end - x); ++dst, ++src)
+            {
+                *dst = cover_type((agg::cover_full + (*dst) * (*src)) >> agg::cover_shift);
+            }
+        }
+        else if (m_covers[span.covers] != agg::cover_full)
+        {
+            const unsigned src = m_covers[span.covers];
+            for (cover_type* dst = covers + (start - x); dst < covers + (end - x); ++dst)
+            {
+                *dst = cover_type((agg::cover_full + (*dst) * src) >> agg::cover_shift);
+            }
+        }
+        pos = end;
+    }
+    std::fill(covers + (pos - x), covers + len, cover_type(0));
+}
+
+void ClipPath::bounds(int& x1, int& y1, int& x2, int& y2) const
+{
+    if (m_spans.empty())
+    {
+        x1 = y1 = x2 = y2 = 0;
+        return;
+    }
+
+    x1 = m_x1;
+    x2 = m_x2;
+    y1 = m_y1;
+    y2 = m_y1 + int(m_rows.size()) - 1;
+}
+
+void ClipPath::_index()
+{
+    // Unpack the stored scanlines into spans which can be found by row
+    if (!m_storage.rewind_scanlines())
+    {
+        return;
+    }
+
+    m_y1 = m_storage.min_y();
+
+    agg::scanline_u8 scanline;
+    scanline.reset(m_storage.min_x(), m_storage.max_x());
+    while (m_storage.sweep_scanline(scanline))
+    {
+        _add_row(scanline.y() - m_y1);
+
+        agg::scanline_u8::const_iterator span = scanline.begin();
+        for (unsigned i = scanline.num_spans(); i > 0; --i, ++span)
+        {
+            _add_span(span->x, span->len, span->covers);
+        }
+    }
+    _add_row(m_storage.max_y() - m_y1 + 1);
+}
+
+void ClipPath::_add_row(int row)
+{
+    // Rows before `row` without spans are empty
+    while (int(m_rows.size()) <= row)
+    {
+        m_rows.push_back(unsigned(m_spans.size()));
+    }
+}
+
+void ClipPath::_add_span(int x, int len, const cover_type* covers)
+{
+    if (len == 0) return;
+
+    const int x2 = x + (len < 0 ? -len : len);
+    m_x1 = m_spans.empty() ? x : std::min(m_x1, x);
+    m_x2 = m_spans.empty() ? x2 : std::max(m_x2, x2);
+
+    Span span = { x, len, unsigned(m_covers.size()) };
+    m_spans.push_back(span);
+    m_covers.insert(m_covers.end(), covers, covers + (len < 0 ? 1 : len));
+}
+
+clip_mask::clip_mask(const agg::rendering_buffer* stencil, int stencil_x, int stencil_y,
+                     const ClipPath* compact_stencil, const ClipPath* clip)
+: m_stencil(stencil)
+, m_stencil_x(stencil_x)
+, m_stencil_y(stencil_y)
+, m_compact_stencil(compact_stencil)
+, m_clip(clip)
+, m_x1(INT_MIN / 2)
+, m_y1(INT_MIN / 2)
+, m_x2(INT_MAX / 2)
+, m_y2(INT_MAX / 2)
+{
+    int x1, y1, x2, y2;
+    if (stencil != NULL)
+    {
+        _intersect_bounds(stencil_x, stencil_y,
+                          stencil_x + int(stencil->width()),
+                          stencil_y + int(stencil->height()));
+    }
+    if (compact_stencil != NULL)
+    {
+        compact_stencil->bounds(x1, y1, x2, y2);
+        _intersect_bounds(x1, y1, x2, y2);
+    }
+    if (clip != NULL)
+    {
+        clip->bounds(x1, y1, x2, y2);
+        _intersect_bounds(x1, y1, x2, y2);
+    }
+}
+
+int clip_mask::clip_hspan(int& x, int y, unsigned& len) const
+{
+    if (y < m_y1 || y >= m_y2) return -1;
+
+    const int x1 = std::max(x, m_x1);
+    const int x2 = std::min(x + int(len), m_x2);
+    if (x1 >= x2) return -1;
+
+    const int skip = x1 - x;
+    x = x1;
+    len = unsigned(x2 - x1);
+    return skip;
+}
+
+clip_mask::cover_type clip_mask::pixel(int x, int y) const
+{
+    cover_type cover = cover_full;
+    combine_hspan(x, y, &cover, 1);
+    return cover;
+}
+
+clip_mask::cover_type clip_mask::combine_pixel(int x, int y, cover_type val) const
+{
+    combine_hspan(x, y, &val, 1);
+    return val;
+}
+
+void clip_mask::fill_hspan(int x, int y, cover_type* dst, int num_pix) const
+{
+    std::fill(dst, dst + num_pix, cover_type(cover_full));
+    combine_hspan(x, y, dst, num_pix);
+}
+
+void clip_mask::combine_hspan(int x, int y, cover_type* dst, int num_pix) const
+{
+    if (m_stencil != NULL)
+    {
+        _combine_stencil(x, y, dst, num_pix);
+    }
+    if (m_compact_stencil != NULL)
+    {
+        m_compact_stencil->combine_hspan(x, y, dst, num_pix);
+    }
+    if (m_clip != NULL)
+    {
+        m_clip->combine_hspan(x, y, dst, num_pix);
+    }
+}
+
+void clip_mask::fill_vspan(int x, int y, cover_type* dst, int num_pix) const
+{
+    std::fill(dst, dst + num_pix, cover_type(cover_full));
+    combine_vspan(x, y, dst, num_pix);
+}
+
+void clip_mask::combine_vspan(int x, int y, cover_type* dst, int num_pix) const
+{
+    for (int i = 0; i < num_pix; ++i)
+    {
+        combine_hspan(x, y + i, dst + i, 1);
+    }
+}
+
+void clip_mask::_combine_stencil(int x, int y, cover_type* dst, int num_pix) const
+{
+    // The same as agg::amask_gray8::combine_hspan, with the stencil offset
+    const int row = y - m_stencil_y;
+    const int x1 = std::max(x, m_stencil_x);
+    const int x2 = std::min(x + num_pix, m_stencil_x + int(m_stencil->width()));
+    if (row < 0 || row >= int(m_stencil->height()) || x1 >= x2)
+    {
+        std::fill(dst, dst + num_pix, cover_type(cover_none));
+        return;
+    }
+
+    std::fill(dst, dst + (x1 - x), cover_type(cover_none));
+    std::fill(dst + (x2 - x), dst + num_pix, cover_type(cover_none));
+
+    const cover_type* mask = m_stencil->row_ptr(row) + (x1 - m_stencil_x);
+    for (cover_type* covers = dst + (x1 - x); covers < dst + (x2 - x); ++covers, ++mask)
+    {
+        *covers = cover_type((cover_full + (*covers) * (*mask)) >> cover_shift);
+    }
+}
+
+void clip_mask::_intersect_bounds(int x1, int y1, int x2, int y2)
+{
+    m_x1 = std::max(m_x1, x1);
+    m_y1 = std::max(m_y1, y1);
+    m_x2 = std::min(m_x2, x2);
+    m_y2 = std::min(m_y2, y2);
+}
@@ -0,0 +1,190 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_CLIP_PATH_H
+#define CELIAGG_CLIP_PATH_H
+
+#include <vector>
+
+#include <agg_basics.h>
+#include <agg_pixfmt_amask_adaptor.h>
+#include <agg_rendering_buffer.h>
+#include <agg_scanline_storage_aa.h>
+#include <agg_trans_affine.h>
+
+#include "image.h"
+#include "vertex_source.h"
+
+// The anti-aliased coverage of a path in canvas pixels. The coverage is kept
+// as scanlines, so its size depends on the area the path covers rather than
+// the size of the canvas.
+class ClipPath
+{
+public:
+    typedef agg::int8u cover_type;
+
+                    ClipPath(VertexSource& path, const agg::trans_affine& transform);
+                    ClipPath(const ClipPath& other) = default;
+                    // The intersection of two clip paths. Both must have
+                    // been made from paths.
+                    ClipPath(const ClipPath& first, const ClipPath& second);
+                    // The coverage of a Gray8 mask placed at `x`, `y`. Runs
+                    // of equal coverage are stored once and transparent
+                    // pixels are not stored at all.
+                    ClipPath(Image& mask, int x, int y);
+
+    // Coverage of one pixel
+    cover_type      pixel(int x, int y) const;
+    // Coverage of `len` pixels starting at `x`, `y`
+    void            fill_hspan(int x, int y, cover_type* covers, int len) const;
+    // Scales `len` covers starting at `x`, `y` by the coverage. Opaque runs
+    // leave the covers as they are.
+    void            combine_hspan(int x, int y, cover_type* covers, int len) const;
+    // The pixels which have any coverage. x2 and y2 are exclusive.
+    void            bounds(int& x1, int& y1, int& x2, int& y2) const;
+
+private:
+    // A negative `len` is a run of -len pixels which all have the coverage
+    // m_covers[covers], as in agg::scanline_p8
+    struct Span
+    {
+        int         x;
+        int         len;
+        unsigned    covers;
+    };
+
+    void            _index();
+    void            _add_row(int row);
+    void            _add_span(int x, int len, const cover_type* covers);
+
+    agg::scanline_storage_aa8   m_storage;
+    // The spans of row `y` are m_spans[m_rows[y - m_y1]] up to
+    // m_spans[m_rows[y - m_y1 + 1]]
+    std::vector<unsigned>       m_rows;
+    std::vector<Span>           m_spans;
+    std::vector<cover_type>     m_covers;
+    int                         m_x1;
+    int                         m_x2;
+    int                         m_y1;
+
+    // Not assignable
+    ClipPath&       operator = (const ClipPath&);
+};
+
+// An alpha mask for agg::pixfmt_amask_adaptor which combines a stencil image
+// placed at `stencil_x`, `stencil_y`, a compact stencil and a clip path. Any of
+// them can be NULL. Pixels outside of the stencil image are masked out.
+class clip_mask
+{
+public:
+    typedef agg::int8u cover_type;
+    enum cover_scale_e
+    {
+        cover_shift = 8,
+        cover_none  = 0,
+        cover_full  = 255
+    };
+
+    clip_mask(const agg::rendering_buffer* stencil, int stencil_x, int stencil_y,
+              const ClipPath* compact_stencil, const ClipPath* clip);
+
+    // Shortens a span to the pixels which the mask doesn't hide. Returns the
+    // number of pixels removed from the start, or -1 if none are left.
+    int clip_hspan(int& x, int y, unsigned& len) const;
+
+    cover_type pixel(int x, int y) const;
+    cover_type combine_pixel(int x, int y, cover_type val) const;
+    void fill_hspan(int x, int y, cover_type* dst, int num_pix) const;
+    void combine_hspan(int x, int y, cover_type* dst, int num_pix) const;
+    void fill_vspan(int x, int y, cover_type* dst, int num_pix) const;
+    void combine_vspan(int x, int y, cover_type* dst, int num_pix) const;
+
+private:
+    void _combine_stencil(int x, int y, cover_type* dst, int num_pix) const;
+    void _intersect_bounds(int x1, int y1, int x2, int y2);
+
+    const agg::rendering_buffer* m_stencil;
+    int m_stencil_x;
+    int m_stencil_y;
+    const ClipPath* m_compact_stencil;
+    const ClipPath* m_clip;
+    // The pixels which the mask doesn't hide. x2 and y2 are exclusive.
+    int m_x1, m_y1, m_x2, m_y2;
+};
+
+// agg::pixfmt_amask_adaptor for a clip_mask. Horizontal spans are clipped to
+// the bounds of the mask before they are masked and blended, so pixels which
+// the mask hides anyway cost nothing.
+template<class PixFmt>
+class pixfmt_clip_mask_adaptor : public agg::pixfmt_amask_adaptor<PixFmt, clip_mask>
+{
+public:
+    typedef agg::pixfmt_amask_adaptor<PixFmt, clip_mask> base_type;
+    typedef typename base_type::color_type color_type;
+    typedef typename base_type::cover_type cover_type;
+
+    pixfmt_clip_mask_adaptor(PixFmt& pixf, clip_mask& mask)
+    : base_type(pixf, mask)
+    , m_clip(&mask)
+    {}
+
+    void copy_hline(int x, int y, unsigned len, const color_type& c)
+    {
+        if (m_clip->clip_hspan(x, y, len) < 0) return;
+        base_type::copy_hline(x, y, len, c);
+    }
+
+    void blend_hline(int x, int y, unsigned len, const color_type& c, cover_type cover)
+    {
+        if (m_clip->clip_hspan(x, y, len) < 0) return;
+        base_type::blend_hline(x, y, len, c, cover);
+    }
+
+    void blend_solid_hspan(int x, int y, unsigned len, const color_type& c,
+                           const cover_type* covers)
+    {
+        const int skip = m_clip->clip_hspan(x, y, len);
+        if (skip < 0) return;
+        base_type::blend_solid_hspan(x, y, len, c, covers + skip);
+    }
+
+    void copy_color_hspan(int x, int y, unsigned len, const color_type* colors)
+    {
+        const int skip = m_clip->clip_hspan(x, y, len);
+        if (skip < 0) return;
+        base_type::copy_color_hspan(x, y, len, colors + skip);
+    }
+
+    void blend_color_hspan(int x, int y, unsigned len, const color_type* colors,
+                           const cover_type* covers, cover_type cover = agg::cover_full)
+    {
+        const int skip = m_clip->clip_hspan(x, y, len);
+        if (skip < 0) return;
+        base_type::blend_color_hspan(x, y, len, colors + skip,
+                                     covers ? covers + skip : covers, cover);
+    }
+
+private:
+    const clip_mask* m_clip;
+};
+
+#endif // CELIAGG_CLIP_PATH_H
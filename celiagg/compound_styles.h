@@ -0,0 +1,261 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_COMPOUND_STYLES_H
+#define CELIAGG_COMPOUND_STYLES_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <agg_basics.h>
+#include <agg_color_gray.h>
+#include <agg_renderer_scanline.h>
+#include <agg_trans_affine.h>
+
+#include "paint.h"
+
+// Adds a style's color to the sum of a pixel's colors for
+// render_compound_layered().
+template<typename color_t>
+AGG_INLINE void compound_add(color_t& dst, const color_t& c, const unsigned cover)
+{
+    dst.add(c, cover);
+}
+
+// AGG's gray32 has no add(), so this does the same as agg::rgba32::add()
+AGG_INLINE void compound_add(agg::gray32& dst, const agg::gray32& c, const unsigned cover)
+{
+    if (cover == agg::cover_mask)
+    {
+        if (c.is_opaque())
+        {
+            dst = c;
+            return;
+        }
+        dst.v += c.v;
+        dst.a += c.a;
+    }
+    else
+    {
+        dst.v += agg::gray32::mult_cover(c.v, cover);
+        dst.a += agg::gray32::mult_cover(c.a, cover);
+    }
+    if (dst.a > 1) dst.a = 1;
+    if (dst.v > dst.a) dst.v = dst.a;
+}
+
+// The style handler for render_compound_layered(). Style N is
+// drawn with paint N.
+template<typename pixfmt_t>
+class CompoundStyles
+{
+public:
+    typedef typename pixfmt_t::color_type color_type;
+    typedef PaintSpanSource<color_type> source_t;
+
+    // `bboxes` holds the x, y, width and height of the device space bounds of
+    // every shape drawn with each paint.
+    CompoundStyles(Paint* const* paints, const size_t count,
+                   const agg::trans_affine& transform, const double* bboxes)
+    : m_colors(count, color_type::no_color())
+    , m_sources(count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (paints[i]->type() == Paint::k_PaintTypeSolid)
+            {
+                m_colors[i] = paints[i]->template solid_color<pixfmt_t>();
+            }
+            else
+            {
+                // Paints without a span source draw nothing
+                m_sources[i].reset(paints[i]->template span_source<pixfmt_t>(transform, bboxes + 4*i));
+            }
+        }
+    }
+
+    bool is_solid(unsigned style) const { return !m_sources[style]; }
+    const color_type& color(unsigned style) const { return m_colors[style]; }
+
+    void generate_span(color_type* span, int x, int y, unsigned len, unsigned style)
+    {
+        m_sources[style]->generate(span, x, y, len);
+    }
+
+private:
+    std::vector<color_type> m_colors;
+    std::vector<std::unique_ptr<source_t> > m_sources;
+};
+
+// Wraps a base renderer for render_compound_layered().
+// The compound renderer sums the colors of all styles sharing a scanline as
+// premultiplied colors and then blends them without covers. Pixel formats
+// which take plain colors get those demultiplied first.
+template<typename renderer_t, typename pixfmt_t>
+class CompoundRenderer
+{
+public:
+    typedef typename renderer_t::color_type color_type;
+    typedef typename color_type::value_type value_type;
+
+    CompoundRenderer(renderer_t& ren) : m_ren(ren) {}
+
+    void blend_hline(int x1, int y, int x2, const color_type& c, agg::cover_type cover)
+    {
+        m_ren.blend_hline(x1, y, x2, c, cover);
+    }
+
+    void blend_solid_hspan(int x, int y, int len, const color_type& c, const agg::cover_type* covers)
+    {
+        m_ren.blend_solid_hspan(x, y, len, c, covers);
+    }
+
+    void blend_color_hspan(int x, int y, int len, color_type* colors,
+                           const agg::cover_type* covers,
+                           agg::cover_type cover = agg::cover_full)
+    {
+        if (covers == 0 && !pixfmt_premultiplied<pixfmt_t>::value)
+        {
+            for (int i = 0; i < len; ++i)
+            {
+                colors[i].demultiply();
+            }
+        }
+        m_ren.blend_color_hspan(x, y, len, colors, covers, cover);
+    }
+
+private:
+    renderer_t& m_ren;
+};
+
+// agg::render_scanlines_compound_layered(), except that the buffer the
+// styles are summed in is cleared with no_color() instead of memset(), which
+// isn't meant for AGG's color types.
+template<typename rasterizer_t, typename scanline_t, typename renderer_t,
+         typename allocator_t, typename style_handler_t>
+void render_compound_layered(rasterizer_t& ras, scanline_t& sl,
+                             renderer_t& ren, allocator_t& alloc,
+                             style_handler_t& sh)
+{
+    typedef typename renderer_t::color_type color_type;
+
+    if (!ras.rewind_scanlines())
+    {
+        return;
+    }
+
+    const int min_x = ras.min_x();
+    const int buffer_len = ras.max_x() - min_x + 2;
+    sl.reset(min_x, ras.max_x());
+
+    color_type* color_span = alloc.allocate(buffer_len * 2);
+    color_type* mix_buffer = color_span + buffer_len;
+    agg::cover_type* cover_buffer = ras.allocate_cover_buffer(buffer_len);
+
+    unsigned num_styles;
+    while ((num_styles = ras.sweep_styles()) > 0)
+    {
+        if (num_styles == 1)
+        {
+            // A single style is drawn directly
+            if (ras.sweep_scanline(sl, 0))
+            {
+                const unsigned style = ras.style(0);
+                if (sh.is_solid(style))
+                {
+                    agg::render_scanline_aa_solid(sl, ren, sh.color(style));
+                }
+                else
+                {
+                    typename scanline_t::const_iterator span = sl.begin();
+                    for (unsigned num_spans = sl.num_spans(); num_spans > 0; --num_spans, ++span)
+                    {
+                        sh.generate_span(color_span, span->x, sl.y(), span->len, style);
+                        ren.blend_color_hspan(span->x, sl.y(), span->len, color_span, span->covers);
+                    }
+                }
+            }
+            continue;
+        }
+
+        const int sl_start = ras.scanline_start();
+        const unsigned sl_len = ras.scanline_length();
+        if (sl_len == 0)
+        {
+            continue;
+        }
+
+        std::fill(mix_buffer + sl_start - min_x, mix_buffer + sl_start - min_x + sl_len,
+                  color_type::no_color());
+        std::fill(cover_buffer + sl_start - min_x, cover_buffer + sl_start - min_x + sl_len,
+                  agg::cover_type(0));
+
+        int sl_y = 0x7FFFFFFF;
+        for (unsigned i = 0; i < num_styles; ++i)
+        {
+            const unsigned style = ras.style(i);
+            const bool solid = sh.is_solid(style);
+            if (!ras.sweep_scanline(sl, i))
+            {
+                continue;
+            }
+
+            sl_y = sl.y();
+            typename scanline_t::const_iterator span = sl.begin();
+            for (unsigned num_spans = sl.num_spans(); num_spans > 0; --num_spans, ++span)
+            {
+                color_type* colors = mix_buffer + span->x - min_x;
+                const agg::cover_type* src_covers = span->covers;
+                agg::cover_type* dst_covers = cover_buffer + span->x - min_x;
+                const color_type* cspan = color_span;
+                if (!solid)
+                {
+                    sh.generate_span(color_span, span->x, sl_y, span->len, style);
+                }
+
+                // Each pixel takes colors until its coverage is full
+                for (int len = span->len; len > 0; --len)
+                {
+                    unsigned cover = *src_covers;
+                    if (*dst_covers + cover > agg::cover_full)
+                    {
+                        cover = agg::cover_full - *dst_covers;
+                    }
+                    if (cover)
+                    {
+                        compound_add(*colors, solid ? sh.color(style) : *cspan, cover);
+                        *dst_covers += cover;
+                    }
+                    ++cspan;
+                    ++colors;
+                    ++src_covers;
+                    ++dst_covers;
+                }
+            }
+        }
+        ren.blend_color_hspan(sl_start, sl_y, sl_len, mix_buffer + sl_start - min_x,
+                              0, agg::cover_full);
+    }
+}
+
+#endif
@@ -0,0 +1,432 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <util/agg_color_conv.h>
+
+#include "conversion.h"
+#include "parallel.h"
+#include "simd.h"
+
+// The layout of one pixel format. Gray formats have all color channels at
+// index 0 and formats without alpha have an alpha index of -1.
+template<typename value_t, int channels, int r, int g, int b, int a>
+struct conv_format
+{
+    typedef value_t value_type;
+    enum { C = channels, R = r, G = g, B = b, A = a };
+    enum { is_gray = channels == 1 };
+};
+
+// The value of a fully saturated channel
+template<typename value_t>
+static double _max_value() { return 1.0; }
+template<> double _max_value<agg::int8u>() { return 255.0; }
+template<> double _max_value<agg::int16u>() { return 65535.0; }
+
+typedef conv_format<agg::int8u, 1, 0, 0, 0, -1> conv_gray8;
+typedef conv_format<agg::int16u, 1, 0, 0, 0, -1> conv_gray16;
+typedef conv_format<float, 1, 0, 0, 0, -1> conv_gray32;
+typedef conv_format<agg::int8u, 3, 2, 1, 0, -1> conv_bgr24;
+typedef conv_format<agg::int8u, 3, 0, 1, 2, -1> conv_rgb24;
+typedef conv_format<agg::int16u, 3, 2, 1, 0, -1> conv_bgr48;
+typedef conv_format<agg::int16u, 3, 0, 1, 2, -1> conv_rgb48;
+typedef conv_format<float, 3, 2, 1, 0, -1> conv_bgr96;
+typedef conv_format<float, 3, 0, 1, 2, -1> conv_rgb96;
+typedef conv_format<agg::int8u, 4, 2, 1, 0, 3> conv_bgra32;
+typedef conv_format<agg::int8u, 4, 0, 1, 2, 3> conv_rgba32;
+typedef conv_format<agg::int8u, 4, 1, 2, 3, 0> conv_argb32;
+typedef conv_format<agg::int8u, 4, 3, 2, 1, 0> conv_abgr32;
+typedef conv_format<agg::int16u, 4, 2, 1, 0, 3> conv_bgra64;
+typedef conv_format<agg::int16u, 4, 0, 1, 2, 3> conv_rgba64;
+typedef conv_format<agg::int16u, 4, 1, 2, 3, 0> conv_argb64;
+typedef conv_format<agg::int16u, 4, 3, 2, 1, 0> conv_abgr64;
+typedef conv_format<float, 4, 2, 1, 0, 3> conv_bgra128;
+typedef conv_format<float, 4, 0, 1, 2, 3> conv_rgba128;
+typedef conv_format<float, 4, 1, 2, 3, 0> conv_argb128;
+typedef conv_format<float, 4, 3, 2, 1, 0> conv_abgr128;
+
+// Stores a scaled channel value. Integer channels are clamped to their range,
+// with NaN going to 0, and rounded. Float channels are stored as they are.
+template<typename value_t>
+static value_t _channel(const double value)
+{
+    const double max = _max_value<value_t>();
+    return value_t(!(value > 0.0) ? 0.0 : value >= max ? max : value + 0.5);
+}
+template<> float _channel<float>(const double value) { return float(value); }
+
+// Row converter for agg::color_conv(). Values are scaled in double precision
+// and stored with _channel().
+template<typename dst_t, typename src_t>
+struct conv_row_generic
+{
+    typedef typename dst_t::value_type dst_value_t;
+    typedef typename src_t::value_type src_value_t;
+
+    conv_row_generic(const AlphaConversion alpha) : m_alpha(alpha) {}
+
+    void operator()(agg::int8u* dst_row, const agg::int8u* src_row, unsigned width) const
+    {
+        const double dst_max = _max_value<dst_value_t>();
+        const double src_max = _max_value<src_value_t>();
+        const double scale = dst_max / src_max;
+        const double gray_scale = scale / 3.0;
+        dst_value_t* dst = reinterpret_cast<dst_value_t*>(dst_row);
+        const src_value_t* src = reinterpret_cast<const src_value_t*>(src_row);
+
+        // Sources without alpha are opaque, which makes them both
+        // premultiplied and straight
+        const bool convert_alpha = src_t::A >= 0 && m_alpha != k_AlphaKeep;
+        const unsigned src_a = src_t::A < 0 ? 0 : src_t::A;
+        const unsigned dst_a = dst_t::A < 0 ? 0 : dst_t::A;
+
+        for (; width > 0; --width, dst += dst_t::C, src += src_t::C)
+        {
+            if (convert_alpha)
+            {
+                double r = src[src_t::R], g = src[src_t::G], b = src[src_t::B];
+                const double a = src[src_a] / src_max;
+                if (m_alpha == k_AlphaPremultiply)
+                {
+                    r *= a; g *= a; b *= a;
+                }
+                else if (a > 0.0)
+                {
+                    const double inv_a = 1.0 / a;
+                    r = std::min(r * inv_a, src_max);
+                    g = std::min(g * inv_a, src_max);
+                    b = std::min(b * inv_a, src_max);
+                }
+                else
+                {
+                    r = g = b = 0.0;
+                }
+
+                if (dst_t::is_gray)
+                {
+                    dst[0] = _channel<dst_value_t>((r + g + b) * gray_scale);
+                }
+                else
+                {
+                    dst[dst_t::R] = _channel<dst_value_t>(r * scale);
+                    dst[dst_t::G] = _channel<dst_value_t>(g * scale);
+                    dst[dst_t::B] = _channel<dst_value_t>(b * scale);
+                }
+                if (dst_t::A >= 0)
+                {
+                    dst[dst_a] = _channel<dst_value_t>(src[src_a] * scale);
+                }
+                continue;
+            }
+
+            if (dst_t::is_gray && !src_t::is_gray)
+            {
+                const double sum = double(src[src_t::R]) + double(src[src_t::G]) + double(src[src_t::B]);
+                dst[0] = _channel<dst_value_t>(sum * gray_scale);
+                continue;
+            }
+
+            dst[dst_t::R] = _channel<dst_value_t>(src[src_t::R] * scale);
+            if (!dst_t::is_gray)
+            {
+                dst[dst_t::G] = _channel<dst_value_t>(src[src_t::G] * scale);
+                dst[dst_t::B] = _channel<dst_value_t>(src[src_t::B] * scale);
+            }
+            if (dst_t::A >= 0)
+            {
+                dst[dst_a] = src_t::A >= 0 ? _channel<dst_value_t>(src[src_a] * scale) : dst_value_t(dst_max);
+            }
+        }
+    }
+
+    const AlphaConversion m_alpha;
+};
+
+template<typename dst_t, typename src_t>
+struct conv_row : public conv_row_generic<dst_t, src_t>
+{
+    conv_row(const AlphaConversion alpha) : conv_row_generic<dst_t, src_t>(alpha) {}
+};
+
+// The source channel of each destination channel of a pixel with alpha
+template<int dr, int dg, int db, int da, int sr, int sg, int sb, int sa>
+struct conv_swizzle
+{
+    enum
+    {
+        S0 = dr == 0 ? sr : dg == 0 ? sg : db == 0 ? sb : sa,
+        S1 = dr == 1 ? sr : dg == 1 ? sg : db == 1 ? sb : sa,
+        S2 = dr == 2 ? sr : dg == 2 ? sg : db == 2 ? sb : sa,
+        S3 = dr == 3 ? sr : dg == 3 ? sg : db == 3 ? sb : sa,
+    };
+};
+
+// Reordering the channels of 8 bit pixels with alpha is a byte shuffle
+template<int dr, int dg, int db, int da, int sr, int sg, int sb, int sa>
+struct conv_row<conv_format<agg::int8u, 4, dr, dg, db, da>,
+                conv_format<agg::int8u, 4, sr, sg, sb, sa> >
+: public conv_row_generic<conv_format<agg::int8u, 4, dr, dg, db, da>,
+                          conv_format<agg::int8u, 4, sr, sg, sb, sa> >
+{
+    typedef conv_row_generic<conv_format<agg::int8u, 4, dr, dg, db, da>,
+                             conv_format<agg::int8u, 4, sr, sg, sb, sa> > base_t;
+    typedef conv_swizzle<dr, dg, db, da, sr, sg, sb, sa> swizzle_t;
+    enum { S0 = swizzle_t::S0, S1 = swizzle_t::S1, S2 = swizzle_t::S2, S3 = swizzle_t::S3 };
+
+    conv_row(const AlphaConversion alpha) : base_t(alpha) {}
+
+    void operator()(agg::int8u* dst, const agg::int8u* src, unsigned width) const
+    {
+        if (this->m_alpha != k_AlphaKeep)
+        {
+            base_t::operator()(dst, src, width);
+            return;
+        }
+
+#if defined(CELIAGG_HAVE_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        for (; width >= 4; width -= 4, dst += 16, src += 16)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+            __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+            lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(S3, S2, S1, S0)), _MM_SHUFFLE(S3, S2, S1, S0));
+            hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(S3, S2, S1, S0)), _MM_SHUFFLE(S3, S2, S1, S0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; width > 0; --width, dst += 4, src += 4)
+        {
+            const agg::int8u p0 = src[S0], p1 = src[S1], p2 = src[S2], p3 = src[S3];
+            dst[0] = p0; dst[1] = p1; dst[2] = p2; dst[3] = p3;
+        }
+    }
+};
+
+#if defined(CELIAGG_HAVE_SSE2)
+// Float pixels with alpha to 8 bit pixels, scaling, clamping and rounding in
+// double precision to match the generic converter
+template<int dr, int dg, int db, int da, int sr, int sg, int sb, int sa>
+struct conv_row<conv_format<agg::int8u, 4, dr, dg, db, da>,
+                conv_format<float, 4, sr, sg, sb, sa> >
+: public conv_row_generic<conv_format<agg::int8u, 4, dr, dg, db, da>,
+                          conv_format<float, 4, sr, sg, sb, sa> >
+{
+    typedef conv_row_generic<conv_format<agg::int8u, 4, dr, dg, db, da>,
+                             conv_format<float, 4, sr, sg, sb, sa> > base_t;
+    typedef conv_swizzle<dr, dg, db, da, sr, sg, sb, sa> swizzle_t;
+    enum { S0 = swizzle_t::S0, S1 = swizzle_t::S1, S2 = swizzle_t::S2, S3 = swizzle_t::S3 };
+
+    conv_row(const AlphaConversion alpha) : base_t(alpha) {}
+
+    void operator()(agg::int8u* dst_row, const agg::int8u* src_row, unsigned width) const
+    {
+        if (this->m_alpha != k_AlphaKeep)
+        {
+            base_t::operator()(dst_row, src_row, width);
+            return;
+        }
+
+        const float* src = reinterpret_cast<const float*>(src_row);
+        const __m128d scale = _mm_set1_pd(255.0);
+        const __m128d half = _mm_set1_pd(0.5);
+        const __m128d zero_pd = _mm_setzero_pd();
+        const __m128i zero = _mm_setzero_si128();
+        for (; width > 0; --width, dst_row += 4, src += 4)
+        {
+            const __m128 pixel = _mm_loadu_ps(src);
+            // max() picks its second operand for NaN, which sends NaN to 0
+            const __m128d lo_pd = _mm_min_pd(_mm_max_pd(_mm_mul_pd(_mm_cvtps_pd(pixel), scale), zero_pd), scale);
+            const __m128d hi_pd = _mm_min_pd(_mm_max_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(pixel, pixel)), scale), zero_pd), scale);
+            const __m128i lo = _mm_cvttpd_epi32(_mm_add_pd(lo_pd, half));
+            const __m128i hi = _mm_cvttpd_epi32(_mm_add_pd(hi_pd, half));
+            const __m128i values = _mm_shuffle_epi32(_mm_unpacklo_epi64(lo, hi), _MM_SHUFFLE(S3, S2, S1, S0));
+            const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(values, zero), zero));
+            memcpy(dst_row, &packed, 4);
+        }
+    }
+};
+
+// 8 bit pixels with alpha to float pixels
+template<int dr, int dg, int db, int da, int sr, int sg, int sb, int sa>
+struct conv_row<conv_format<float, 4, dr, dg, db, da>,
+                conv_format<agg::int8u, 4, sr, sg, sb, sa> >
+: public conv_row_generic<conv_format<float, 4, dr, dg, db, da>,
+                          conv_format<agg::int8u, 4, sr, sg, sb, sa> >
+{
+    typedef conv_row_generic<conv_format<float, 4, dr, dg, db, da>,
+                             conv_format<agg::int8u, 4, sr, sg, sb, sa> > base_t;
+    typedef conv_swizzle<dr, dg, db, da, sr, sg, sb, sa> swizzle_t;
+    enum { S0 = swizzle_t::S0, S1 = swizzle_t::S1, S2 = swizzle_t::S2, S3 = swizzle_t::S3 };
+
+    conv_row(const AlphaConversion alpha) : base_t(alpha) {}
+
+    void operator()(agg::int8u* dst_row, const agg::int8u* src, unsigned width) const
+    {
+        if (this->m_alpha != k_AlphaKeep)
+        {
+            base_t::operator()(dst_row, src, width);
+            return;
+        }
+
+        float* dst = reinterpret_cast<float*>(dst_row);
+        const __m128d scale = _mm_set1_pd(1.0 / 255.0);
+        const __m128i zero = _mm_setzero_si128();
+        for (; width > 0; --width, dst += 4, src += 4)
+        {
+            int packed;
+            memcpy(&packed, src, 4);
+            __m128i values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+            values = _mm_shuffle_epi32(values, _MM_SHUFFLE(S3, S2, S1, S0));
+            const __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(values), scale));
+            const __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(values, values)), scale));
+            _mm_storeu_ps(dst, _mm_movelh_ps(lo, hi));
+        }
+    }
+};
+#endif
+
+template<typename dst_t, typename src_t>
+static void _convert(agg::rendering_buffer& dst, const agg::rendering_buffer& src,
+                     const AlphaConversion alpha)
+{
+    agg::color_conv(&dst, &src, conv_row<dst_t, src_t>(alpha));
+}
+
+template<typename src_t>
+static bool _convert_from(agg::rendering_buffer& dst, const PixelFormat dst_format,
+                          const agg::rendering_buffer& src, const AlphaConversion alpha)
+{
+    switch (dst_format)
+    {
+        case k_PixelFormatGray8: _convert<conv_gray8, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatGray16: _convert<conv_gray16, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatGray32: _convert<conv_gray32, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatBGR24: _convert<conv_bgr24, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatRGB24: _convert<conv_rgb24, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatBGR48: _convert<conv_bgr48, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatRGB48: _convert<conv_rgb48, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatBGR96: _convert<conv_bgr96, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatRGB96: _convert<conv_rgb96, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatBGRA32:
+        case k_PixelFormatBGRA32Pre: _convert<conv_bgra32, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatRGBA32:
+        case k_PixelFormatRGBA32Pre: _convert<conv_rgba32, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatARGB32: _convert<conv_argb32, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatABGR32: _convert<conv_abgr32, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatBGRA64: _convert<conv_bgra64, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatRGBA64: _convert<conv_rgba64, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatARGB64: _convert<conv_argb64, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatABGR64: _convert<conv_abgr64, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatBGRA128: _convert<conv_bgra128, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatRGBA128:
+        case k_PixelFormatRGBA128Pre: _convert<conv_rgba128, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatARGB128: _convert<conv_argb128, src_t>(dst, src, alpha); return true;
+        case k_PixelFormatABGR128: _convert<conv_abgr128, src_t>(dst, src, alpha); return true;
+        default: return false;
+    }
+}
+
+static bool _convert_rows(unsigned char* dst, const int dst_stride, const PixelFormat dst_format,
+                          const unsigned char* src, const int src_stride, const PixelFormat src_format,
+                          const unsigned width, const unsigned height, const AlphaConversion alpha)
+{
+    agg::rendering_buffer dst_buf(dst, width, height, dst_stride);
+    agg::rendering_buffer src_buf(const_cast<unsigned char*>(src), width, height, src_stride);
+
+    switch (src_format)
+    {
+        case k_PixelFormatGray8: return _convert_from<conv_gray8>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatGray16: return _convert_from<conv_gray16>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatGray32: return _convert_from<conv_gray32>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatBGR24: return _convert_from<conv_bgr24>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatRGB24: return _convert_from<conv_rgb24>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatBGR48: return _convert_from<conv_bgr48>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatRGB48: return _convert_from<conv_rgb48>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatBGR96: return _convert_from<conv_bgr96>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatRGB96: return _convert_from<conv_rgb96>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatBGRA32:
+        case k_PixelFormatBGRA32Pre: return _convert_from<conv_bgra32>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatRGBA32:
+        case k_PixelFormatRGBA32Pre: return _convert_from<conv_rgba32>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatARGB32: return _convert_from<conv_argb32>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatABGR32: return _convert_from<conv_abgr32>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatBGRA64: return _convert_from<conv_bgra64>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatRGBA64: return _convert_from<conv_rgba64>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatARGB64: return _convert_from<conv_argb64>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatABGR64: return _convert_from<conv_abgr64>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatBGRA128: return _convert_from<conv_bgra128>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatRGBA128:
+        case k_PixelFormatRGBA128Pre: return _convert_from<conv_rgba128>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatARGB128: return _convert_from<conv_argb128>(dst_buf, dst_format, src_buf, alpha);
+        case k_PixelFormatABGR128: return _convert_from<conv_abgr128>(dst_buf, dst_format, src_buf, alpha);
+        default: return false;
+    }
+}
+
+static bool _is_premultiplied(const PixelFormat format)
+{
+    return format == k_PixelFormatBGRA32Pre || format == k_PixelFormatRGBA32Pre ||
+           format == k_PixelFormatRGBA128Pre;
+}
+
+bool convert_pixels(unsigned char* dst, const int dst_stride, const PixelFormat dst_format,
+                    const unsigned char* src, const int src_stride, const PixelFormat src_format,
+                    const unsigned width, const unsigned height,
+                    AlphaConversion alpha, const unsigned threads)
+{
+    // Converting between straight and premultiplied formats converts alpha
+    if (alpha == k_AlphaKeep && _is_premultiplied(src_format) != _is_premultiplied(dst_format))
+    {
+        alpha = _is_premultiplied(dst_format) ? k_AlphaPremultiply : k_AlphaDemultiply;
+    }
+
+    // Converting no rows only checks the formats
+    if (!_convert_rows(dst, dst_stride, dst_format, src, src_stride, src_format, width, 0, alpha))
+    {
+        return false;
+    }
+
+    // Threads aren't worth starting for small images
+    const size_t k_MinPixelsPerThread = 1 << 16;
+    const unsigned count = unsigned(std::min<size_t>(threads, size_t(width) * height / k_MinPixelsPerThread));
+    if (count <= 1)
+    {
+        return _convert_rows(dst, dst_stride, dst_format, src, src_stride, src_format, width, height, alpha);
+    }
+
+    ThreadPool pool(count);
+    const unsigned bands = std::min(height, count * 4);
+    pool.run(bands, [&](unsigned index) {
+        const unsigned y0 = unsigned(size_t(height) * index / bands);
+        const unsigned y1 = unsigned(size_t(height) * (index + 1) / bands);
+        _convert_rows(dst + ptrdiff_t(y0) * dst_stride, dst_stride, dst_format,
+                      src + ptrdiff_t(y0) * src_stride, src_stride, src_format,
+                      width, y1 - y0, alpha);
+    });
+    return true;
+}
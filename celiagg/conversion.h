@@ -0,0 +1,47 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_CONVERSION_H
+#define CELIAGG_CONVERSION_H
+
+#include "image.h"
+
+// What happens to colors with alpha during a conversion
+enum AlphaConversion {
+    k_AlphaKeep = 0,
+    k_AlphaPremultiply,
+    k_AlphaDemultiply,
+};
+
+// Converts `height` rows of `width` pixels from `src_format` to
+// `dst_format`. Values are scaled between the ranges of the two formats,
+// gray values are the average of the red, green and blue channels, and
+// pixels without alpha become opaque. Large images are split into bands of
+// rows which up to `threads` threads convert. Colors are premultiplied or
+// demultiplied when only one of the formats is premultiplied, unless `alpha`
+// asks for something else. Returns false if either format is unknown.
+bool convert_pixels(unsigned char* dst, const int dst_stride, const PixelFormat dst_format,
+                    const unsigned char* src, const int src_stride, const PixelFormat src_format,
+                    const unsigned width, const unsigned height,
+                    AlphaConversion alpha, const unsigned threads);
+
+#endif // CELIAGG_CONVERSION_H
@@ -23,140 +23,78 @@
 #
 # Authors: John Wiggins
 
-cdef _get_component_indices(fmt):
-    order_map = {
-        (0, 0, 0, 0): (PixelFormat.Gray8, PixelFormat.Gray16, PixelFormat.Gray32),
-        (0, 1, 2, 0): (PixelFormat.RGB24, PixelFormat.RGB48, PixelFormat.RGB96),
-        (2, 1, 0, 0): (PixelFormat.BGR24, PixelFormat.BGR48, PixelFormat.BGR96),
-        (0, 1, 2, 3): (PixelFormat.RGBA32, PixelFormat.RGBA64, PixelFormat.RGBA128),
-        (2, 1, 0, 3): (PixelFormat.BGRA32, PixelFormat.BGRA64, PixelFormat.BGRA128),
-        (3, 0, 1, 2): (PixelFormat.ARGB32, PixelFormat.ARGB64, PixelFormat.ARGB128),
-        (3, 2, 1, 0): (PixelFormat.ABGR32, PixelFormat.ABGR64, PixelFormat.ABGR128),
-    }
-    rev_order_map = {f: o for o, fs in order_map.items() for f in fs}
-    return rev_order_map[fmt]
-
-
-cdef bool _has_alpha(fmt):
-    return fmt not in (PixelFormat.Gray8, PixelFormat.Gray16, PixelFormat.Gray32,
-                       PixelFormat.BGR24, PixelFormat.RGB24, PixelFormat.BGR48,
-                       PixelFormat.RGB48,  PixelFormat.BGR96, PixelFormat.RGB96)
-
-
-cdef bool _is_gray(fmt):
-    return fmt in (PixelFormat.Gray8, PixelFormat.Gray16, PixelFormat.Gray32)
-
-
-cdef bool _is_rgb(fmt):
-    return fmt not in (PixelFormat.Gray8, PixelFormat.Gray16, PixelFormat.Gray32)
-
-
-cdef float _get_max_value(dtype):
-    if dtype.kind == 'f':
-        return 1.0
-    return float(numpy.iinfo(dtype).max)
-
-
-cdef gray2rgb(src, dst_order, dtype=None, alpha=False):
-    """Convert gray pixels to RGB[A].
-    """
-    last_dim = (4,) if alpha else (3,)
-    dst = numpy.empty(src.shape + last_dim, dtype=dtype)
-
-    max_from = _get_max_value(src.dtype)
-    max_to = _get_max_value(dst.dtype)
-
-    scaled_src = src[:] * (max_to / max_from)
-    dst[..., dst_order[0]] = scaled_src
-    dst[..., dst_order[1]] = scaled_src
-    dst[..., dst_order[2]] = scaled_src
-    if alpha:
-        dst[..., dst_order[3]] = max_to
-
-    return dst
-
-
-cdef rgb2rgb(src, src_order, dst_order, dtype=None, alpha=False):
-    """Convert RGB[A] pixels to RGB[A] pixels.
-    """
-    last_dim = (4,) if alpha else (3,)
-    dst = numpy.empty(src.shape[:2] + last_dim, dtype=dtype)
-
-    max_from = _get_max_value(src.dtype)
-    max_to = _get_max_value(dst.dtype)
-    value_scale = (max_to / max_from)
-
-    dst[..., dst_order[0]] = src[..., src_order[0]] * value_scale
-    dst[..., dst_order[1]] = src[..., src_order[1]] * value_scale
-    dst[..., dst_order[2]] = src[..., src_order[2]] * value_scale
-    if alpha:
-        if src.shape[2] == 4:
-            dst[..., dst_order[3]] = src[..., src_order[3]] * value_scale
-        else:
-            dst[..., dst_order[3]] = max_to
-
-    return dst
-
-
-cdef gray2gray(src, dtype=None):
-    """Convert gray pixels to gray pixels.
-    """
-    dst = numpy.empty(src.shape, dtype=dtype)
-    max_from = _get_max_value(src.dtype)
-    max_to = _get_max_value(dst.dtype)
-    dst[:] = src[:] * (max_to / max_from)
-    return dst
-
-
-cdef rgb2gray(src, src_order, dtype=None):
-    """Convert RGB[A] pixels to gray.
-    """
-    dst = numpy.empty(src.shape[:2], dtype=dtype)
-
-    max_from = _get_max_value(dst.dtype)
-    max_to = _get_max_value(src.dtype)
-
-    dst[:] = (src[..., src_order[0]] + src[..., src_order[1]] +
-              src[..., src_order[2]]) * (max_to / (3.0 * max_from))
-    return dst
-
-
-def convert_image(src, to_format, bottom_up=False):
-    """convert_image(src, to_format, bottom_up=False)
+def convert_image(src, to_format, bottom_up=False, out=None,
+                  premultiply=False, demultiply=False, int threads=1):
+    """convert_image(src, to_format, bottom_up=False, out=None, premultiply=False, demultiply=False, threads=1)
     Create a new image with a desired pixel format and orientation.
 
+    Converting from a straight format to a premultiplied one such as
+    ``RGBA32Pre`` premultiplies the colors, and the reverse demultiplies them,
+    unless `premultiply` or `demultiply` is given.
+
     :param image: An Image instance
     :param to_format: A PixelFormat describing the desired output format
     :param bottom_up: If True, the image data is flipped in the y axis
+    :param out: An optional numpy array to write the converted pixels into. It
+                must have the shape and dtype of the output format.
+    :param premultiply: If True, colors are multiplied by their alpha
+    :param demultiply: If True, premultiplied colors are divided by their alpha
+    :param threads: The number of threads which can share the work on a large
+                    image
     """
     if not isinstance(src, Image):
         raise TypeError("src must an Image instance")
     if not isinstance(to_format, (int, PixelFormat)):
         raise TypeError("to_format must be a PixelFormat value")
+    if premultiply and demultiply:
+        raise ValueError("premultiply and demultiply can't both be True")
+    if threads < 1:
+        raise ValueError('threads argument must be at least 1.')
 
     to_format = PixelFormat(to_format)
-    from_format = src.format
-    dst_dtype = _get_format_dtype(to_format)
-    cdef bool dst_alpha = _has_alpha(to_format)
-    cdef bool src_gray = _is_gray(from_format)
-    cdef bool dst_gray = _is_gray(to_format)
-    cdef bool src_rgb = _is_rgb(from_format)
-    cdef bool dst_rgb = _is_rgb(to_format)
-
-    src_order = _get_component_indices(from_format)
-    dst_order = _get_component_indices(to_format)
-
-    if src_gray:
-        if dst_gray:
-            dst = gray2gray(src.pixels, dtype=dst_dtype)
-        else:
-            dst = gray2rgb(src.pixels, dst_order, dtype=dst_dtype,
-                           alpha=dst_alpha)
+    cdef PixelFormat from_format = src.format
+    cdef PixelFormat dst_format = to_format
+
+    cdef np.ndarray src_arr = numpy.ascontiguousarray(src.pixels)
+    shape = (src_arr.shape[0], src_arr.shape[1])
+    last_dim = _get_format_last_dim(to_format)
+    if last_dim > 1:
+        shape += (last_dim,)
+    dtype = _get_format_dtype(to_format)
+
+    cdef np.ndarray dst_arr
+    if out is None:
+        dst_arr = numpy.empty(shape, dtype=dtype)
     else:
-        if dst_gray:
-            dst = rgb2gray(src.pixels, src_order, dtype=dst_dtype)
-        else:
-            dst = rgb2rgb(src.pixels, src_order, dst_order, dtype=dst_dtype,
-                          alpha=dst_alpha)
-
-    return Image(dst, to_format, bottom_up=bottom_up)
+        if not isinstance(out, numpy.ndarray):
+            raise TypeError("out must be a numpy array")
+        if out.shape != shape or out.dtype.type is not dtype:
+            msg = "out must be an array of type {} with shape {}"
+            raise ValueError(msg.format(numpy.dtype(dtype).name, shape))
+        if not out.flags.c_contiguous:
+            raise ValueError("out must be C contiguous")
+        if numpy.may_share_memory(out, src_arr):
+            raise ValueError("out can't share memory with src")
+        dst_arr = out
+
+    cdef unsigned char* dst_ptr = <unsigned char*>np.PyArray_DATA(dst_arr)
+    cdef const unsigned char* src_ptr = <unsigned char*>np.PyArray_DATA(src_arr)
+    cdef int dst_stride = dst_arr.strides[0]
+    cdef int src_stride = src_arr.strides[0]
+    cdef unsigned width = src_arr.shape[1]
+    cdef unsigned height = src_arr.shape[0]
+    cdef _conversion.AlphaConversion alpha = _conversion.k_AlphaKeep
+    if premultiply:
+        alpha = _conversion.k_AlphaPremultiply
+    elif demultiply:
+        alpha = _conversion.k_AlphaDemultiply
+    cdef bool ok
+    with nogil:
+        ok = _conversion.convert_pixels(dst_ptr, dst_stride, dst_format,
+                                        src_ptr, src_stride, from_format,
+                                        width, height, alpha, threads)
+    if not ok:
+        raise ValueError("Can't convert from {} to {}".format(
+            PixelFormat(from_format).name, to_format.name))
+
+    return Image(dst_arr, to_format, bottom_up=bottom_up)
@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_DENSITY_CANVAS_H
+#define CELIAGG_DENSITY_CANVAS_H
+
+#include <agg_basics.h>
+#include <agg_rasterizer_scanline_aa.h>
+#include <agg_renderer_base.h>
+#include <agg_renderer_scanline.h>
+#include <agg_rendering_buffer.h>
+#include <agg_scanline_p.h>
+#include <agg_scanline_storage_aa.h>
+#include <agg_scanline_u.h>
+
+#include "graphics_state.h"
+#include "point_templates.h"
+#include "rasterize.h"
+#include "vertex_source.h"
+
+// How much a weight covering a pixel by `cover` adds to it. Integer buffers
+// round to the nearest whole count and never go down.
+template<typename value_t>
+struct density_traits
+{
+    static value_t contribution(const double weight, const unsigned cover)
+    {
+        const double value = weight * cover / double(agg::cover_full) + 0.5;
+        return value > 0.0 ? value_t(value) : value_t(0);
+    }
+};
+
+template<>
+struct density_traits<float>
+{
+    static float contribution(const double weight, const unsigned cover)
+    {
+        return float(weight * cover / double(agg::cover_full));
+    }
+};
+
+// A pixel format for agg::renderer_base which adds coverage to the pixels
+// instead of blending a color with them. The "color" is the weight which
+// full coverage adds.
+template<typename value_t>
+class pixfmt_density
+{
+public:
+    typedef double color_type;
+    typedef agg::rendering_buffer rbuf_type;
+    typedef rbuf_type::row_data row_data;
+    typedef density_traits<value_t> traits_t;
+
+    explicit pixfmt_density(rbuf_type& rb) : m_rbuf(&rb) {}
+
+    unsigned width() const { return m_rbuf->width(); }
+    unsigned height() const { return m_rbuf->height(); }
+
+    void blend_hline(int x, int y, unsigned len,
+                     const color_type& weight, agg::int8u cover)
+    {
+        const value_t value = traits_t::contribution(weight, cover);
+        value_t* p = _row(x, y);
+        do
+        {
+            *p++ += value;
+        }
+        while (--len);
+    }
+
+    void blend_solid_hspan(int x, int y, unsigned len,
+                           const color_type& weight, const agg::int8u* covers)
+    {
+        value_t* p = _row(x, y);
+        do
+        {
+            *p++ += traits_t::contribution(weight, *covers++);
+        }
+        while (--len);
+    }
+
+private:
+    value_t* _row(int x, int y)
+    {
+        return reinterpret_cast<value_t*>(m_rbuf->row_ptr(y)) + x;
+    }
+
+    rbuf_type* m_rbuf;
+};
+
+// Interface to density_canvas which doesn't depend on the value type, for the
+// cython wrapper.
+class density_canvas_base
+{
+public:
+    virtual ~density_canvas_base() {}
+
+    virtual unsigned width() const = 0;
+    virtual unsigned height() const = 0;
+
+    virtual void clear() = 0;
+    virtual void draw_shape(VertexSource& shape,
+                            const agg::trans_affine& transform,
+                            const double weight,
+                            const GraphicsState& gs) = 0;
+    virtual void draw_shape_at_points(VertexSource& shape,
+                                      const double* points,
+                                      const double* weights,
+                                      const size_t point_count,
+                                      const agg::trans_affine& transform,
+                                      const GraphicsState& gs) = 0;
+    virtual void draw_line_segments(const double* segments,
+                                    const double* weights,
+                                    const size_t segment_count,
+                                    const agg::trans_affine& transform,
+                                    const GraphicsState& gs) = 0;
+};
+
+// A canvas which sums the weighted coverage of everything drawn on it into a
+// single channel buffer of `value_t`. Strokes are rasterized the same as they
+// are by ndarray_canvas, but fills aren't widened by a contour, so a filled
+// shape adds its area times its weight. Only the drawing mode, line style,
+// anti-aliasing and clip box of a GraphicsState are used. `weights` may be
+// NULL, in which case every primitive has a weight of 1.
+template<typename value_t>
+class density_canvas : public density_canvas_base
+{
+public:
+    density_canvas(unsigned char* buf,
+                   const unsigned width, const unsigned height, const int stride,
+                   const bool bottom_up = false);
+    virtual ~density_canvas() {}
+
+    unsigned width() const;
+    unsigned height() const;
+
+    void clear();
+    void draw_shape(VertexSource& shape,
+                    const agg::trans_affine& transform,
+                    const double weight,
+                    const GraphicsState& gs);
+    void draw_shape_at_points(VertexSource& shape,
+                              const double* points,
+                              const double* weights,
+                              const size_t point_count,
+                              const agg::trans_affine& transform,
+                              const GraphicsState& gs);
+    void draw_line_segments(const double* segments,
+                            const double* weights,
+                            const size_t segment_count,
+                            const agg::trans_affine& transform,
+                            const GraphicsState& gs);
+
+private:
+    typedef pixfmt_density<value_t> pixfmt_t;
+    typedef agg::renderer_base<pixfmt_t> renderer_t;
+    typedef agg::rasterizer_scanline_aa<> rasterizer_t;
+    void _set_clipping(const GraphicsState& gs);
+    void _render(const double weight);
+
+    agg::rendering_buffer m_renbuf;
+    pixfmt_t m_pixfmt;
+    renderer_t m_renderer;
+    rasterizer_t m_rasterizer;
+    agg::scanline_p8 m_scanline;
+
+    // Not copyable
+    density_canvas(const density_canvas&);
+    density_canvas& operator = (const density_canvas&);
+};
+
+#include "density_canvas.hxx"
+
+#endif // CELIAGG_DENSITY_CANVAS_H
@@ -0,0 +1,183 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstring>
+
+template<typename value_t>
+density_canvas<value_t>::density_canvas(unsigned char* buf,
+    const unsigned width, const unsigned height, const int stride,
+    const bool bottom_up)
+: m_renbuf(buf, width, height, bottom_up ? -stride : stride)
+, m_pixfmt(m_renbuf)
+, m_renderer(m_pixfmt)
+{
+}
+
+template<typename value_t>
+unsigned density_canvas<value_t>::width() const
+{
+    return m_renbuf.width();
+}
+
+template<typename value_t>
+unsigned density_canvas<value_t>::height() const
+{
+    return m_renbuf.height();
+}
+
+template<typename value_t>
+void density_canvas<value_t>::clear()
+{
+    for (unsigned y = 0; y < height(); ++y)
+    {
+        std::memset(m_renbuf.row_ptr(y), 0, width() * sizeof(value_t));
+    }
+}
+
+template<typename value_t>
+void density_canvas<value_t>::draw_shape(VertexSource& shape,
+    const agg::trans_affine& transform, const double weight,
+    const GraphicsState& gs)
+{
+    const GraphicsState::DrawingMode mode = gs.drawing_mode();
+    const bool line = (mode & GraphicsState::DrawStroke) == GraphicsState::DrawStroke;
+    const bool fill = (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill;
+
+    if (!(line || fill) || weight == 0.0) return;
+
+    rasterizer_aa(m_rasterizer, gs.anti_aliased());
+    _set_clipping(gs);
+
+    // The fill and the stroke each add their own coverage
+    if (fill)
+    {
+        rasterize_exact_fill(m_rasterizer, shape, transform, gs);
+        _render(weight);
+    }
+    if (line)
+    {
+        rasterize_stroke(m_rasterizer, shape, transform, gs);
+        _render(weight);
+    }
+}
+
+template<typename value_t>
+void density_canvas<value_t>::draw_shape_at_points(VertexSource& shape,
+    const double* points, const double* weights, const size_t point_count,
+    const agg::trans_affine& transform, const GraphicsState& gs)
+{
+    typedef agg::scanline_u8 scanline_t;
+    typedef PointTemplates::band_t band_t;
+
+    const GraphicsState::DrawingMode mode = gs.drawing_mode();
+    const bool line = (mode & GraphicsState::DrawStroke) == GraphicsState::DrawStroke;
+    const bool fill = (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill;
+
+    if (!(line || fill) || point_count == 0) return;
+
+    const GraphicsState::Rect clip = gs.clip_box();
+    if (!PointTemplates::clip_supported(clip))
+    {
+        for (size_t i = 0; i < point_count; ++i)
+        {
+            const agg::trans_affine pt_mtx =
+                agg::trans_affine_translation(points[i*2], points[i*2+1]) * transform;
+            draw_shape(shape, pt_mtx, weights ? weights[i] : 1.0, gs);
+        }
+        return;
+    }
+
+    int box[4];
+    if (!PointTemplates::visible_box(clip, width(), height(), box)) return;
+
+    // The fill and the stroke each add their own coverage
+    scanline_t scanline;
+    m_renderer.clip_box(box[0], box[1], box[2], box[3]);
+    PointTemplates::draw(m_rasterizer, points, point_count, transform, box,
+                         gs.anti_aliased(), fill, line,
+        [&](const bool stroke, const agg::trans_affine& mtx)
+        {
+            if (stroke)
+            {
+                rasterize_stroke(m_rasterizer, shape, mtx, gs);
+            }
+            else
+            {
+                rasterize_exact_fill(m_rasterizer, shape, mtx, gs);
+            }
+        },
+        [&](const size_t i, const bool stroke, band_t& band)
+        {
+            const double weight = weights ? weights[i] : 1.0;
+            if (weight != 0.0)
+            {
+                agg::render_scanlines_aa_solid(band, scanline, m_renderer, weight);
+            }
+        });
+    m_renderer.reset_clipping(true);
+}
+
+template<typename value_t>
+void density_canvas<value_t>::draw_line_segments(const double* segments,
+    const double* weights, const size_t segment_count,
+    const agg::trans_affine& transform, const GraphicsState& gs)
+{
+    if (segment_count == 0) return;
+
+    rasterizer_aa(m_rasterizer, gs.anti_aliased());
+    _set_clipping(gs);
+
+    // Every segment is stroked on its own, so that crossing segments add up
+    PathSource segment;
+    for (size_t i = 0; i < segment_count; ++i)
+    {
+        const double weight = weights ? weights[i] : 1.0;
+        if (weight == 0.0) continue;
+
+        const double* seg = segments + i*4;
+        segment.reset();
+        segment.move_to(seg[0], seg[1]);
+        segment.line_to(seg[2], seg[3]);
+        rasterize_stroke(m_rasterizer, segment, transform, gs);
+        _render(weight);
+    }
+}
+
+template<typename value_t>
+void density_canvas<value_t>::_set_clipping(const GraphicsState& gs)
+{
+    const GraphicsState::Rect& rect = gs.clip_box();
+    if (rect.is_valid())
+    {
+        m_rasterizer.clip_box(rect.x1, rect.y1, rect.x2, rect.y2);
+    }
+    else
+    {
+        m_rasterizer.reset_clipping();
+    }
+}
+
+template<typename value_t>
+void density_canvas<value_t>::_render(const double weight)
+{
+    agg::render_scanlines_aa_solid(m_rasterizer, m_scanline, m_renderer, weight);
+}
@@ -0,0 +1,228 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2014 WUSTL ZPLAB
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+ctypedef _density_canvas.density_canvas_base density_base_t
+ctypedef _density_canvas.density_canvas[float] density_float_t
+ctypedef _density_canvas.density_canvas[unsigned int] density_uint_t
+
+
+cdef _get_weights(weights, size_t count):
+    weights = numpy.ascontiguousarray(weights, dtype=numpy.float64).reshape(-1)
+    if weights.shape[0] != count:
+        raise ValueError('weights must have one value for each primitive.')
+    return weights
+
+
+cdef class DensityCanvas:
+    """DensityCanvas(array, bottom_up=False)
+    A canvas which adds up the coverage of what is drawn on it instead of
+    blending colors.
+
+    Every pixel which a shape covers has the shape's weight times the
+    covered fraction of the pixel added to it, so a filled shape adds its
+    area times its weight. Unlike the other canvases, fills are not widened
+    to cover the seams between neighbouring shapes. ``float32`` arrays keep the
+    exact sums, while ``uint32`` arrays add each contribution rounded to the
+    nearest whole number, so they count hits when drawing without
+    anti-aliasing.
+
+    Only the drawing mode, line style, anti-aliasing and ``clip_box`` of a
+    ``GraphicsState`` are used. A shape which is filled and stroked adds the
+    coverage of both.
+
+    :param array: A C-contiguous, 2D ``numpy.float32`` or ``numpy.uint32``
+                  array which is added to
+    :param bottom_up: If True, the origin is the bottom left of the array
+    """
+    cdef density_base_t* _this
+    cdef object py_array
+
+    def __cinit__(self, array, bottom_up=False):
+        cdef:
+            float[:,::1] float_array
+            unsigned int[:,::1] uint_array
+            unsigned char* buf
+
+        if not isinstance(array, numpy.ndarray) or array.ndim != 2:
+            raise ValueError('array must be a 2D numpy array.')
+        if array.size == 0:
+            raise ValueError('array must not be empty.')
+
+        if array.dtype == numpy.float32:
+            float_array = array
+            buf = <unsigned char*>&float_array[0][0]
+            self._this = <density_base_t*> new density_float_t(
+                buf, array.shape[1], array.shape[0], array.strides[0],
+                bottom_up
+            )
+        elif array.dtype == numpy.uint32:
+            uint_array = array
+            buf = <unsigned char*>&uint_array[0][0]
+            self._this = <density_base_t*> new density_uint_t(
+                buf, array.shape[1], array.shape[0], array.strides[0],
+                bottom_up
+            )
+        else:
+            raise TypeError('array must have a dtype of float32 or uint32.')
+        self.py_array = array
+
+    def __dealloc__(self):
+        del self._this
+
+    property array:
+        def __get__(self):
+            return self.py_array
+
+    property width:
+        def __get__(self):
+            return self._this.width()
+
+    property height:
+        def __get__(self):
+            return self._this.height()
+
+    def clear(self):
+        """clear()
+        Set every pixel of the canvas to zero.
+        """
+        with nogil:
+            self._this.clear()
+
+    def draw_shape(self, shape, transform, state, weight=1.0):
+        """draw_shape(shape, transform, state, weight=1.0)
+        Add the coverage of a shape to the canvas.
+
+        :param shape: A ``VertexSource`` object
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param weight: What full coverage of a pixel adds to it
+        """
+        if not isinstance(shape, VertexSource):
+            raise TypeError("shape must be a VertexSource (Path, BSpline, etc)")
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+
+        cdef:
+            VertexSource shp = <VertexSource>shape
+            GraphicsState gs = <GraphicsState>state
+            Transform trans = <Transform>transform
+            double wt = weight
+
+        with nogil:
+            self._this.draw_shape(dereference(shp._this),
+                                  dereference(trans._this),
+                                  wt, dereference(gs._this))
+
+    def draw_shape_at_points(self, shape, points, transform, state,
+                             weights=None):
+        """draw_shape_at_points(shape, points, transform, state, weights=None)
+        Add the coverage of a shape at each of a set of points to the canvas.
+
+        As with ``CanvasBase.draw_shape_at_points``, the points are rounded to
+        the nearest quarter of a device pixel, so that the shape only needs to
+        be rasterized once for each sub-pixel offset.
+
+        :param shape: A ``VertexSource`` object
+        :param points: A sequence of (x, y) pairs where the ``shape`` is drawn
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param weights: An optional weight for each point. Defaults to 1.
+        """
+        if not isinstance(shape, VertexSource):
+            raise TypeError("shape must be a VertexSource (Path, BSpline, etc)")
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+
+        cdef:
+            VertexSource shp = <VertexSource>shape
+            double[:,::1] _points = numpy.asarray(points, dtype=numpy.float64,
+                                                  order='c')
+            double[::1] _weights
+            GraphicsState gs = <GraphicsState>state
+            Transform trans = <Transform>transform
+            const double* pts
+            const double* wts = NULL
+
+        if _points.shape[1] != 2:
+            msg = 'Points argument must be an iterable of (x, y) pairs.'
+            raise ValueError(msg)
+
+        if _points.shape[0] == 0:
+            return
+        if weights is not None:
+            _weights = _get_weights(weights, _points.shape[0])
+            wts = &_weights[0]
+
+        pts = &_points[0][0]
+        with nogil:
+            self._this.draw_shape_at_points(dereference(shp._this),
+                                            pts, wts, _points.shape[0],
+                                            dereference(trans._this),
+                                            dereference(gs._this))
+
+    def draw_line_segments(self, segments, transform, state, weights=None):
+        """draw_line_segments(segments, transform, state, weights=None)
+        Add the coverage of the strokes of a set of line segments to the
+        canvas. Each segment is added separately, so pixels where segments
+        cross count all of them.
+
+        :param segments: A sequence of (x1, y1, x2, y2) line segments
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object. Its line width, cap and
+                      dash pattern are used for every segment.
+        :param weights: An optional weight for each segment. Defaults to 1.
+        """
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+
+        cdef:
+            double[:,::1] _segments = numpy.asarray(segments,
+                                                    dtype=numpy.float64,
+                                                    order='c')
+            double[::1] _weights
+            GraphicsState gs = <GraphicsState>state
+            Transform trans = <Transform>transform
+            const double* segs
+            const double* wts = NULL
+
+        if _segments.shape[1] != 4:
+            msg = 'Segments argument must be an iterable of (x1, y1, x2, y2).'
+            raise ValueError(msg)
+
+        if _segments.shape[0] == 0:
+            return
+        if weights is not None:
+            _weights = _get_weights(weights, _segments.shape[0])
+            wts = &_weights[0]
+
+        segs = &_segments[0][0]
+        with nogil:
+            self._this.draw_line_segments(segs, wts, _segments.shape[0],
+                                          dereference(trans._this),
+                                          dereference(gs._this))
@@ -45,6 +45,28 @@ cpdef enum PixelFormat:
     RGBA128 = _enums.k_PixelFormatRGBA128
     ARGB128 = _enums.k_PixelFormatARGB128
     ABGR128 = _enums.k_PixelFormatABGR128
+    BGRA32Pre = _enums.k_PixelFormatBGRA32Pre
+    RGBA32Pre = _enums.k_PixelFormatRGBA32Pre
+    RGBA128Pre = _enums.k_PixelFormatRGBA128Pre
+
+cpdef enum ImageFilter:
+    Nearest = _enums.k_ImageFilterNearest
+    Bilinear = _enums.k_ImageFilterBilinear
+    Bicubic = _enums.k_ImageFilterBicubic
+    Spline16 = _enums.k_ImageFilterSpline16
+    Spline36 = _enums.k_ImageFilterSpline36
+    Hanning = _enums.k_ImageFilterHanning
+    Hamming = _enums.k_ImageFilterHamming
+    Hermite = _enums.k_ImageFilterHermite
+    Kaiser = _enums.k_ImageFilterKaiser
+    Quadric = _enums.k_ImageFilterQuadric
+    Catrom = _enums.k_ImageFilterCatrom
+    Gaussian = _enums.k_ImageFilterGaussian
+    Bessel = _enums.k_ImageFilterBessel
+    Mitchell = _enums.k_ImageFilterMitchell
+    Sinc = _enums.k_ImageFilterSinc
+    Lanczos = _enums.k_ImageFilterLanczos
+    Blackman = _enums.k_ImageFilterBlackman
 
 cpdef enum InnerJoin:
     InnerBevel = _enums.InnerBevel
@@ -107,6 +129,18 @@ cpdef enum BlendMode:
     BlendDifference = _enums.BlendDifference
     BlendExclusion = _enums.BlendExclusion
 
+cpdef enum MarkerType:
+    MarkerSquare = _enums.k_MarkerSquare
+    MarkerDiamond = _enums.k_MarkerDiamond
+    MarkerCircle = _enums.k_MarkerCircle
+    MarkerTriangleUp = _enums.k_MarkerTriangleUp
+    MarkerTriangleDown = _enums.k_MarkerTriangleDown
+    MarkerTriangleLeft = _enums.k_MarkerTriangleLeft
+    MarkerTriangleRight = _enums.k_MarkerTriangleRight
+    MarkerCross = _enums.k_MarkerCross
+    MarkerX = _enums.k_MarkerX
+    MarkerDash = _enums.k_MarkerDash
+
 cpdef enum FontWeight:
     Any = _enums.k_FontWeightAny
     Thin = _enums.k_FontWeightThin
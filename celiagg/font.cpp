@@ -108,3 +108,21 @@ Font::weight(Font::FontWeight const weight)
 {
     m_weight = weight;
 }
+
+bool
+Font::operator == (const Font& other) const
+{
+    return m_face_or_path == other.m_face_or_path &&
+           m_height == other.m_height &&
+           m_weight == other.m_weight &&
+           m_face_index == other.m_face_index &&
+           m_flip == other.m_flip &&
+           m_hinting == other.m_hinting &&
+           m_italic == other.m_italic;
+}
+
+bool
+Font::operator != (const Font& other) const
+{
+    return !(*this == other);
+}
@@ -70,6 +70,9 @@ public:
     FontWeight      weight() const;
     void            weight(FontWeight const weight);
 
+    bool            operator == (const Font& other) const;
+    bool            operator != (const Font& other) const;
+
 private:
 
     std::string     m_face_or_path;
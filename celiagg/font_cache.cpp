@@ -32,6 +32,8 @@ FontCache::FontCache() {}
 FontCache::~FontCache() {}
 void FontCache::activate(const Font&, const agg::trans_affine& transform, GlyphType const type) {}
 double FontCache::measure_width(char const* str) { return 0.0; }
+double FontCache::width(const Font&, char const* str) { return 0.0; }
+std::mutex& FontCache::mutex() { return m_mutex; }
 
 
 #else
@@ -45,6 +47,9 @@ FontCache::FontCache()
 : m_font_engine()
 #endif
 , m_font_cache_manager(m_font_engine)
+, m_active_font("", 0.0)
+, m_active_type(k_GlyphTypeRaster)
+, m_has_active(false)
 {}
 
 FontCache::~FontCache()
@@ -57,6 +62,14 @@ FontCache::~FontCache()
 void
 FontCache::activate(const Font& font, const agg::trans_affine& transform, GlyphType const type)
 {
+    // Loading a face and setting its size is expensive, and text is often
+    // drawn many times in a row with the same font.
+    if (m_has_active && type == m_active_type && font == m_active_font &&
+        transform.is_equal(m_active_transform, 0.0))
+    {
+        return;
+    }
+
 #ifdef _USE_FREETYPE
     m_font_engine.load_font(font.face_or_path(),
                             font.face_index(),
@@ -84,6 +97,11 @@ FontCache::activate(const Font& font, const agg::trans_affine& transform, GlyphT
                               font.weight(),
                               font.italic());
 #endif
+
+    m_active_font = font;
+    m_active_transform = transform;
+    m_active_type = type;
+    m_has_active = true;
 }
 
 double
@@ -94,6 +112,21 @@ FontCache::measure_width(char const* str)
     return iterator.x_offset();
 }
 
+double
+FontCache::width(const Font& font, char const* str)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    activate(font, agg::trans_affine());
+    return measure_width(str);
+}
+
+std::mutex&
+FontCache::mutex()
+{
+    return m_mutex;
+}
+
 FontCache::FontCacheManager&
 FontCache::manager()
 {
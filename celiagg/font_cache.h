@@ -25,6 +25,7 @@
 #ifndef CELIAGG_FONT_CACHE_H
 #define CELIAGG_FONT_CACHE_H
 
+#include <mutex>
 #include <string>
 
 #include <agg_basics.h>
@@ -68,18 +69,34 @@ public:
                                  GlyphType const type = k_GlyphTypeRaster);
     double              measure_width(char const* str);
 
+    // Thread-safe measurement. Locks the cache, activates `font` with an
+    // identity transform and measures `str`.
+    double              width(const Font& font, char const* str);
+
+    // The engine and glyph cache are shared state. Anything which calls
+    // activate() and then iterates glyphs must hold this lock throughout.
+    std::mutex&         mutex();
+
 #ifdef _ENABLE_TEXT_RENDERING
     FontCacheManager&   manager();
 #endif
 
 private:
 
+    std::mutex          m_mutex;
+
 #ifdef _ENABLE_TEXT_RENDERING
 #ifndef _USE_FREETYPE
     HDC                 m_font_dc;  // For font_engine_win32_tt
 #endif
     FontEngine          m_font_engine;
     FontCacheManager    m_font_cache_manager;
+
+    // The last activation. Activating the same font again is a no-op.
+    Font                m_active_font;
+    agg::trans_affine   m_active_transform;
+    GlyphType           m_active_type;
+    bool                m_has_active;
 #endif
 };
 
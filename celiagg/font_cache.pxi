@@ -27,6 +27,10 @@ cdef class FontCache:
     """FontCache()
 
     An object which manages a render cache of glyphs.
+
+    A ``FontCache`` may be shared by canvases which are drawing on different
+    threads. Access to the cache is serialized internally, so text drawing
+    and measurement on a shared cache will not run in parallel.
     """
     cdef _font_cache.FontCache* _this
 
@@ -48,9 +52,12 @@ cdef class FontCache:
 
         cdef:
             FontBase fnt = <FontBase>font
+            const char* c_text
+            double ret
 
         text = _get_utf8_text(text, "Argument must be a unicode string")
+        c_text = text
 
-        # Pass an identity transform
-        self._this.activate(dereference(fnt._this), _transform.trans_affine())
-        return self._this.measure_width(text)
+        with nogil:
+            ret = self._this.width(dereference(fnt._this), c_text)
+        return ret
@@ -0,0 +1,440 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include <agg_dda_line.h>
+
+#include "gradient_span.h"
+#include "simd.h"
+
+typedef GradientIndexParams params_t;
+
+void GradientIndexParams::radial_focus(const double r, const double focus_x,
+    const double focus_y)
+{
+    // Rounded and moved off of the circle like agg::gradient_radial_focus
+    const int ir = agg::iround(r * agg::gradient_subpixel_scale);
+    int ifx = agg::iround(focus_x * agg::gradient_subpixel_scale);
+    int ify = agg::iround(focus_y * agg::gradient_subpixel_scale);
+
+    const double ir2 = double(ir) * double(ir);
+    double d = ir2 - (double(ifx) * double(ifx) + double(ify) * double(ify));
+    if (d == 0)
+    {
+        if (ifx) { if (ifx < 0) ++ifx; else --ifx; }
+        if (ify) { if (ify < 0) ++ify; else --ify; }
+        d = ir2 - (double(ifx) * double(ifx) + double(ify) * double(ify));
+    }
+
+    function = k_FunctionRadialFocus;
+    fx = ifx;
+    fy = ify;
+    r2 = ir2;
+    mul = ir / d;
+}
+
+// The coordinates of a span are stepped like agg::dda2_line_interpolator. Step
+// i of a line with `cnt` steps is at v1 + i*lft + ((i+1)*rem - 1) / cnt, so
+// the vector versions can start each lane at its own step. They compute the
+// gradient in doubles, which hold every intermediate integer exactly, so
+// integer division and modulo become a division followed by truncation or
+// flooring.
+
+enum { k_DownscaleShift = agg::image_subpixel_shift - agg::gradient_subpixel_shift };
+
+// Returns a DDA from v1 to v2 in `len` steps, advanced by `step` steps
+static agg::dda2_line_interpolator _dda_at(const int v1, const int v2,
+    const unsigned len, const unsigned step)
+{
+    agg::dda2_line_interpolator dda(v1, v2, int(len));
+    if (step > 0)
+    {
+        const agg::int64 n = agg::int64(step + 1) * dda.rem() - 1;
+        int data[2];
+        data[0] = int(n % len) + 1 - int(len);
+        data[1] = int(v1 + agg::int64(step) * dda.lft() + n / len);
+        dda.load(data);
+    }
+    return dda;
+}
+
+template<int function>
+static inline int _position(const params_t& p, const int x, const int y)
+{
+    if (function == params_t::k_FunctionX) return x;
+    if (function == params_t::k_FunctionY) return y;
+
+    const double dx = x - int(p.fx);
+    const double dy = y - int(p.fy);
+    const double d2 = dx * p.fy - dy * p.fx;
+    const double d3 = p.r2 * (dx * dx + dy * dy) - d2 * d2;
+    return agg::iround((dx * p.fx + dy * p.fy + std::sqrt(std::fabs(d3))) * p.mul);
+}
+
+template<int spread>
+static inline int _spread(const int d, const int period)
+{
+    if (spread == params_t::k_SpreadRepeat)
+    {
+        int ret = d % period;
+        if (ret < 0) ret += period;
+        return ret;
+    }
+    if (spread == params_t::k_SpreadReflect)
+    {
+        const int period2 = period << 1;
+        int ret = d % period2;
+        if (ret < 0) ret += period2;
+        if (ret >= period) ret = period2 - ret;
+        return ret;
+    }
+    return d;
+}
+
+template<int function, int spread>
+static void _indices_scalar(const params_t& p,
+    const int x1, const int y1, const int x2, const int y2,
+    const unsigned start, const unsigned len, int* indices)
+{
+    const int dd = std::max(p.d2 - p.d1, 1);
+    const int size = int(p.size);
+    agg::dda2_line_interpolator dda_x = _dda_at(x1, x2, len, start);
+    agg::dda2_line_interpolator dda_y = _dda_at(y1, y2, len, start);
+    for (unsigned i = start; i < len; ++i)
+    {
+        const int x = dda_x.y() >> k_DownscaleShift;
+        const int y = dda_y.y() >> k_DownscaleShift;
+        const int d = _spread<spread>(_position<function>(p, x, y), p.d2);
+        const int index = ((d - p.d1) * size) / dd;
+        indices[i] = std::min(std::max(index, 0), size - 1);
+        ++dda_x;
+        ++dda_y;
+    }
+}
+
+#if defined(CELIAGG_HAVE_SSE2)
+// Four consecutive steps of a DDA, which advance four steps at a time
+class DdaLanes
+{
+public:
+    DdaLanes(const int v1, const int v2, const unsigned len)
+    {
+        const agg::dda2_line_interpolator dda(v1, v2, int(len));
+        const agg::int64 rem = dda.rem();
+        const agg::int64 lft = dda.lft();
+        int values[4], mods[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            const agg::int64 n = (i + 1) * rem - 1;
+            values[i] = int(v1 + i * lft + n / len);
+            mods[i] = int(n % len);
+        }
+        m_value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        m_mod = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mods));
+        m_step = _mm_set1_epi32(int(4 * lft + (4 * rem) / len));
+        m_step_mod = _mm_set1_epi32(int((4 * rem) % len));
+        m_count = _mm_set1_epi32(int(len));
+        m_last = _mm_set1_epi32(int(len) - 1);
+    }
+
+    __m128i value() const { return m_value; }
+
+    void next()
+    {
+        m_mod = _mm_add_epi32(m_mod, m_step_mod);
+        const __m128i carry = _mm_cmpgt_epi32(m_mod, m_last);
+        m_mod = _mm_sub_epi32(m_mod, _mm_and_si128(carry, m_count));
+        m_value = _mm_sub_epi32(_mm_add_epi32(m_value, m_step), carry);
+    }
+
+private:
+    __m128i m_value;
+    __m128i m_mod;
+    __m128i m_step;
+    __m128i m_step_mod;
+    __m128i m_count;
+    __m128i m_last;
+};
+
+struct ConstantsSse2
+{
+    explicit ConstantsSse2(const params_t& p)
+    : fx(_mm_set1_pd(p.fx)), fy(_mm_set1_pd(p.fy))
+    , r2(_mm_set1_pd(p.r2)), mul(_mm_set1_pd(p.mul))
+    , period(_mm_set1_pd(double(p.d2))), period2(_mm_set1_pd(2.0 * p.d2))
+    , d1(_mm_set1_pd(double(p.d1))), size(_mm_set1_pd(double(p.size)))
+    , dd(_mm_set1_pd(double(std::max(p.d2 - p.d1, 1))))
+    , last(_mm_set1_pd(double(p.size) - 1.0))
+    {}
+
+    __m128d fx, fy, r2, mul, period, period2, d1, size, dd, last;
+};
+
+static inline __m128d _iround_sse2(__m128d v)
+{
+    const __m128d half = _mm_or_pd(_mm_and_pd(v, _mm_set1_pd(-0.0)), _mm_set1_pd(0.5));
+    return _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_add_pd(v, half)));
+}
+
+static inline __m128d _mod_sse2(__m128d v, __m128d period)
+{
+    const __m128d q = _mm_div_pd(v, period);
+    __m128d fl = _mm_cvtepi32_pd(_mm_cvttpd_epi32(q));
+    fl = _mm_sub_pd(fl, _mm_and_pd(_mm_cmpgt_pd(fl, q), _mm_set1_pd(1.0)));
+    return _mm_sub_pd(v, _mm_mul_pd(fl, period));
+}
+
+// The indices of two pixels, in the low half of the result
+template<int function, int spread>
+static inline __m128i _indices_pd_sse2(const ConstantsSse2& c, __m128d x, __m128d y)
+{
+    __m128d d;
+    if (function == params_t::k_FunctionX)
+    {
+        d = x;
+    }
+    else if (function == params_t::k_FunctionY)
+    {
+        d = y;
+    }
+    else
+    {
+        const __m128d dx = _mm_sub_pd(x, c.fx);
+        const __m128d dy = _mm_sub_pd(y, c.fy);
+        const __m128d d2 = _mm_sub_pd(_mm_mul_pd(dx, c.fy), _mm_mul_pd(dy, c.fx));
+        const __m128d d3 = _mm_sub_pd(
+            _mm_mul_pd(c.r2, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy))),
+            _mm_mul_pd(d2, d2));
+        const __m128d root = _mm_sqrt_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), d3));
+        d = _iround_sse2(_mm_mul_pd(
+            _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, c.fx), _mm_mul_pd(dy, c.fy)), root), c.mul));
+    }
+
+    if (spread == params_t::k_SpreadRepeat)
+    {
+        d = _mod_sse2(d, c.period);
+    }
+    else if (spread == params_t::k_SpreadReflect)
+    {
+        d = _mod_sse2(d, c.period2);
+        const __m128d back = _mm_cmpge_pd(d, c.period);
+        d = _mm_or_pd(_mm_and_pd(back, _mm_sub_pd(c.period2, d)), _mm_andnot_pd(back, d));
+    }
+
+    // max() returns its second operand for NaN
+    __m128d index = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(d, c.d1), c.size), c.dd);
+    index = _mm_min_pd(_mm_max_pd(index, _mm_setzero_pd()), c.last);
+    return _mm_cvttpd_epi32(index);
+}
+
+template<int function, int spread>
+static unsigned _indices_sse2(const params_t& p,
+    const int x1, const int y1, const int x2, const int y2,
+    const unsigned len, int* indices)
+{
+    const ConstantsSse2 c(p);
+    DdaLanes dda_x(x1, x2, len);
+    DdaLanes dda_y(y1, y2, len);
+
+    unsigned i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        const __m128i xs = _mm_srai_epi32(dda_x.value(), k_DownscaleShift);
+        const __m128i ys = _mm_srai_epi32(dda_y.value(), k_DownscaleShift);
+        const __m128i lo = _indices_pd_sse2<function, spread>(c,
+            _mm_cvtepi32_pd(xs), _mm_cvtepi32_pd(ys));
+        const __m128i hi = _indices_pd_sse2<function, spread>(c,
+            _mm_cvtepi32_pd(_mm_srli_si128(xs, 8)), _mm_cvtepi32_pd(_mm_srli_si128(ys, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), _mm_unpacklo_epi64(lo, hi));
+        dda_x.next();
+        dda_y.next();
+    }
+    return i;
+}
+#endif
+
+#if defined(CELIAGG_HAVE_AVX2)
+struct ConstantsAvx2
+{
+    CELIAGG_TARGET_AVX2
+    explicit ConstantsAvx2(const params_t& p)
+    : fx(_mm256_set1_pd(p.fx)), fy(_mm256_set1_pd(p.fy))
+    , r2(_mm256_set1_pd(p.r2)), mul(_mm256_set1_pd(p.mul))
+    , period(_mm256_set1_pd(double(p.d2))), period2(_mm256_set1_pd(2.0 * p.d2))
+    , d1(_mm256_set1_pd(double(p.d1))), size(_mm256_set1_pd(double(p.size)))
+    , dd(_mm256_set1_pd(double(std::max(p.d2 - p.d1, 1))))
+    , last(_mm256_set1_pd(double(p.size) - 1.0))
+    {}
+
+    __m256d fx, fy, r2, mul, period, period2, d1, size, dd, last;
+};
+
+CELIAGG_TARGET_AVX2
+static inline __m256d _iround_avx2(__m256d v)
+{
+    const __m256d half = _mm256_or_pd(_mm256_and_pd(v, _mm256_set1_pd(-0.0)), _mm256_set1_pd(0.5));
+    return _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(_mm256_add_pd(v, half)));
+}
+
+CELIAGG_TARGET_AVX2
+static inline __m256d _mod_avx2(__m256d v, __m256d period)
+{
+    const __m256d fl = _mm256_floor_pd(_mm256_div_pd(v, period));
+    return _mm256_sub_pd(v, _mm256_mul_pd(fl, period));
+}
+
+template<int function, int spread>
+CELIAGG_TARGET_AVX2
+static inline __m128i _indices_pd_avx2(const ConstantsAvx2& c, __m256d x, __m256d y)
+{
+    __m256d d;
+    if (function == params_t::k_FunctionX)
+    {
+        d = x;
+    }
+    else if (function == params_t::k_FunctionY)
+    {
+        d = y;
+    }
+    else
+    {
+        const __m256d dx = _mm256_sub_pd(x, c.fx);
+        const __m256d dy = _mm256_sub_pd(y, c.fy);
+        const __m256d d2 = _mm256_sub_pd(_mm256_mul_pd(dx, c.fy), _mm256_mul_pd(dy, c.fx));
+        const __m256d d3 = _mm256_sub_pd(
+            _mm256_mul_pd(c.r2, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy))),
+            _mm256_mul_pd(d2, d2));
+        const __m256d root = _mm256_sqrt_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), d3));
+        d = _iround_avx2(_mm256_mul_pd(
+            _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, c.fx), _mm256_mul_pd(dy, c.fy)), root), c.mul));
+    }
+
+    if (spread == params_t::k_SpreadRepeat)
+    {
+        d = _mod_avx2(d, c.period);
+    }
+    else if (spread == params_t::k_SpreadReflect)
+    {
+        d = _mod_avx2(d, c.period2);
+        const __m256d back = _mm256_cmp_pd(d, c.period, _CMP_GE_OQ);
+        d = _mm256_blendv_pd(d, _mm256_sub_pd(c.period2, d), back);
+    }
+
+    // max() returns its second operand for NaN
+    __m256d index = _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(d, c.d1), c.size), c.dd);
+    index = _mm256_min_pd(_mm256_max_pd(index, _mm256_setzero_pd()), c.last);
+    return _mm256_cvttpd_epi32(index);
+}
+
+template<int function, int spread>
+CELIAGG_TARGET_AVX2
+static unsigned _indices_avx2(const params_t& p,
+    const int x1, const int y1, const int x2, const int y2,
+    const unsigned len, int* indices)
+{
+    const ConstantsAvx2 c(p);
+    DdaLanes dda_x(x1, x2, len);
+    DdaLanes dda_y(y1, y2, len);
+
+    unsigned i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        const __m128i xs = _mm_srai_epi32(dda_x.value(), k_DownscaleShift);
+        const __m128i ys = _mm_srai_epi32(dda_y.value(), k_DownscaleShift);
+        const __m128i index = _indices_pd_avx2<function, spread>(c,
+            _mm256_cvtepi32_pd(xs), _mm256_cvtepi32_pd(ys));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), index);
+        dda_x.next();
+        dda_y.next();
+    }
+    return i;
+}
+
+#endif
+
+template<int function, int spread>
+static void _indices(const params_t& p,
+    const int x1, const int y1, const int x2, const int y2,
+    const unsigned len, int* indices)
+{
+    unsigned done = 0;
+#if defined(CELIAGG_HAVE_AVX2)
+    static const bool has_avx2 = cpu_has_avx2();
+    if (has_avx2)
+    {
+        done = _indices_avx2<function, spread>(p, x1, y1, x2, y2, len, indices);
+    }
+    else
+#endif
+    {
+#if defined(CELIAGG_HAVE_SSE2)
+        done = _indices_sse2<function, spread>(p, x1, y1, x2, y2, len, indices);
+#endif
+    }
+
+    _indices_scalar<function, spread>(p, x1, y1, x2, y2, done, len, indices);
+}
+
+template<int function>
+static void _indices_spread(const params_t& p,
+    const int x1, const int y1, const int x2, const int y2,
+    const unsigned len, int* indices)
+{
+    // agg::span_gradient divides by zero for a spread gradient with no length
+    const int spread = p.d2 < 1 ? params_t::k_SpreadPad : p.spread;
+    switch (spread)
+    {
+    case params_t::k_SpreadReflect:
+        _indices<function, params_t::k_SpreadReflect>(p, x1, y1, x2, y2, len, indices);
+        break;
+    case params_t::k_SpreadRepeat:
+        _indices<function, params_t::k_SpreadRepeat>(p, x1, y1, x2, y2, len, indices);
+        break;
+    case params_t::k_SpreadPad:
+    default:
+        _indices<function, params_t::k_SpreadPad>(p, x1, y1, x2, y2, len, indices);
+        break;
+    }
+}
+
+void gradient_span_indices(const GradientIndexParams& params,
+    const int x1, const int y1, const int x2, const int y2,
+    const unsigned len, int* indices)
+{
+    if (len == 0) return;
+
+    switch (params.function)
+    {
+    case params_t::k_FunctionY:
+        _indices_spread<params_t::k_FunctionY>(params, x1, y1, x2, y2, len, indices);
+        break;
+    case params_t::k_FunctionRadialFocus:
+        _indices_spread<params_t::k_FunctionRadialFocus>(params, x1, y1, x2, y2, len, indices);
+        break;
+    case params_t::k_FunctionX:
+    default:
+        _indices_spread<params_t::k_FunctionX>(params, x1, y1, x2, y2, len, indices);
+        break;
+    }
+}
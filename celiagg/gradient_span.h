@@ -0,0 +1,82 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_GRADIENT_SPAN_H
+#define CELIAGG_GRADIENT_SPAN_H
+
+#include <agg_basics.h>
+#include <agg_image_filters.h>
+#include <agg_span_gradient.h>
+
+// Describes how the color table positions of a gradient are computed. The
+// functions and spreads are the same as agg::gradient_x, agg::gradient_y and
+// agg::gradient_radial_focus with the pad, reflect and repeat adaptors of
+// agg::span_gradient. Distances are in agg::gradient_subpixel units.
+struct GradientIndexParams
+{
+    enum Function
+    {
+        k_FunctionX = 0,
+        k_FunctionY,
+        k_FunctionRadialFocus
+    };
+
+    enum Spread
+    {
+        k_SpreadPad = 0,
+        k_SpreadReflect,
+        k_SpreadRepeat
+    };
+
+    GradientIndexParams()
+    : function(k_FunctionX), spread(k_SpreadPad), d1(0), d2(0), size(0)
+    , fx(0.0), fy(0.0), r2(0.0), mul(0.0)
+    {}
+
+    // Sets up k_FunctionRadialFocus, with the radius and the focus offset
+    // from the center in user units
+    void radial_focus(const double r, const double focus_x, const double focus_y);
+
+    Function function;
+    Spread spread;
+    int d1;
+    int d2;
+    unsigned size;      // The number of colors in the table
+
+    // The invariants of agg::gradient_radial_focus
+    double fx;
+    double fy;
+    double r2;
+    double mul;
+};
+
+// Computes the color table indices of the `len` pixels of a span, the same as
+// agg::span_gradient does with agg::span_interpolator_linear<>. (x1, y1) and
+// (x2, y2) are the gradient space coordinates of the start and the end of the
+// span in agg::image_subpixel units, as the interpolator computes them. This
+// uses SSE2 or AVX2 when the CPU has them.
+void gradient_span_indices(const GradientIndexParams& params,
+                           const int x1, const int y1,
+                           const int x2, const int y2,
+                           const unsigned len, int* indices);
+
+#endif // CELIAGG_GRADIENT_SPAN_H
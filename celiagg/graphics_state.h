@@ -31,6 +31,7 @@
 #include <agg_math_stroke.h>
 #include <agg_pixfmt_rgba.h>
 
+#include "clip_path.h"
 #include "image.h"
 
 class GraphicsState
@@ -118,10 +119,16 @@ public:
     GraphicsState() :
         m_clip_box(0.0, 0.0, -1.0, -1.0),  // Invalid by default!
         m_stencil(NULL),
+        m_compact_stencil(NULL),
+        m_clip_path(NULL),
+        m_stencil_x(0),
+        m_stencil_y(0),
         m_drawing_mode(DrawFillStroke),
         m_text_drawing_mode(TextDrawRaster),
         m_blend_mode(BlendAlpha),
-        m_image_blend_mode(BlendDst),
+        m_image_blend_mode(BlendAlpha),
+        m_image_filter(k_ImageFilterNearest),
+        m_image_filter_radius(4.0),
         m_master_alpha(1.0),
         m_line_dash_phase(0.0),
         m_miter_limit(1.0),
@@ -130,12 +137,20 @@ public:
         m_line_cap(CapSquare),
         m_line_join(JoinMiter),
         m_inner_join(InnerMiter),
-        m_anti_aliased(true)
+        m_anti_aliased(true),
+        m_fast_hairlines(false),
+        m_decimate_lines(false)
         {}
 
     void anti_aliased(bool aa) { m_anti_aliased = aa; }
     bool anti_aliased() const { return m_anti_aliased; }
 
+    void fast_hairlines(bool fast) { m_fast_hairlines = fast; }
+    bool fast_hairlines() const { return m_fast_hairlines; }
+
+    void decimate_lines(bool decimate) { m_decimate_lines = decimate; }
+    bool decimate_lines() const { return m_decimate_lines; }
+
     void clip_box(Rect r) { m_clip_box = r; }
     void clip_box(double x1, double y1, double x2, double y2) { clip_box(Rect(x1, y1, x2, y2)); }
     Rect clip_box() const { return m_clip_box; }
@@ -152,6 +167,12 @@ public:
     void image_blend_mode(BlendMode m) { m_image_blend_mode = m; }
     BlendMode image_blend_mode() const { return m_image_blend_mode; }
 
+    void image_filter(ImageFilter f) { m_image_filter = f; }
+    ImageFilter image_filter() const { return m_image_filter; }
+
+    void image_filter_radius(double r) { m_image_filter_radius = r; }
+    double image_filter_radius() const { return m_image_filter_radius; }
+
     void master_alpha(double a) { m_master_alpha = a; }
     double master_alpha() const { return m_master_alpha; }
 
@@ -191,14 +212,31 @@ public:
     void stencil(const Image* image) { m_stencil = image; }
     const Image* stencil() const { return m_stencil; }
 
+    void stencil_offset(int x, int y) { m_stencil_x = x; m_stencil_y = y; }
+    int stencil_x() const { return m_stencil_x; }
+    int stencil_y() const { return m_stencil_y; }
+
+    // The stencil as runs, already placed at the stencil offset
+    void compact_stencil(const ClipPath* clip) { m_compact_stencil = clip; }
+    const ClipPath* compact_stencil() const { return m_compact_stencil; }
+
+    void clip_path(const ClipPath* clip) { m_clip_path = clip; }
+    const ClipPath* clip_path() const { return m_clip_path; }
+
 private:
     Rect            m_clip_box;
     DashPattern     m_dashes;
     const Image*    m_stencil;
+    const ClipPath* m_compact_stencil;
+    const ClipPath* m_clip_path;
+    int             m_stencil_x;
+    int             m_stencil_y;
     DrawingMode     m_drawing_mode;
     TextDrawingMode m_text_drawing_mode;
     BlendMode       m_blend_mode;
     BlendMode       m_image_blend_mode;
+    ImageFilter     m_image_filter;
+    double          m_image_filter_radius;
     double          m_master_alpha;
     double          m_line_dash_phase;
     double          m_miter_limit;
@@ -208,6 +246,8 @@ private:
     LineJoin        m_line_join;
     InnerJoin       m_inner_join;
     bool            m_anti_aliased;
+    bool            m_fast_hairlines;
+    bool            m_decimate_lines;
 };
 
 #endif // CELIAGG_GRAPHICS_STATE_H
@@ -97,32 +97,64 @@ cdef class GraphicsState:
 
     * anti_aliased: A boolean denoting whether drawing is anti-aliased or not.
     * drawing_mode: A ``DrawingMode`` value denoting the drawing mode.
+    * fast_hairlines: A boolean denoting whether strokes which are at most one
+                      pixel wide are drawn with a faster outline renderer.
+    * decimate_lines: A boolean denoting whether undashed strokes are reduced
+                      to at most four vertices per pixel column before they
+                      are drawn.
     * text_drawing_mode: A ``TextDrawingMode`` value denoting the text drawing
                          mode.
-    * blend_mode: A ``BlendMode`` for non-image drawing. (ignored)
-    * image_blend_mode: A ``BlendMode`` for image drawing. (ignored)
+    * blend_mode: A ``BlendMode`` for non-image drawing. Only RGBA canvases
+                  support blend modes other than ``BlendAlpha``.
+    * image_blend_mode: A ``BlendMode`` for image drawing.
+    * image_filter: An ``ImageFilter`` value denoting how images are resampled
+                    when they are drawn.
+    * image_filter_radius: The radius of the ``Sinc``, ``Lanczos`` and
+                           ``Blackman`` image filters, from 2 to 8.
     * line_cap: A ``LineCap`` value denoting the style of line ends.
     * line_join: A ``LineJoin`` value denoting the style of joins.
     * inner_join: An ``InnerJoin`` value denoting the style of inner joins.
     * miter_limit: The miter limit
     * inner_miter_limit: The miter limit for inner joins
-    * master_alpha: A master opacity value.
+    * master_alpha: A master opacity value. It applies to shapes, text,
+      images and pattern paints.
     * line_width: The width when stroking lines.
     * clip_box: A ``Rect`` which defines a simple clipping area.
     * line_dash_pattern: A sequence of (dash length, gap length) pairs.
     * line_dash_phase: Where in ``line_dash_pattern`` to start, when drawing.
     * stencil: An ``Image`` with format ``Gray8`` which will mask any drawing.
-               The dimensions must match the size of the canvas that is being
-               drawn to.
+               Nothing is drawn outside of the stencil.
+    * stencil_offset: The (x, y) canvas pixel where the top left corner of the
+                      stencil is placed. Defaults to (0, 0).
+    * compact_stencil: If True, the stencil is stored as runs of equal
+                       coverage, which skips transparent pixels and stores
+                       opaque runs once. The runs are made when the stencil is
+                       set, so later changes to the ``Image`` are not seen.
+    * clip_path: A ``VertexSource``, a (``VertexSource``, ``Transform``)
+                 pair or a sequence of such pairs which clips any drawing to
+                 the inside of the paths. The transforms map the paths to
+                 canvas pixels. The paths are rasterized when they are set,
+                 so later changes to them are not seen.
+                 ``add_clip_path()`` intersects further paths with it.
     """
     cdef _graphics_state.GraphicsState* _this
     cdef Image _stencil_img
+    cdef _clip_path.ClipPath* _compact
+    cdef bool _use_compact
+    cdef _clip_path.ClipPath* _clip
+    cdef tuple _clip_paths
 
     def __cinit__(self):
         self._this = new _graphics_state.GraphicsState()
         self._stencil_img = None
+        self._compact = NULL
+        self._use_compact = False
+        self._clip = NULL
+        self._clip_paths = ()
 
     def __dealloc__(self):
+        del self._compact
+        del self._clip
         del self._this
 
     def __init__(self, **kwargs):
@@ -139,12 +171,19 @@ cdef class GraphicsState:
     def copy(self):
         """Return a deep copy of the object
         """
-        cpy = GraphicsState()
+        cdef GraphicsState cpy = GraphicsState()
         properties = self._propnames()
         properties.remove("stencil")
+        properties.remove("clip_path")
 
         if self._stencil_img is not None:
             cpy.stencil = self._stencil_img.copy()
+        # The coverage is copied rather than made again, since the paths may
+        # have changed since they were rasterized
+        if self._clip != NULL:
+            cpy._clip = new _clip_path.ClipPath(dereference(self._clip))
+            cpy._clip_paths = self._clip_paths
+            cpy._this.clip_path(cpy._clip)
 
         for name in properties:
             value = getattr(self, name)
@@ -152,6 +191,57 @@ cdef class GraphicsState:
 
         return cpy
 
+    def add_clip_path(self, path, transform=None):
+        """add_clip_path(path, transform=None)
+        Clips drawing to the intersection of the current ``clip_path`` and
+        `path`.
+
+        :param path: A ``VertexSource``
+        :param transform: A ``Transform`` which maps `path` to canvas pixels
+        """
+        if not isinstance(path, VertexSource):
+            raise TypeError("path must be a VertexSource")
+        if transform is None:
+            transform = Transform()
+        elif not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform")
+
+        cdef VertexSource source = <VertexSource>path
+        cdef Transform trans = <Transform>transform
+        cdef _clip_path.ClipPath* clip = new _clip_path.ClipPath(
+            dereference(source._this), dereference(trans._this))
+        cdef _clip_path.ClipPath* combined
+        if self._clip != NULL:
+            combined = new _clip_path.ClipPath(dereference(self._clip),
+                                               dereference(clip))
+            del clip
+            del self._clip
+            clip = combined
+
+        self._clip = clip
+        self._clip_paths += ((path, transform.copy()),)
+        self._this.clip_path(clip)
+
+    cdef _update_stencil(self):
+        """Internal. Gives the stencil to the C++ state in the form which
+        ``compact_stencil`` asks for.
+        """
+        cdef Image image = self._stencil_img
+        self._this.stencil(<_image.Image*>0)
+        self._this.compact_stencil(<_clip_path.ClipPath*>0)
+        del self._compact
+        self._compact = NULL
+        if image is None:
+            return
+
+        if self._use_compact:
+            self._compact = new _clip_path.ClipPath(
+                dereference(image._this), self._this.stencil_x(),
+                self._this.stencil_y())
+            self._this.compact_stencil(self._compact)
+        else:
+            self._this.stencil(image._this)
+
     property anti_aliased:
         def __get__(self):
             return self._this.anti_aliased()
@@ -171,6 +261,20 @@ cdef class GraphicsState:
             cdef Rect rect = <Rect>box
             self._this.clip_box(dereference(rect._this))
 
+    property fast_hairlines:
+        def __get__(self):
+            return self._this.fast_hairlines()
+
+        def __set__(self, fast):
+            self._this.fast_hairlines(fast)
+
+    property decimate_lines:
+        def __get__(self):
+            return self._this.decimate_lines()
+
+        def __set__(self, decimate):
+            self._this.decimate_lines(decimate)
+
     property drawing_mode:
         def __get__(self):
             return DrawingMode(self._this.drawing_mode())
@@ -199,6 +303,20 @@ cdef class GraphicsState:
         def __set__(self, BlendMode m):
             self._this.image_blend_mode(m)
 
+    property image_filter:
+        def __get__(self):
+            return ImageFilter(self._this.image_filter())
+
+        def __set__(self, ImageFilter f):
+            self._this.image_filter(f)
+
+    property image_filter_radius:
+        def __get__(self):
+            return self._this.image_filter_radius()
+
+        def __set__(self, double r):
+            self._this.image_filter_radius(r)
+
     property master_alpha:
         def __get__(self):
             return self._this.master_alpha()
@@ -282,10 +400,49 @@ cdef class GraphicsState:
                 raise TypeError("The stencil property must be an Image")
 
             cdef Image image = <Image>img
+            if image is not None and image.format != PixelFormat.Gray8:
+                raise ValueError("Stencil Images must have format Gray8!")
             self._stencil_img = image
-            if self._stencil_img is not None:
-                if image.format != PixelFormat.Gray8:
-                    raise ValueError("Stencil Images must have format Gray8!")
-                self._this.stencil(image._this)
+            self._update_stencil()
+
+    property stencil_offset:
+        def __get__(self):
+            return (self._this.stencil_x(), self._this.stencil_y())
+
+        def __set__(self, offset):
+            x, y = offset
+            self._this.stencil_offset(x, y)
+            if self._use_compact:
+                self._update_stencil()
+
+    property compact_stencil:
+        def __get__(self):
+            return self._use_compact
+
+        def __set__(self, bool compact):
+            if compact != self._use_compact:
+                self._use_compact = compact
+                self._update_stencil()
+
+    property clip_path:
+        def __get__(self):
+            """The (path, transform) pairs which make up the clip path.
+            """
+            return self._clip_paths
+
+        def __set__(self, value):
+            self._this.clip_path(<_clip_path.ClipPath*>0)
+            del self._clip
+            self._clip = NULL
+            self._clip_paths = ()
+            if value is None:
+                return
+
+            if isinstance(value, VertexSource):
+                self.add_clip_path(value)
+            elif len(value) == 2 and isinstance(value[0], VertexSource):
+                path, transform = value
+                self.add_clip_path(path, transform)
             else:
-                self._this.stencil(<_image.Image*>0)
+                for path, transform in value:
+                    self.add_clip_path(path, transform)
@@ -23,13 +23,30 @@
 //
 // Authors: John Wiggins
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <string.h>
+
 #include "image.h"
+#include "simd.h"
 
 Image::Image(unsigned char* buf, unsigned width, unsigned height, int stride)
 : m_buf(buf, width, height, stride)
+, m_mipmap(false)
 {
 }
 
+Image::Image(unsigned width, unsigned height, unsigned pixel_width)
+: m_mipmap(false)
+, m_pixels(size_t(width) * height * pixel_width)
+{
+    m_buf.attach(m_pixels.data(), width, height, int(width * pixel_width));
+}
+
 agg::rendering_buffer& Image::get_buffer()
 {
     return m_buf;
@@ -55,3 +72,260 @@ unsigned Image::width() const
 {
     return m_buf.width();
 }
+
+void Image::invalidate()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_levels.clear();
+}
+
+unsigned Image::mip_level(const agg::trans_affine& transform) const
+{
+    if (!m_mipmap)
+    {
+        return 0;
+    }
+
+    // Pick the largest level which is still at least as big as the image
+    // appears, so that filtering never has to shrink by 2 or more.
+    double scale_x, scale_y;
+    transform.scaling_abs(&scale_x, &scale_y);
+    const double scale = std::max(scale_x, scale_y);
+
+    unsigned level = 0;
+    unsigned width = m_buf.width(), height = m_buf.height();
+    for (double size = 1.0; size * 0.5 >= scale && (width > 1 || height > 1); size *= 0.5)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        ++level;
+    }
+    return level;
+}
+
+template<typename filter_t>
+static agg::image_filter_lut* _new_lut(const filter_t& filter)
+{
+    return new agg::image_filter_lut(filter, true);
+}
+
+static agg::image_filter_lut* _new_lut(const ImageFilter filter, const double radius)
+{
+    switch (filter)
+    {
+        case k_ImageFilterBicubic: return _new_lut(agg::image_filter_bicubic());
+        case k_ImageFilterSpline16: return _new_lut(agg::image_filter_spline16());
+        case k_ImageFilterSpline36: return _new_lut(agg::image_filter_spline36());
+        case k_ImageFilterHanning: return _new_lut(agg::image_filter_hanning());
+        case k_ImageFilterHamming: return _new_lut(agg::image_filter_hamming());
+        case k_ImageFilterHermite: return _new_lut(agg::image_filter_hermite());
+        case k_ImageFilterKaiser: return _new_lut(agg::image_filter_kaiser());
+        case k_ImageFilterQuadric: return _new_lut(agg::image_filter_quadric());
+        case k_ImageFilterCatrom: return _new_lut(agg::image_filter_catrom());
+        case k_ImageFilterGaussian: return _new_lut(agg::image_filter_gaussian());
+        case k_ImageFilterBessel: return _new_lut(agg::image_filter_bessel());
+        case k_ImageFilterMitchell: return _new_lut(agg::image_filter_mitchell());
+        case k_ImageFilterSinc: return _new_lut(agg::image_filter_sinc(radius));
+        case k_ImageFilterLanczos: return _new_lut(agg::image_filter_lanczos(radius));
+        case k_ImageFilterBlackman: return _new_lut(agg::image_filter_blackman(radius));
+        default: return _new_lut(agg::image_filter_bilinear());
+    }
+}
+
+agg::image_filter_lut& cached_image_filter_lut(const ImageFilter filter, double radius)
+{
+    typedef std::pair<int, double> key_t;
+    static std::map<key_t, std::unique_ptr<agg::image_filter_lut> > s_luts;
+    static std::mutex s_mutex;
+
+    // Only some filters have a radius. Keep it small enough that the weight
+    // tables stay a reasonable size.
+    if (filter == k_ImageFilterSinc || filter == k_ImageFilterLanczos ||
+        filter == k_ImageFilterBlackman)
+    {
+        radius = std::min(std::max(radius, 2.0), 8.0);
+    }
+    else
+    {
+        radius = 0.0;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::unique_ptr<agg::image_filter_lut>& lut = s_luts[key_t(filter, radius)];
+    if (!lut)
+    {
+        lut.reset(_new_lut(filter, radius));
+    }
+    return *lut;
+}
+
+// A box one source pixel wide. At half size, each output pixel covers a 2x2
+// block of source pixels with equal weights.
+struct image_filter_box
+{
+    static double radius() { return 0.5; }
+    static double calc_weight(double x) { return x <= 0.5 ? 1.0 : 0.0; }
+};
+
+agg::image_filter_lut& shrink_filter_lut()
+{
+    static agg::image_filter_lut s_lut(image_filter_box(), true);
+    return s_lut;
+}
+
+// Averages two pixels from `row0` and two from `row1` into `out`. The color
+// channels are weighted by alpha. Both versions divide in single precision so
+// that they give the same results.
+#if defined(CELIAGG_HAVE_SSE2)
+static void _shrink_block(const agg::int8u* row0, const agg::int8u* row1,
+                          agg::int8u* out, const unsigned alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i p0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row0)), zero);
+    const __m128i p1 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row1)), zero);
+
+    // Broadcast the alpha of each pixel to its four channels
+    __m128i a0, a1;
+    switch (alpha)
+    {
+        case 0:
+            a0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p0, 0x00), 0x00);
+            a1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p1, 0x00), 0x00);
+            break;
+        default:
+            a0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p0, 0xff), 0xff);
+            a1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p1, 0xff), 0xff);
+            break;
+    }
+
+    // Products are at most 255 * 255, which fits in 16 bits unsigned
+    const __m128i m0 = _mm_mullo_epi16(p0, a0);
+    const __m128i m1 = _mm_mullo_epi16(p1, a1);
+    const __m128i sum = _mm_add_epi32(
+        _mm_add_epi32(_mm_unpacklo_epi16(m0, zero), _mm_unpackhi_epi16(m0, zero)),
+        _mm_add_epi32(_mm_unpacklo_epi16(m1, zero), _mm_unpackhi_epi16(m1, zero)));
+
+    const unsigned total = unsigned(row0[alpha]) + row0[4 + alpha] + row1[alpha] + row1[4 + alpha];
+    if (total == 0)
+    {
+        out[0] = out[1] = out[2] = out[3] = 0;
+        return;
+    }
+
+    const __m128 avg = _mm_add_ps(_mm_div_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(float(total))),
+                                  _mm_set1_ps(0.5f));
+    const __m128i packed = _mm_cvttps_epi32(avg);
+    const int value = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(packed, zero), zero));
+    memcpy(out, &value, 4);
+    out[alpha] = agg::int8u((total + 2) >> 2);
+}
+#else
+static void _shrink_block(const agg::int8u* row0, const agg::int8u* row1,
+                          agg::int8u* out, const unsigned alpha)
+{
+    const unsigned total = unsigned(row0[alpha]) + row0[4 + alpha] + row1[alpha] + row1[4 + alpha];
+    if (total == 0)
+    {
+        out[0] = out[1] = out[2] = out[3] = 0;
+        return;
+    }
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const unsigned sum = row0[i] * row0[alpha] + row0[4 + i] * row0[4 + alpha] +
+                             row1[i] * row1[alpha] + row1[4 + i] * row1[4 + alpha];
+        out[i] = agg::int8u(float(sum) / float(total) + 0.5f);
+    }
+    out[alpha] = agg::int8u((total + 2) >> 2);
+}
+#endif
+
+void shrink_rgba8(agg::rendering_buffer& src, agg::rendering_buffer& dst, const unsigned alpha)
+{
+    const unsigned src_width = src.width();
+    const unsigned src_height = src.height();
+
+    for (unsigned y = 0; y < dst.height(); ++y)
+    {
+        // The last row and column are repeated when the size is odd
+        const agg::int8u* row0 = src.row_ptr(2*y);
+        const agg::int8u* row1 = src.row_ptr(std::min(2*y + 1, src_height - 1));
+        agg::int8u* out = dst.row_ptr(y);
+
+        for (unsigned x = 0; x < dst.width(); ++x, out += 4)
+        {
+            if (2*x + 1 < src_width)
+            {
+                _shrink_block(row0 + 8*x, row1 + 8*x, out, alpha);
+            }
+            else
+            {
+                agg::int8u edge0[8], edge1[8];
+                memcpy(edge0, row0 + 8*x, 4);
+                memcpy(edge0 + 4, row0 + 8*x, 4);
+                memcpy(edge1, row1 + 8*x, 4);
+                memcpy(edge1 + 4, row1 + 8*x, 4);
+                _shrink_block(edge0, edge1, out, alpha);
+            }
+        }
+    }
+}
+
+void scale_alpha_rgba8(agg::rgba8* colors, const unsigned len, const agg::int8u alpha)
+{
+    unsigned i = 0;
+    agg::int8u* values = reinterpret_cast<agg::int8u*>(colors);
+
+#if defined(CELIAGG_HAVE_SSE2)
+    // Each color is one 32 bit lane with alpha in the top byte. The product
+    // is rounded the same way as agg::rgba8::multiply().
+    const __m128i factor = _mm_set1_epi32(alpha);
+    const __m128i half = _mm_set1_epi32(128);
+    const __m128i color_mask = _mm_set1_epi32(0x00ffffff);
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128i* ptr = reinterpret_cast<__m128i*>(values + 4*i);
+        const __m128i pixels = _mm_loadu_si128(ptr);
+        __m128i a = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi32(pixels, 24), factor), half);
+        a = _mm_srli_epi16(_mm_add_epi16(a, _mm_srli_epi16(a, 8)), 8);
+        _mm_storeu_si128(ptr, _mm_or_si128(_mm_and_si128(pixels, color_mask), _mm_slli_epi32(a, 24)));
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        colors[i].a = agg::rgba8::multiply(colors[i].a, alpha);
+    }
+}
+
+void scale_rgba8(agg::rgba8* colors, const unsigned len, const agg::int8u alpha)
+{
+    unsigned i = 0;
+    agg::int8u* values = reinterpret_cast<agg::int8u*>(colors);
+
+#if defined(CELIAGG_HAVE_SSE2)
+    // Every byte is multiplied as a 16 bit lane, rounded the same way as
+    // agg::rgba8::multiply()
+    const __m128i factor = _mm_set1_epi16(alpha);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= len; i += 4)
+    {
+        __m128i* ptr = reinterpret_cast<__m128i*>(values + 4*i);
+        const __m128i pixels = _mm_loadu_si128(ptr);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), factor), half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), factor), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128(ptr, _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; i < len; ++i)
+    {
+        colors[i].r = agg::rgba8::multiply(colors[i].r, alpha);
+        colors[i].g = agg::rgba8::multiply(colors[i].g, alpha);
+        colors[i].b = agg::rgba8::multiply(colors[i].b, alpha);
+        colors[i].a = agg::rgba8::multiply(colors[i].a, alpha);
+    }
+}
@@ -26,14 +26,23 @@
 #ifndef CELIAGG_IMAGE_H
 #define CELIAGG_IMAGE_H
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
 #include <agg_image_accessors.h>
+#include <agg_image_filters.h>
 #include <agg_path_storage.h>
 #include <agg_pixfmt_gray.h>
 #include <agg_pixfmt_rgb.h>
 #include <agg_pixfmt_rgba.h>
 #include <agg_rendering_buffer.h>
+#include <agg_trans_affine.h>
 #include <agg_scanline_u.h>
 #include <agg_span_allocator.h>
+#include <agg_span_converter.h>
 #include <agg_span_image_filter_gray.h>
 #include <agg_span_image_filter_rgb.h>
 #include <agg_span_image_filter_rgba.h>
@@ -48,6 +57,390 @@ typedef agg::span_interpolator_linear<> interpolator_t;
 typedef agg::wrap_mode_reflect wrap_reflect_t;
 typedef agg::wrap_mode_repeat wrap_repeat_t;
 
+// Whether the pixels of `pixfmt_t` have an alpha channel
+template<typename pixfmt_t>
+struct pixfmt_has_alpha { enum { value = 0 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_rgba128> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_rgba64> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_rgba32> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_bgra32> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_argb32> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_abgr32> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_rgba128_pre> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_rgba32_pre> { enum { value = 1 }; };
+template<> struct pixfmt_has_alpha<agg::pixfmt_bgra32_pre> { enum { value = 1 }; };
+
+// Whether `pixfmt_t` blends premultiplied colors. Colors, gradients and images
+// drawn on it are premultiplied first.
+template<typename pixfmt_t>
+struct pixfmt_premultiplied { enum { value = 0 }; };
+template<> struct pixfmt_premultiplied<agg::pixfmt_rgba128_pre> { enum { value = 1 }; };
+template<> struct pixfmt_premultiplied<agg::pixfmt_rgba32_pre> { enum { value = 1 }; };
+template<> struct pixfmt_premultiplied<agg::pixfmt_bgra32_pre> { enum { value = 1 }; };
+
+// Converts `color` to a color which can be drawn on `pixfmt_t`
+template<typename pixfmt_t>
+typename pixfmt_t::color_type pixfmt_color(const agg::rgba& color)
+{
+    agg::rgba c(color);
+    if (pixfmt_premultiplied<pixfmt_t>::value)
+    {
+        c.premultiply();
+    }
+    return typename pixfmt_t::color_type(c);
+}
+
+// An image accessor for the resampling filters. AGG's filters expect
+// premultiplied pixels, so this premultiplies the pixels of an RGBA image as
+// they are read. Reads outside of the image repeat its edge pixels.
+template<typename pixfmt_t>
+class image_accessor_premultiply
+{
+public:
+    typedef pixfmt_t pixfmt_type;
+    typedef typename pixfmt_t::color_type color_type;
+    typedef typename pixfmt_t::order_type order_type;
+    typedef typename pixfmt_t::value_type value_type;
+    enum pix_width_e { pix_width = pixfmt_t::pix_width };
+
+    explicit image_accessor_premultiply(pixfmt_t& pixf) : m_pixf(&pixf) {}
+
+    const agg::int8u* span(int x, int y, unsigned)
+    {
+        m_x = m_x0 = x;
+        m_y = y;
+        return _pixel();
+    }
+
+    const agg::int8u* next_x()
+    {
+        ++m_x;
+        return _pixel();
+    }
+
+    const agg::int8u* next_y()
+    {
+        ++m_y;
+        m_x = m_x0;
+        return _pixel();
+    }
+
+private:
+    const agg::int8u* _pixel()
+    {
+        const int x = std::min(std::max(m_x, 0), int(m_pixf->width()) - 1);
+        const int y = std::min(std::max(m_y, 0), int(m_pixf->height()) - 1);
+        const agg::int8u* ptr = m_pixf->pix_ptr(x, y);
+        const value_type* p = reinterpret_cast<const value_type*>(ptr);
+        if (p[order_type::A] == color_type::full_value())
+        {
+            return ptr;
+        }
+
+        color_type c(p[order_type::R], p[order_type::G], p[order_type::B], p[order_type::A]);
+        c.premultiply();
+        m_pixel[order_type::R] = c.r;
+        m_pixel[order_type::G] = c.g;
+        m_pixel[order_type::B] = c.b;
+        m_pixel[order_type::A] = c.a;
+        return reinterpret_cast<const agg::int8u*>(m_pixel);
+    }
+
+    const pixfmt_t* m_pixf;
+    int m_x, m_x0, m_y;
+    value_type m_pixel[4];
+};
+
+// Demultiplies the colors made by a span generator reading from an
+// image_accessor_premultiply.
+template<typename span_gen_t>
+class span_demultiply : public span_gen_t
+{
+public:
+    typedef typename span_gen_t::color_type color_type;
+
+    template<typename source_t, typename interp_t>
+    span_demultiply(source_t& src, interp_t& inter)
+    : span_gen_t(src, inter)
+    {}
+
+    template<typename source_t, typename interp_t>
+    span_demultiply(source_t& src, interp_t& inter, agg::image_filter_lut& filter)
+    : span_gen_t(src, inter, filter)
+    {}
+
+    void generate(color_type* span, int x, int y, unsigned len)
+    {
+        span_gen_t::generate(span, x, y, len);
+        for (unsigned i = 0; i < len; ++i)
+        {
+            span[i].demultiply();
+        }
+    }
+};
+
+// Multiplies the alpha of `len` colors by `alpha`. Uses SSE2 when it is
+// available.
+void scale_alpha_rgba8(agg::rgba8* colors, const unsigned len, const agg::int8u alpha);
+
+// Multiplies all four channels of `len` colors by `alpha`, which fades
+// premultiplied colors. Uses SSE2 when it is available.
+void scale_rgba8(agg::rgba8* colors, const unsigned len, const agg::int8u alpha);
+
+// A span converter for agg::span_converter which fades the colors of a span
+// by a master alpha. Premultiplied colors have every channel faded.
+template<typename color_t, bool premultiplied = false>
+class span_master_alpha
+{
+public:
+    typedef typename color_t::value_type value_type;
+
+    span_master_alpha(const double alpha)
+    : m_alpha(color_t::from_double(std::min(std::max(alpha, 0.0), 1.0)))
+    {}
+
+    bool is_opaque() const { return m_alpha == color_t::full_value(); }
+
+    void prepare() {}
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        if (is_opaque()) return;
+
+        for (unsigned i = 0; i < len; ++i)
+        {
+            span[i].a = color_t::multiply(span[i].a, m_alpha);
+        }
+    }
+
+private:
+    value_type m_alpha;
+};
+
+template<typename color_t>
+class span_master_alpha<color_t, true>
+{
+public:
+    typedef typename color_t::value_type value_type;
+
+    span_master_alpha(const double alpha)
+    : m_alpha(color_t::from_double(std::min(std::max(alpha, 0.0), 1.0)))
+    {}
+
+    bool is_opaque() const { return m_alpha == color_t::full_value(); }
+
+    void prepare() {}
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        if (is_opaque()) return;
+
+        for (unsigned i = 0; i < len; ++i)
+        {
+            span[i].r = color_t::multiply(span[i].r, m_alpha);
+            span[i].g = color_t::multiply(span[i].g, m_alpha);
+            span[i].b = color_t::multiply(span[i].b, m_alpha);
+            span[i].a = color_t::multiply(span[i].a, m_alpha);
+        }
+    }
+
+private:
+    value_type m_alpha;
+};
+
+template<>
+inline void span_master_alpha<agg::rgba8, false>::generate(agg::rgba8* span, int x, int y, unsigned len)
+{
+    if (!is_opaque())
+    {
+        scale_alpha_rgba8(span, len, m_alpha);
+    }
+}
+
+template<>
+inline void span_master_alpha<agg::rgba8, true>::generate(agg::rgba8* span, int x, int y, unsigned len)
+{
+    if (!is_opaque())
+    {
+        scale_rgba8(span, len, m_alpha);
+    }
+}
+
+// Reads the values of an image with a single float channel. Reads outside of
+// the image repeat its edge values.
+class image_accessor_scalar
+{
+public:
+    explicit image_accessor_scalar(agg::rendering_buffer& buf) : m_buf(&buf) {}
+
+    float value(int x, int y) const
+    {
+        x = std::min(std::max(x, 0), int(m_buf->width()) - 1);
+        y = std::min(std::max(y, 0), int(m_buf->height()) - 1);
+        return reinterpret_cast<const float*>(m_buf->row_ptr(y))[x];
+    }
+
+private:
+    agg::rendering_buffer* m_buf;
+};
+
+// Colors the values of a scalar image with a colormap as it is drawn. Values
+// are sampled first, by nearest neighbor or bilinearly, and then mapped from
+// [vmin, vmax] onto the `color_count` colors, clamping at the ends. NaN values
+// are transparent. A bilinear sample whose nearest value is NaN is also
+// transparent, and otherwise it only blends the values which aren't NaN.
+template<typename color_t>
+class span_image_colormap
+{
+public:
+    typedef color_t color_type;
+
+    span_image_colormap(image_accessor_scalar& source,
+                        interpolator_t& interpolator,
+                        const color_t* colors, const unsigned color_count,
+                        const double vmin, const double vmax,
+                        const bool bilinear)
+    : m_source(&source)
+    , m_interpolator(&interpolator)
+    , m_colors(colors)
+    , m_color_count(color_count)
+    , m_vmin(vmin)
+    , m_scale(vmax != vmin ? color_count / (vmax - vmin) : 0.0)
+    , m_bilinear(bilinear)
+    {}
+
+    void prepare() {}
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        m_interpolator->begin(x + 0.5, y + 0.5, len);
+        do
+        {
+            int sx, sy;
+            m_interpolator->coordinates(&sx, &sy);
+            *span++ = m_bilinear ? _bilinear(sx, sy) : _nearest(sx, sy);
+            ++(*m_interpolator);
+        }
+        while (--len);
+    }
+
+private:
+    color_t _lookup(const double value) const
+    {
+        if (value != value) return color_t::no_color();
+
+        const double pos = (value - m_vmin) * m_scale;
+        if (!(pos > 0.0)) return m_colors[0];
+        if (pos >= m_color_count) return m_colors[m_color_count - 1];
+        return m_colors[unsigned(pos)];
+    }
+
+    color_t _nearest(const int sx, const int sy) const
+    {
+        return _lookup(m_source->value(sx >> agg::image_subpixel_shift,
+                                       sy >> agg::image_subpixel_shift));
+    }
+
+    color_t _bilinear(int sx, int sy) const
+    {
+        sx -= agg::image_subpixel_scale / 2;
+        sy -= agg::image_subpixel_scale / 2;
+
+        const int x0 = sx >> agg::image_subpixel_shift;
+        const int y0 = sy >> agg::image_subpixel_shift;
+        const double fx = double(sx & agg::image_subpixel_mask) / agg::image_subpixel_scale;
+        const double fy = double(sy & agg::image_subpixel_mask) / agg::image_subpixel_scale;
+
+        const float values[4] = {
+            m_source->value(x0, y0), m_source->value(x0 + 1, y0),
+            m_source->value(x0, y0 + 1), m_source->value(x0 + 1, y0 + 1),
+        };
+        const unsigned nearest = (fx >= 0.5 ? 1 : 0) + (fy >= 0.5 ? 2 : 0);
+        if (values[nearest] != values[nearest]) return color_t::no_color();
+
+        const double weights[4] = {
+            (1.0 - fx) * (1.0 - fy), fx * (1.0 - fy),
+            (1.0 - fx) * fy, fx * fy,
+        };
+        double sum = 0.0, total = 0.0;
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            if (weights[i] > 0.0 && values[i] == values[i])
+            {
+                sum += values[i] * weights[i];
+                total += weights[i];
+            }
+        }
+        return _lookup(sum / total);
+    }
+
+    image_accessor_scalar* m_source;
+    interpolator_t* m_interpolator;
+    const color_t* m_colors;
+    unsigned m_color_count;
+    double m_vmin;
+    double m_scale;
+    bool m_bilinear;
+};
+
+// agg::image_accessor_clone, which repeats the edge pixels of an image for
+// reads outside of it, without comparing signed and unsigned widths.
+template<typename pixfmt_t>
+class image_accessor_clone
+{
+public:
+    typedef typename pixfmt_t::color_type color_type;
+    typedef typename pixfmt_t::order_type order_type;
+    typedef typename pixfmt_t::value_type value_type;
+    enum pix_width_e { pix_width = pixfmt_t::pix_width };
+
+    explicit image_accessor_clone(pixfmt_t& pixf) : m_pixf(&pixf) {}
+
+    const agg::int8u* span(int x, int y, unsigned len)
+    {
+        m_x = m_x0 = x;
+        m_y = y;
+        if (y >= 0 && y < int(m_pixf->height()) &&
+            x >= 0 && x + int(len) <= int(m_pixf->width()))
+        {
+            return m_pix_ptr = m_pixf->pix_ptr(x, y);
+        }
+        m_pix_ptr = 0;
+        return _pixel();
+    }
+
+    const agg::int8u* next_x()
+    {
+        if (m_pix_ptr) return m_pix_ptr += pix_width;
+        ++m_x;
+        return _pixel();
+    }
+
+    const agg::int8u* next_y()
+    {
+        ++m_y;
+        m_x = m_x0;
+        if (m_pix_ptr && m_y >= 0 && m_y < int(m_pixf->height()))
+        {
+            return m_pix_ptr = m_pixf->pix_ptr(m_x, m_y);
+        }
+        m_pix_ptr = 0;
+        return _pixel();
+    }
+
+private:
+    const agg::int8u* _pixel() const
+    {
+        const int x = std::min(std::max(m_x, 0), int(m_pixf->width()) - 1);
+        const int y = std::min(std::max(m_y, 0), int(m_pixf->height()) - 1);
+        return m_pixf->pix_ptr(x, y);
+    }
+
+    const pixfmt_t* m_pixf;
+    int m_x, m_x0, m_y;
+    const agg::int8u* m_pix_ptr;
+};
+
+// The *_filter_t span generators are for drawing images with the filters
+// selected by GraphicsState::image_filter(). They repeat the edge pixels of
+// the image instead of blending with a background color.
 template<typename pixfmt_t>
 struct image_filters {};
 
@@ -67,6 +460,10 @@ struct image_filters<agg::pixfmt_rgba128>
     typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_premultiply<pixfmt_t> source_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> > bilinear_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba<source_filter_t, interpolator_t> > general_filter_t;
+    typedef span_demultiply<agg::span_image_resample_rgba_affine<source_filter_t> > resample_filter_t;
 };
 
 template<>
@@ -85,6 +482,10 @@ struct image_filters<agg::pixfmt_rgba32>
     typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_premultiply<pixfmt_t> source_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> > bilinear_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba<source_filter_t, interpolator_t> > general_filter_t;
+    typedef span_demultiply<agg::span_image_resample_rgba_affine<source_filter_t> > resample_filter_t;
 };
 
 template<>
@@ -103,6 +504,10 @@ struct image_filters<agg::pixfmt_bgra32>
     typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_premultiply<pixfmt_t> source_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> > bilinear_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba<source_filter_t, interpolator_t> > general_filter_t;
+    typedef span_demultiply<agg::span_image_resample_rgba_affine<source_filter_t> > resample_filter_t;
 };
 
 template<>
@@ -121,6 +526,10 @@ struct image_filters<agg::pixfmt_argb32>
     typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_premultiply<pixfmt_t> source_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> > bilinear_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba<source_filter_t, interpolator_t> > general_filter_t;
+    typedef span_demultiply<agg::span_image_resample_rgba_affine<source_filter_t> > resample_filter_t;
 };
 
 template<>
@@ -139,6 +548,10 @@ struct image_filters<agg::pixfmt_abgr32>
     typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_premultiply<pixfmt_t> source_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> > bilinear_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba<source_filter_t, interpolator_t> > general_filter_t;
+    typedef span_demultiply<agg::span_image_resample_rgba_affine<source_filter_t> > resample_filter_t;
 };
 
 template<>
@@ -157,6 +570,10 @@ struct image_filters<agg::pixfmt_rgb24>
     typedef agg::span_image_filter_rgb<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgb<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgb<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_rgb_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_rgb<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_rgb_affine<source_filter_t> resample_filter_t;
 };
 
 template<>
@@ -175,6 +592,76 @@ struct image_filters<agg::pixfmt_bgr24>
     typedef agg::span_image_filter_rgb<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_rgb<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_rgb<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_rgb_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_rgb<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_rgb_affine<source_filter_t> resample_filter_t;
+};
+
+template<>
+struct image_filters<agg::pixfmt_rgba64>
+{
+    typedef agg::pixfmt_rgba64 pixfmt_t;
+    typedef agg::image_accessor_clip<pixfmt_t> source_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_reflect_t, wrap_reflect_t> source_reflect_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_repeat_t, wrap_repeat_t> source_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_reflect_t, interpolator_t> bilinear_reflect_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_repeat_t, interpolator_t> bilinear_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_t, interpolator_t> bilinear_t;
+    typedef agg::span_image_filter_rgba_nn<source_reflect_t,  interpolator_t> nearest_reflect_t;
+    typedef agg::span_image_filter_rgba_nn<source_repeat_t,  interpolator_t> nearest_repeat_t;
+    typedef agg::span_image_filter_rgba_nn<source_t,  interpolator_t> nearest_t;
+    typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
+    typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
+    typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_premultiply<pixfmt_t> source_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> > bilinear_filter_t;
+    typedef span_demultiply<agg::span_image_filter_rgba<source_filter_t, interpolator_t> > general_filter_t;
+    typedef span_demultiply<agg::span_image_resample_rgba_affine<source_filter_t> > resample_filter_t;
+};
+
+template<>
+struct image_filters<agg::pixfmt_rgb48>
+{
+    typedef agg::pixfmt_rgb48 pixfmt_t;
+    typedef agg::image_accessor_clip<pixfmt_t> source_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_reflect_t, wrap_reflect_t> source_reflect_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_repeat_t, wrap_repeat_t> source_repeat_t;
+    typedef agg::span_image_filter_rgb_bilinear<source_reflect_t, interpolator_t> bilinear_reflect_t;
+    typedef agg::span_image_filter_rgb_bilinear<source_repeat_t, interpolator_t> bilinear_repeat_t;
+    typedef agg::span_image_filter_rgb_bilinear<source_t, interpolator_t> bilinear_t;
+    typedef agg::span_image_filter_rgb_nn<source_reflect_t,  interpolator_t> nearest_reflect_t;
+    typedef agg::span_image_filter_rgb_nn<source_repeat_t,  interpolator_t> nearest_repeat_t;
+    typedef agg::span_image_filter_rgb_nn<source_t, interpolator_t> nearest_t;
+    typedef agg::span_image_filter_rgb<source_reflect_t, interpolator_t> general_reflect_t;
+    typedef agg::span_image_filter_rgb<source_repeat_t, interpolator_t> general_repeat_t;
+    typedef agg::span_image_filter_rgb<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_rgb_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_rgb<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_rgb_affine<source_filter_t> resample_filter_t;
+};
+
+template<>
+struct image_filters<agg::pixfmt_gray32>
+{
+    typedef agg::pixfmt_gray32 pixfmt_t;
+    typedef agg::image_accessor_clip<pixfmt_t> source_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_reflect_t, wrap_reflect_t> source_reflect_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_repeat_t, wrap_repeat_t> source_repeat_t;
+    typedef agg::span_image_filter_gray_bilinear<source_reflect_t, interpolator_t> bilinear_reflect_t;
+    typedef agg::span_image_filter_gray_bilinear<source_repeat_t, interpolator_t> bilinear_repeat_t;
+    typedef agg::span_image_filter_gray_bilinear<source_t, interpolator_t> bilinear_t;
+    typedef agg::span_image_filter_gray_nn<source_reflect_t,  interpolator_t> nearest_reflect_t;
+    typedef agg::span_image_filter_gray_nn<source_repeat_t,  interpolator_t> nearest_repeat_t;
+    typedef agg::span_image_filter_gray_nn<source_t, interpolator_t> nearest_t;
+    typedef agg::span_image_filter_gray<source_reflect_t, interpolator_t> general_reflect_t;
+    typedef agg::span_image_filter_gray<source_repeat_t, interpolator_t> general_repeat_t;
+    typedef agg::span_image_filter_gray<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_gray_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_gray<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_gray_affine<source_filter_t> resample_filter_t;
 };
 
 template<>
@@ -193,6 +680,10 @@ struct image_filters<agg::pixfmt_gray16>
     typedef agg::span_image_filter_gray<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_gray<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_gray<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_gray_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_gray<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_gray_affine<source_filter_t> resample_filter_t;
 };
 
 template<>
@@ -211,6 +702,76 @@ struct image_filters<agg::pixfmt_gray8>
     typedef agg::span_image_filter_gray<source_reflect_t, interpolator_t> general_reflect_t;
     typedef agg::span_image_filter_gray<source_repeat_t, interpolator_t> general_repeat_t;
     typedef agg::span_image_filter_gray<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_gray_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_gray<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_gray_affine<source_filter_t> resample_filter_t;
+};
+
+template<>
+struct image_filters<agg::pixfmt_rgba128_pre>
+{
+    typedef agg::pixfmt_rgba128_pre pixfmt_t;
+    typedef agg::image_accessor_clip<pixfmt_t> source_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_reflect_t, wrap_reflect_t> source_reflect_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_repeat_t, wrap_repeat_t> source_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_reflect_t, interpolator_t> bilinear_reflect_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_repeat_t, interpolator_t> bilinear_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_t, interpolator_t> bilinear_t;
+    typedef agg::span_image_filter_rgba_nn<source_reflect_t,  interpolator_t> nearest_reflect_t;
+    typedef agg::span_image_filter_rgba_nn<source_repeat_t,  interpolator_t> nearest_repeat_t;
+    typedef agg::span_image_filter_rgba_nn<source_t, interpolator_t> nearest_t;
+    typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
+    typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
+    typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_rgba<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_rgba_affine<source_filter_t> resample_filter_t;
+};
+
+template<>
+struct image_filters<agg::pixfmt_rgba32_pre>
+{
+    typedef agg::pixfmt_rgba32_pre pixfmt_t;
+    typedef agg::image_accessor_clip<pixfmt_t> source_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_reflect_t, wrap_reflect_t> source_reflect_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_repeat_t, wrap_repeat_t> source_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_reflect_t, interpolator_t> bilinear_reflect_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_repeat_t, interpolator_t> bilinear_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_t, interpolator_t> bilinear_t;
+    typedef agg::span_image_filter_rgba_nn<source_reflect_t,  interpolator_t> nearest_reflect_t;
+    typedef agg::span_image_filter_rgba_nn<source_repeat_t,  interpolator_t> nearest_repeat_t;
+    typedef agg::span_image_filter_rgba_nn<source_t, interpolator_t> nearest_t;
+    typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
+    typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
+    typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_rgba<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_rgba_affine<source_filter_t> resample_filter_t;
+};
+
+template<>
+struct image_filters<agg::pixfmt_bgra32_pre>
+{
+    typedef agg::pixfmt_bgra32_pre pixfmt_t;
+    typedef agg::image_accessor_clip<pixfmt_t> source_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_reflect_t, wrap_reflect_t> source_reflect_t;
+    typedef agg::image_accessor_wrap<pixfmt_t, wrap_repeat_t, wrap_repeat_t> source_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_reflect_t, interpolator_t> bilinear_reflect_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_repeat_t, interpolator_t> bilinear_repeat_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_t, interpolator_t> bilinear_t;
+    typedef agg::span_image_filter_rgba_nn<source_reflect_t,  interpolator_t> nearest_reflect_t;
+    typedef agg::span_image_filter_rgba_nn<source_repeat_t,  interpolator_t> nearest_repeat_t;
+    typedef agg::span_image_filter_rgba_nn<source_t, interpolator_t> nearest_t;
+    typedef agg::span_image_filter_rgba<source_reflect_t, interpolator_t> general_reflect_t;
+    typedef agg::span_image_filter_rgba<source_repeat_t, interpolator_t> general_repeat_t;
+    typedef agg::span_image_filter_rgba<source_t, interpolator_t> general_t;
+    typedef image_accessor_clone<pixfmt_t> source_filter_t;
+    typedef agg::span_image_filter_rgba_bilinear<source_filter_t, interpolator_t> bilinear_filter_t;
+    typedef agg::span_image_filter_rgba<source_filter_t, interpolator_t> general_filter_t;
+    typedef agg::span_image_resample_rgba_affine<source_filter_t> resample_filter_t;
 };
 
 
@@ -236,8 +797,47 @@ enum PixelFormat {
     k_PixelFormatRGBA128 = agg::pix_format_rgba128,
     k_PixelFormatARGB128 = agg::pix_format_argb128,
     k_PixelFormatABGR128 = agg::pix_format_abgr128,
+    // Premultiplied formats, which AGG has no pix_format_e values for
+    k_PixelFormatBGRA32Pre = agg::end_of_pix_formats,
+    k_PixelFormatRGBA32Pre,
+    k_PixelFormatRGBA128Pre,
 };
 
+// Resampling filters for drawing images. Sinc, Lanczos and Blackman have an
+// adjustable radius.
+enum ImageFilter {
+    k_ImageFilterNearest,
+    k_ImageFilterBilinear,
+    k_ImageFilterBicubic,
+    k_ImageFilterSpline16,
+    k_ImageFilterSpline36,
+    k_ImageFilterHanning,
+    k_ImageFilterHamming,
+    k_ImageFilterHermite,
+    k_ImageFilterKaiser,
+    k_ImageFilterQuadric,
+    k_ImageFilterCatrom,
+    k_ImageFilterGaussian,
+    k_ImageFilterBessel,
+    k_ImageFilterMitchell,
+    k_ImageFilterSinc,
+    k_ImageFilterLanczos,
+    k_ImageFilterBlackman,
+};
+
+// Halves an 8 bit image with four channels and alpha at byte `alpha` of each
+// pixel. Every 2x2 block of pixels is averaged, weighted by alpha. Uses SSE2
+// when it is available.
+void shrink_rgba8(agg::rendering_buffer& src, agg::rendering_buffer& dst, const unsigned alpha);
+
+// The weights which shrink_rgba8() averages with, for resampling any other
+// pixel format at half size
+agg::image_filter_lut& shrink_filter_lut();
+
+// Returns the weights of `filter`. These are computed once for every filter
+// and radius and then kept for the life of the process.
+agg::image_filter_lut& cached_image_filter_lut(const ImageFilter filter, const double radius);
+
 class Image
 {
     agg::rendering_buffer m_buf;
@@ -249,6 +849,95 @@ public:
     agg::path_storage image_outline() const;
     unsigned height() const;
     unsigned width() const;
+
+    // When enabled, images which are drawn smaller than half of their size
+    // are drawn from a mip level: a copy of the image shrunk by a power of
+    // two. Levels are built the first time they're needed and kept until
+    // invalidate() is called.
+    void mipmap(const bool enable) { m_mipmap = enable; }
+    bool mipmap() const { return m_mipmap; }
+
+    // Discards the mip levels. Call this after changing the image's pixels.
+    void invalidate();
+
+    // The mip level to draw from with `transform`. Level N is 2^N times
+    // smaller than the image, and level 0 is the image itself.
+    unsigned mip_level(const agg::trans_affine& transform) const;
+
+    // Returns mip level `level`, building it if needed. `pixfmt_t` must be
+    // the pixel format of the image.
+    template<typename pixfmt_t>
+    Image& mip(const unsigned level);
+
+private:
+    Image(unsigned width, unsigned height, unsigned pixel_width);
+
+    template<typename pixfmt_t>
+    void _shrink_into(Image& level, std::true_type);
+    template<typename pixfmt_t>
+    void _shrink_into(Image& level, std::false_type);
+
+    bool m_mipmap;
+    std::vector<agg::int8u> m_pixels;
+    std::vector<std::unique_ptr<Image> > m_levels;
+    std::mutex m_mutex;
+
+    // Not copyable
+    Image(const Image&);
+    Image& operator = (const Image&);
 };
 
+template<typename pixfmt_t>
+Image& Image::mip(const unsigned level)
+{
+    if (level == 0)
+    {
+        return *this;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (m_levels.size() < level)
+    {
+        Image& parent = m_levels.empty() ? *this : *m_levels.back();
+        m_levels.emplace_back(new Image((parent.width() + 1) / 2,
+                                        (parent.height() + 1) / 2,
+                                        pixfmt_t::pix_width));
+        parent._shrink_into<pixfmt_t>(*m_levels.back(),
+            std::integral_constant<bool, pixfmt_has_alpha<pixfmt_t>::value &&
+                                         !pixfmt_premultiplied<pixfmt_t>::value &&
+                                         pixfmt_t::pix_width == 4>());
+    }
+    return *m_levels[level - 1];
+}
+
+template<typename pixfmt_t>
+void Image::_shrink_into(Image& level, std::true_type)
+{
+    shrink_rgba8(m_buf, level.get_buffer(), pixfmt_t::order_type::A);
+}
+
+template<typename pixfmt_t>
+void Image::_shrink_into(Image& level, std::false_type)
+{
+    // Other formats are resampled at half size with the same weights
+    typedef image_filters<pixfmt_t> filters_t;
+    typedef typename pixfmt_t::color_type color_type;
+
+    pixfmt_t src_pix(m_buf);
+    pixfmt_t dst_pix(level.get_buffer());
+    typename filters_t::source_filter_t source(src_pix);
+    agg::trans_affine mtx = agg::trans_affine_scaling(2.0);
+    interpolator_t interpolator(mtx);
+    typename filters_t::resample_filter_t span_gen(source, interpolator, shrink_filter_lut());
+
+    const unsigned width = level.width();
+    std::vector<color_type> span(width);
+    span_gen.prepare();
+    for (unsigned y = 0; y < level.height(); ++y)
+    {
+        span_gen.generate(&span[0], 0, int(y), width);
+        dst_pix.copy_color_hspan(0, int(y), width, &span[0]);
+    }
+}
+
 #endif // CELIAGG_IMAGE_H
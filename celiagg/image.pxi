@@ -32,7 +32,8 @@ cdef _get_format_dtype(PixelFormat pixel_format):
         numpy.uint8: (PixelFormat.Gray8, PixelFormat.BGR24,
                       PixelFormat.RGB24, PixelFormat.BGRA32,
                       PixelFormat.RGBA32, PixelFormat.ARGB32,
-                      PixelFormat.ABGR32),
+                      PixelFormat.ABGR32, PixelFormat.BGRA32Pre,
+                      PixelFormat.RGBA32Pre),
         numpy.uint16: (PixelFormat.Gray16, PixelFormat.BGR48,
                        PixelFormat.RGB48, PixelFormat.BGRA64,
                        PixelFormat.RGBA64, PixelFormat.ARGB64,
@@ -40,7 +41,7 @@ cdef _get_format_dtype(PixelFormat pixel_format):
         numpy.float32: (PixelFormat.Gray32, PixelFormat.BGR96,
                         PixelFormat.RGB96, PixelFormat.BGRA128,
                         PixelFormat.RGBA128, PixelFormat.ARGB128,
-                        PixelFormat.ABGR128),
+                        PixelFormat.ABGR128, PixelFormat.RGBA128Pre),
     }
     format_dtypes = {fmt: dt for dt, fmts in dtypes.items() for fmt in fmts}
     return format_dtypes[pixel_format]
@@ -54,7 +55,9 @@ cdef _get_format_last_dim(PixelFormat pixel_format):
         4: (PixelFormat.BGRA32, PixelFormat.RGBA32, PixelFormat.ARGB32,
             PixelFormat.ABGR32, PixelFormat.BGRA64, PixelFormat.RGBA64,
             PixelFormat.ARGB64, PixelFormat.ABGR64, PixelFormat.BGRA128,
-            PixelFormat.RGBA128, PixelFormat.ARGB128, PixelFormat.ABGR128)
+            PixelFormat.RGBA128, PixelFormat.ARGB128, PixelFormat.ABGR128,
+            PixelFormat.BGRA32Pre, PixelFormat.RGBA32Pre,
+            PixelFormat.RGBA128Pre)
     }
     format_dims = {fmt: dim for dim, fmts in dims.items() for fmt in fmts}
     return format_dims[pixel_format]
@@ -111,18 +114,28 @@ cdef img_ptr_t _get_image(array, pixel_format, bottom_up):
 
 
 cdef class Image:
-    """Image(array, pixel_format, bottom_up=False)
+    """Image(array, pixel_format, bottom_up=False, mipmap=False)
 
     :param image: A 2D or 3D numpy array containing image data
     :param pixel_format: A PixelFormat describing the image's pixel format
     :param bottom_up: If True, the image data starts at the bottom of the image
+    :param mipmap: If True, the image is drawn from smaller copies of itself
+                   when it is drawn at less than half of its size. The copies
+                   are made when they are first needed and kept with the
+                   image, so call ``invalidate()`` after changing its pixels.
+
+    Drawing an image on a canvas with a different pixel format converts it to
+    the canvas's format. The converted pixels are also kept with the image
+    until ``invalidate()`` is called or the ``pixels`` are assigned to.
     """
     cdef img_ptr_t _this
     cdef PixelFormat pixel_format
     cdef object pixel_array
     cdef bool bottom_up
+    cdef dict _conversions
 
-    def __cinit__(self, array, PixelFormat pixel_format, bool bottom_up=False):
+    def __cinit__(self, array, PixelFormat pixel_format, bool bottom_up=False,
+                  bool mipmap=False):
         expected_dtype = _get_format_dtype(pixel_format)
         expected_dim = _get_format_last_dim(pixel_format)
 
@@ -147,9 +160,11 @@ cdef class Image:
             raise ValueError(msg.format(pix_fmt_name, expected_dim))
 
         self._this = _get_image(array, pixel_format, bottom_up)
+        self._this.mipmap(mipmap)
         self.pixel_format = pixel_format
         self.pixel_array = array
         self.bottom_up = bottom_up
+        self._conversions = {}
 
     def __dealloc__(self):
         del self._this
@@ -158,7 +173,31 @@ cdef class Image:
         """Returns a deep copy of the image.
         """
         array = self.pixel_array.copy()
-        return Image(array, self.pixel_format, bottom_up=self.bottom_up)
+        return Image(array, self.pixel_format, bottom_up=self.bottom_up,
+                     mipmap=self._this.mipmap())
+
+    def invalidate(self):
+        """Discards the converted and smaller copies of the image which are
+        kept for drawing. Call this after changing the image's pixels in
+        place. Assigning to ``pixels`` calls it by itself.
+        """
+        self._this.invalidate()
+        self._conversions.clear()
+
+    cdef Image _with_format(self, PixelFormat fmt):
+        """_with_format(format)
+        Returns this image in the pixel format `format`, converting it the
+        first time each format is needed.
+        """
+        if self.pixel_format == fmt:
+            return self
+
+        cdef Image image = self._conversions.get(fmt)
+        if image is None:
+            image = convert_image(self, fmt, bottom_up=self.bottom_up)
+            image._this.mipmap(self._this.mipmap())
+            self._conversions[fmt] = image
+        return image
 
     property format:
         def __get__(self):
@@ -170,6 +209,20 @@ cdef class Image:
                 self.pixel_array.base
             return self.pixel_array
 
+        def __set__(self, value):
+            self.pixel_array[...] = value
+            self.invalidate()
+
+    property mipmap:
+        def __get__(self):
+            return self._this.mipmap()
+
+        def __set__(self, bool enable):
+            cdef Image image
+            self._this.mipmap(enable)
+            for image in self._conversions.values():
+                image._this.mipmap(enable)
+
     property height:
         def __get__(self):
             return self._this.height()
@@ -0,0 +1,96 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "markers.h"
+
+bool marker_is_line(const MarkerType type)
+{
+    return type == k_MarkerCross || type == k_MarkerX || type == k_MarkerDash;
+}
+
+void marker_path(const MarkerType type, const double radius, PathSource& path)
+{
+    // The proportions follow agg::renderer_markers
+    const double r = radius;
+    const double d = r * 0.7;
+
+    switch (type)
+    {
+    case k_MarkerSquare:
+        path.move_to(-r, -r);
+        path.line_to(r, -r);
+        path.line_to(r, r);
+        path.line_to(-r, r);
+        path.close();
+        break;
+    case k_MarkerDiamond:
+        path.move_to(0.0, -r);
+        path.line_to(r, 0.0);
+        path.line_to(0.0, r);
+        path.line_to(-r, 0.0);
+        path.close();
+        break;
+    case k_MarkerCircle:
+        path.ellipse(0.0, 0.0, r, r);
+        break;
+    case k_MarkerTriangleUp:
+        path.move_to(0.0, -r);
+        path.line_to(r * 0.8, r * 0.6);
+        path.line_to(-r * 0.8, r * 0.6);
+        path.close();
+        break;
+    case k_MarkerTriangleDown:
+        path.move_to(0.0, r);
+        path.line_to(-r * 0.8, -r * 0.6);
+        path.line_to(r * 0.8, -r * 0.6);
+        path.close();
+        break;
+    case k_MarkerTriangleLeft:
+        path.move_to(-r, 0.0);
+        path.line_to(r * 0.6, -r * 0.8);
+        path.line_to(r * 0.6, r * 0.8);
+        path.close();
+        break;
+    case k_MarkerTriangleRight:
+        path.move_to(r, 0.0);
+        path.line_to(-r * 0.6, r * 0.8);
+        path.line_to(-r * 0.6, -r * 0.8);
+        path.close();
+        break;
+    case k_MarkerCross:
+        path.move_to(-r, 0.0);
+        path.line_to(r, 0.0);
+        path.move_to(0.0, -r);
+        path.line_to(0.0, r);
+        break;
+    case k_MarkerX:
+        path.move_to(-d, -d);
+        path.line_to(d, d);
+        path.move_to(-d, d);
+        path.line_to(d, -d);
+        break;
+    case k_MarkerDash:
+        path.move_to(-r, 0.0);
+        path.line_to(r, 0.0);
+        break;
+    }
+}
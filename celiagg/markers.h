@@ -0,0 +1,73 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_MARKERS_H
+#define CELIAGG_MARKERS_H
+
+#include <agg_renderer_markers.h>
+
+#include "vertex_source.h"
+
+// Marker shapes for ndarray_canvas::draw_markers(). Up and down are as seen
+// on a canvas, which has its origin at the top.
+enum MarkerType
+{
+    k_MarkerSquare = 0,
+    k_MarkerDiamond,
+    k_MarkerCircle,
+    k_MarkerTriangleUp,
+    k_MarkerTriangleDown,
+    k_MarkerTriangleLeft,
+    k_MarkerTriangleRight,
+    k_MarkerCross,
+    k_MarkerX,
+    k_MarkerDash,
+};
+
+// Draws a marker without anti-aliasing with the agg::renderer_markers method
+// for the same shape. AGG's markers assume that y points up.
+template<typename marker_renderer_t>
+void marker_render_aliased(marker_renderer_t& ren, const MarkerType type,
+                           const int x, const int y, const int r)
+{
+    switch (type)
+    {
+    case k_MarkerSquare: ren.square(x, y, r); break;
+    case k_MarkerDiamond: ren.diamond(x, y, r); break;
+    case k_MarkerCircle: ren.circle(x, y, r); break;
+    case k_MarkerTriangleUp: ren.triangle_down(x, y, r); break;
+    case k_MarkerTriangleDown: ren.triangle_up(x, y, r); break;
+    case k_MarkerTriangleLeft: ren.triangle_left(x, y, r); break;
+    case k_MarkerTriangleRight: ren.triangle_right(x, y, r); break;
+    case k_MarkerCross: ren.cross(x, y, r); break;
+    case k_MarkerX: ren.xing(x, y, r); break;
+    case k_MarkerDash: ren.dash(x, y, r); break;
+    }
+}
+
+// True for markers made of lines, which are stroked instead of filled
+bool marker_is_line(const MarkerType type);
+
+// Adds the outline of a marker of the given radius, centered on the origin
+void marker_path(const MarkerType type, const double radius, PathSource& path);
+
+#endif // CELIAGG_MARKERS_H
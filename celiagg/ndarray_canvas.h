@@ -27,12 +27,20 @@
 #pragma once
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 #include <agg_alpha_mask_u8.h>
 #include <agg_bezier_arc.h>
+#include <agg_bounding_rect.h>
 #include <agg_bspline.h>
 #include <agg_conv_bspline.h>
+#include <agg_conv_clip_polygon.h>
+#include <agg_conv_clip_polyline.h>
 #include <agg_conv_contour.h>
 #include <agg_conv_curve.h>
 #include <agg_conv_dash.h>
@@ -42,18 +50,30 @@
 #include <agg_pixfmt_gray.h>
 #include <agg_pixfmt_rgb.h>
 #include <agg_pixfmt_rgba.h>
+#include <agg_rasterizer_compound_aa.h>
+#include <agg_rasterizer_outline_aa.h>
 #include <agg_rasterizer_scanline_aa.h>
 #include <agg_renderer_base.h>
+#include <agg_renderer_outline_aa.h>
 #include <agg_renderer_scanline.h>
 #include <agg_rendering_buffer.h>
 #include <agg_scanline_p.h>
+#include <agg_scanline_storage_aa.h>
 #include <ctrl/agg_polygon_ctrl.h>
 
+#include "blend.h"
+#include "compound_styles.h"
 #include "font_cache.h"
 #include "glyph_iter.h"
 #include "graphics_state.h"
 #include "image.h"
+#include "markers.h"
 #include "paint.h"
+#include "parallel.h"
+#include "picture.h"
+#include "point_templates.h"
+#include "rasterize.h"
+#include "scanline_band.h"
 #include "vertex_source.h"
 
 // Interface to ndarray_canvas that is generic for all pixfmts, for the
@@ -68,6 +88,7 @@ public:
     virtual const size_t channel_count() const = 0;
     virtual unsigned width() const = 0;
     virtual unsigned height() const = 0;
+    virtual unsigned threads() const = 0;
 
     virtual void clear(const double r, const double g,
                        const double b, const double a) = 0;
@@ -75,6 +96,12 @@ public:
     virtual void draw_image(Image& img,
                             const agg::trans_affine& transform,
                             const GraphicsState& gs) = 0;
+    virtual void draw_scalar_image(Image& img,
+                                   const double* colormap,
+                                   const size_t colormap_size,
+                                   const double vmin, const double vmax,
+                                   const agg::trans_affine& transform,
+                                   const GraphicsState& gs) = 0;
     virtual void draw_shape(VertexSource& shape,
                             const agg::trans_affine& transform,
                             Paint& linePaint, Paint& fillPaint,
@@ -85,10 +112,25 @@ public:
                                       const agg::trans_affine& transform,
                                       Paint& linePaint, Paint& fillPaint,
                                       const GraphicsState& gs) = 0;
+    virtual void draw_markers(const double* points,
+                              const size_t point_count,
+                              const MarkerType type,
+                              const double size,
+                              const agg::trans_affine& transform,
+                              Paint& paint,
+                              const GraphicsState& gs) = 0;
+    virtual void draw_shapes_compound(VertexSource* const* shapes,
+                                      const unsigned* styles,
+                                      const size_t shape_count,
+                                      Paint* const* paints,
+                                      const size_t paint_count,
+                                      const agg::trans_affine& transform,
+                                      const GraphicsState& gs) = 0;
     virtual void draw_text(const char* text, Font& font,
                            const agg::trans_affine& transform,
                            Paint& linePaint, Paint& fillPaint,
                            const GraphicsState& gs) = 0;
+    virtual void draw_picture(const Picture& picture) = 0;
 };
 
 template<typename pixfmt_t>
@@ -98,18 +140,28 @@ public:
     ndarray_canvas(unsigned char* buf,
                    const unsigned width, const unsigned height, const int stride,
                    const size_t channel_count, FontCache& cache,
-                   const bool bottom_up = false);
+                   const bool bottom_up = false,
+                   const unsigned threads = 1);
     virtual ~ndarray_canvas() {}
 
     const size_t channel_count() const;
     unsigned width() const;
     unsigned height() const;
+    unsigned threads() const;
 
     void clear(const double r, const double g, const double b, const double a = 1.0);
 
     void draw_image(Image& img,
                     const agg::trans_affine& transform,
                     const GraphicsState& gs);
+    // Draws an image of float values, colored by a colormap of
+    // `colormap_size` RGBA colors. See span_image_colormap.
+    void draw_scalar_image(Image& img,
+                           const double* colormap,
+                           const size_t colormap_size,
+                           const double vmin, const double vmax,
+                           const agg::trans_affine& transform,
+                           const GraphicsState& gs);
     void draw_shape(VertexSource& shape,
                     const agg::trans_affine& transform,
                     Paint& linePaint, Paint& fillPaint,
@@ -120,19 +172,64 @@ public:
                               const agg::trans_affine& transform,
                               Paint& linePaint, Paint& fillPaint,
                               const GraphicsState& gs);
+    void draw_markers(const double* points,
+                      const size_t point_count,
+                      const MarkerType type,
+                      const double size,
+                      const agg::trans_affine& transform,
+                      Paint& paint,
+                      const GraphicsState& gs);
+    void draw_shapes_compound(VertexSource* const* shapes,
+                              const unsigned* styles,
+                              const size_t shape_count,
+                              Paint* const* paints,
+                              const size_t paint_count,
+                              const agg::trans_affine& transform,
+                              const GraphicsState& gs);
     void draw_text(const char* text, Font& font,
                    const agg::trans_affine& transform,
                    Paint& linePaint, Paint& fillPaint,
                    const GraphicsState& gs);
+    void draw_picture(const Picture& picture);
 
 protected:
 
-    typedef agg::amask_no_clip_gray8 alpha_mask_t;
-    typedef agg::pixfmt_amask_adaptor<pixfmt_t, alpha_mask_t> masked_pxfmt_t;
+    typedef clip_mask alpha_mask_t;
+    typedef pixfmt_clip_mask_adaptor<pixfmt_t> masked_pxfmt_t;
     typedef agg::renderer_base<masked_pxfmt_t> masked_renderer_t;
 
+    // Blend modes other than BlendAlpha draw through a pixel format which
+    // composites with them. It's the canvas' own format if it has no alpha.
+    typedef blend_pixfmt<pixfmt_t> blend_traits_t;
+    typedef typename blend_traits_t::type blend_pxfmt_t;
+    typedef agg::renderer_base<blend_pxfmt_t> blend_renderer_t;
+    typedef pixfmt_clip_mask_adaptor<blend_pxfmt_t> masked_blend_pxfmt_t;
+    typedef agg::renderer_base<masked_blend_pxfmt_t> masked_blend_renderer_t;
+
     typedef agg::renderer_base<pixfmt_t> renderer_t;
     typedef agg::rasterizer_scanline_aa<> rasterizer_t;
+    typedef agg::scanline_storage_aa8 storage_t;
+    typedef ScanlineBand<storage_t> band_t;
+
+    // Shapes spanning fewer rows than this are always drawn by one thread,
+    // and a band is never made smaller than half of this.
+    enum { k_MinParallelRows = 128 };
+
+    // Offsets outside of +/- k_PointOffsetLimit can't be rasterized
+    enum { k_PointOffsetLimit = PointTemplates::k_OffsetLimit };
+
+    // draw_picture() fills at most this many shapes with one rasterizer pass
+    enum { k_PictureMergeLimit = 256 };
+
+    // The part of a shape which can affect the visible pixels. Geometry is
+    // only clipped to these boxes when the shape extends past them.
+    struct ShapeView
+    {
+        bool clip_fill;
+        bool clip_stroke;
+        double fill_box[4];     // x1, y1, x2, y2 in device space
+        double stroke_box[4];   // x1, y1, x2, y2 in user space
+    };
 
     size_t m_channel_count;
     FontCache& m_font_cache;
@@ -142,13 +239,33 @@ protected:
     rasterizer_t m_rasterizer;
     agg::scanline_p8 m_scanline;
     bool m_bottom_up;
+    std::unique_ptr<ThreadPool> m_pool;
 
 private:
 
-    template<typename base_renderer_t, typename span_gen_t>
-    void _draw_image_internal(Image& img,
+    bool _blit_image(Image& img, const agg::trans_affine& transform,
+                     const GraphicsState& gs);
+    template<typename base_renderer_t>
+    void _set_blit_clipping(const GraphicsState::Rect& clip,
+                            base_renderer_t& renderer);
+    template<typename base_renderer_t>
+    void _blit_image_rows(pixfmt_t& src, const int x, const int y,
+                          const int scale_x, const int scale_y,
+                          const agg::cover_type cover,
+                          base_renderer_t& renderer);
+    void _blit_image_copy(Image& img, pixfmt_t& src, const int x, const int y,
+                          const agg::cover_type cover, std::false_type);
+    void _blit_image_copy(Image& img, pixfmt_t& src, const int x, const int y,
+                          const agg::cover_type cover, std::true_type);
+    template<typename span_gen_t>
+    void _draw_image_filtered(Image& img,
                               const agg::trans_affine& transform,
                               const GraphicsState& gs,
+                              span_gen_t& span_generator);
+    template<typename span_gen_t, typename base_renderer_t>
+    void _draw_image_internal(Image& img,
+                              const agg::trans_affine& transform,
+                              span_gen_t& span_generator,
                               base_renderer_t& renderer);
     template<typename base_renderer_t>
     void _draw_shape_internal(VertexSource& shape,
@@ -157,17 +274,60 @@ private:
                               const GraphicsState& gs,
                               base_renderer_t& renderer);
     template<typename base_renderer_t>
-    void _draw_shape_stroke_setup(VertexSource& shape,
-                                  const agg::trans_affine& mtx,
-                                  Paint& paint,
-                                  const GraphicsState& gs,
-                                  base_renderer_t& renderer);
-    template<typename stroke_t, typename base_renderer_t>
-    void _draw_shape_stroke_final(stroke_t& stroke,
-                                  const agg::trans_affine& mtx,
-                                  Paint& paint,
-                                  const GraphicsState& gs,
-                                  base_renderer_t& renderer);
+    void _draw_shape_at_points_cached(VertexSource& shape,
+                                      const double* points,
+                                      const size_t point_count,
+                                      const agg::trans_affine& transform,
+                                      Paint& linePaint, Paint& fillPaint,
+                                      const GraphicsState& gs,
+                                      base_renderer_t& renderer);
+    template<typename base_renderer_t>
+    void _draw_markers_aliased(const double* points,
+                               const size_t point_count,
+                               const MarkerType type,
+                               const double size,
+                               const agg::trans_affine& transform,
+                               Paint& paint,
+                               const GraphicsState& gs,
+                               base_renderer_t& renderer);
+    template<typename base_renderer_t>
+    void _draw_shapes_compound_internal(VertexSource* const* shapes,
+                                        const unsigned* styles,
+                                        const size_t shape_count,
+                                        Paint* const* paints,
+                                        const size_t paint_count,
+                                        const agg::trans_affine& transform,
+                                        const GraphicsState& gs,
+                                        base_renderer_t& renderer);
+    size_t _draw_picture_fills(const Picture& picture,
+                               const size_t first,
+                               const int* first_box);
+    bool _picture_bounds(const Picture::Command& cmd, int* box);
+    static bool _is_solid_fill(const Picture::Command& cmd);
+    bool _shape_view(VertexSource& shape,
+                     const agg::trans_affine& mtx,
+                     Paint& linePaint, Paint& fillPaint,
+                     const GraphicsState& gs,
+                     ShapeView& view);
+    bool _use_hairline(const Paint& paint,
+                       const agg::trans_affine& mtx,
+                       const GraphicsState& gs);
+    template<typename base_renderer_t>
+    void _draw_hairline(VertexSource& shape,
+                        const agg::trans_affine& mtx,
+                        Paint& paint,
+                        const GraphicsState& gs,
+                        base_renderer_t& renderer);
+    template<typename scanline_t, typename base_renderer_t>
+    void _render_paint(Paint& paint,
+                       scanline_t& scanline,
+                       base_renderer_t& renderer,
+                       const agg::trans_affine& mtx);
+    template<typename scanline_t>
+    void _render_paint(Paint& paint,
+                       scanline_t& scanline,
+                       renderer_t& renderer,
+                       const agg::trans_affine& mtx);
     template<typename base_renderer_t>
     void _draw_text_internal(const char* text, Font& font,
                              const agg::trans_affine& transform,
@@ -190,7 +350,9 @@ private:
                            base_renderer_t& renderer);
 
     GraphicsState::DrawingMode _convert_text_mode(const GraphicsState::TextDrawingMode tm);
-    inline void _set_aa(const bool& aa);
+    static bool _uses_bounding_box(const Paint& paint);
+    static bool _uses_blend_mode(const GraphicsState::BlendMode mode);
+    static bool _is_masked(const GraphicsState& gs);
     inline void _set_clipping(const GraphicsState::Rect& rect);
 
 private:
@@ -28,16 +28,60 @@
 // this funky macro...
 #define _WITH_MASKED_RENDERER(gs, name) \
 Image* stencil = const_cast<Image*>(gs.stencil());\
-agg::rendering_buffer& stencilbuf = stencil->get_buffer();\
-alpha_mask_t stencil_mask(stencilbuf);\
+alpha_mask_t stencil_mask(stencil ? &stencil->get_buffer() : NULL,\
+                          gs.stencil_x(), gs.stencil_y(),\
+                          gs.compact_stencil(), gs.clip_path());\
 masked_pxfmt_t masked_pixfmt(m_pixfmt, stencil_mask);\
 masked_renderer_t name(masked_pixfmt);
 
+#define _WITH_BLEND_RENDERER(mode, name) \
+blend_pxfmt_t blend_pixfmt(m_renbuf);\
+blend_traits_t::comp_op(blend_pixfmt, unsigned(mode));\
+blend_renderer_t name(blend_pixfmt);
+
+#define _WITH_MASKED_BLEND_RENDERER(gs, mode, name) \
+Image* stencil = const_cast<Image*>(gs.stencil());\
+alpha_mask_t stencil_mask(stencil ? &stencil->get_buffer() : NULL,\
+                          gs.stencil_x(), gs.stencil_y(),\
+                          gs.compact_stencil(), gs.clip_path());\
+blend_pxfmt_t blend_pixfmt(m_renbuf);\
+blend_traits_t::comp_op(blend_pixfmt, unsigned(mode));\
+masked_blend_pxfmt_t masked_pixfmt(blend_pixfmt, stencil_mask);\
+masked_blend_renderer_t name(masked_pixfmt);
+
+// Runs the statement given after `name` with `name` bound to the renderer for
+// the state's stencil and clip path and the blend mode `mode`.
+#define _WITH_RENDERER(gs, mode, name, ...) \
+if (_uses_blend_mode(mode))\
+{\
+    if (!_is_masked(gs))\
+    {\
+        _WITH_BLEND_RENDERER(mode, name)\
+        __VA_ARGS__;\
+    }\
+    else\
+    {\
+        _WITH_MASKED_BLEND_RENDERER(gs, mode, name)\
+        __VA_ARGS__;\
+    }\
+}\
+else if (!_is_masked(gs))\
+{\
+    renderer_t& name = m_renderer;\
+    __VA_ARGS__;\
+}\
+else\
+{\
+    _WITH_MASKED_RENDERER(gs, name)\
+    __VA_ARGS__;\
+}
+
 
 template<typename pixfmt_t>
 ndarray_canvas<pixfmt_t>::ndarray_canvas(unsigned char* buf,
     const unsigned width, const unsigned height, const int stride,
-    const size_t channel_count, FontCache& cache, const bool bottom_up)
+    const size_t channel_count, FontCache& cache, const bool bottom_up,
+    const unsigned threads)
 : m_channel_count(channel_count)
 , m_font_cache(cache)
 , m_renbuf(buf, width, height, bottom_up ? -stride : stride)
@@ -45,6 +89,10 @@ ndarray_canvas<pixfmt_t>::ndarray_canvas(unsigned char* buf,
 , m_renderer(m_pixfmt)
 , m_bottom_up(bottom_up)
 {
+    if (threads > 1)
+    {
+        m_pool.reset(new ThreadPool(threads));
+    }
 }
 
 template<typename pixfmt_t>
@@ -69,34 +117,112 @@ unsigned ndarray_canvas<pixfmt_t>::height() const
     return m_renbuf.height();
 }
 
+template<typename pixfmt_t>
+unsigned ndarray_canvas<pixfmt_t>::threads() const
+{
+    return m_pool ? m_pool->size() : 1;
+}
+
 template<typename pixfmt_t>
 void ndarray_canvas<pixfmt_t>::clear(const double r, const double g,
     const double b, const double a)
 {
-    typename pixfmt_t::color_type c(agg::rgba(r, g, b, a));
-    m_renderer.clear(c);
+    m_renderer.clear(pixfmt_color<pixfmt_t>(agg::rgba(r, g, b, a)));
 }
 
 template<typename pixfmt_t>
 void ndarray_canvas<pixfmt_t>::draw_image(Image& img,
     const agg::trans_affine& transform, const GraphicsState& gs)
 {
-    typedef typename image_filters<pixfmt_t>::nearest_t span_gen_t;
+    typedef image_filters<pixfmt_t> filters_t;
 
     _set_clipping(gs.clip_box());
-    // XXX: Apply master alpha here somehow!
 
-    if (gs.stencil() == NULL)
+    if (_blit_image(img, transform, gs))
+    {
+        return;
+    }
+
+    // Minified images are sampled from the mip level closest to their drawn
+    // size. The outline still comes from the full size image.
+    const unsigned level = img.mip_level(transform);
+    agg::trans_affine src_mtx = agg::trans_affine_scaling(double(1 << level));
+    src_mtx *= transform;
+
+    pixfmt_t src_pix(img.mip<pixfmt_t>(level).get_buffer());
+    agg::trans_affine inv_img_mtx = src_mtx;
+    inv_img_mtx.invert();
+    interpolator_t interpolator(inv_img_mtx);
+
+    const ImageFilter filter = gs.image_filter();
+    if (filter == k_ImageFilterNearest)
+    {
+        typename pixfmt_t::color_type back_color(agg::rgba(0.5, 0.5, 0.5, 1.0));
+        typename filters_t::source_t source(src_pix, back_color);
+        typename filters_t::nearest_t span_generator(source, interpolator);
+        _draw_image_filtered(img, transform, gs, span_generator);
+        return;
+    }
+
+    // Shrinking needs a filter as wide as the source pixels which land in
+    // each canvas pixel, so that gets the slower resampling span generator.
+    double scale_x, scale_y;
+    src_mtx.scaling_abs(&scale_x, &scale_y);
+    const bool shrinking = scale_x < 1.0 || scale_y < 1.0;
+
+    typename filters_t::source_filter_t source(src_pix);
+    if (filter == k_ImageFilterBilinear && !shrinking)
+    {
+        typename filters_t::bilinear_filter_t span_generator(source, interpolator);
+        _draw_image_filtered(img, transform, gs, span_generator);
+        return;
+    }
+
+    agg::image_filter_lut& lut = cached_image_filter_lut(filter, gs.image_filter_radius());
+    if (shrinking)
     {
-        _draw_image_internal<renderer_t, span_gen_t>(img, transform, gs, m_renderer);
+        typename filters_t::resample_filter_t span_generator(source, interpolator, lut);
+        _draw_image_filtered(img, transform, gs, span_generator);
     }
     else
     {
-        _WITH_MASKED_RENDERER(gs, renderer)
-        _draw_image_internal<masked_renderer_t, span_gen_t>(img, transform, gs, renderer);
+        typename filters_t::general_filter_t span_generator(source, interpolator, lut);
+        _draw_image_filtered(img, transform, gs, span_generator);
     }
 }
 
+template<typename pixfmt_t>
+void ndarray_canvas<pixfmt_t>::draw_scalar_image(Image& img,
+    const double* colormap, const size_t colormap_size,
+    const double vmin, const double vmax,
+    const agg::trans_affine& transform, const GraphicsState& gs)
+{
+    typedef typename pixfmt_t::color_type color_t;
+
+    if (colormap_size == 0) return;
+
+    _set_clipping(gs.clip_box());
+
+    std::vector<color_t> colors(colormap_size);
+    for (size_t i = 0; i < colormap_size; ++i)
+    {
+        const double* c = colormap + i*4;
+        colors[i] = pixfmt_color<pixfmt_t>(agg::rgba(c[0], c[1], c[2], c[3]));
+    }
+
+    // Every filter except nearest samples bilinearly. Values are colored
+    // after they're sampled, so minified images aren't resampled like they
+    // are by draw_image().
+    agg::trans_affine inv_img_mtx = transform;
+    inv_img_mtx.invert();
+    interpolator_t interpolator(inv_img_mtx);
+    image_accessor_scalar source(img.get_buffer());
+    span_image_colormap<color_t> span_generator(source, interpolator,
+        colors.data(), unsigned(colormap_size), vmin, vmax,
+        gs.image_filter() != k_ImageFilterNearest);
+    _draw_image_filtered(img, transform, gs, span_generator);
+}
+
 template<typename pixfmt_t>
 void ndarray_canvas<pixfmt_t>::draw_shape(VertexSource& shape,
     const agg::trans_affine& transform, Paint& linePaint, Paint& fillPaint,
@@ -106,15 +232,8 @@ void ndarray_canvas<pixfmt_t>::draw_shape(VertexSource& shape,
     linePaint.master_alpha(gs.master_alpha());
     fillPaint.master_alpha(gs.master_alpha());
 
-    if (gs.stencil() == NULL)
-    {
-        _draw_shape_internal(shape, transform, linePaint, fillPaint, gs, m_renderer);
-    }
-    else
-    {
-        _WITH_MASKED_RENDERER(gs, renderer)
-        _draw_shape_internal(shape, transform, linePaint, fillPaint, gs, renderer);
-    }
+    _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+        _draw_shape_internal(shape, transform, linePaint, fillPaint, gs, renderer))
 }
 
 template<typename pixfmt_t>
@@ -123,35 +242,89 @@ void ndarray_canvas<pixfmt_t>::draw_shape_at_points(VertexSource& shape,
     const agg::trans_affine& transform, Paint& linePaint, Paint& fillPaint,
     const GraphicsState& gs)
 {
-    agg::simple_polygon_vertex_source _points(points, point_count, false, false);
-    agg::trans_affine pt_trans;
-    unsigned cmd;
+    const GraphicsState::Rect clip = gs.clip_box();
 
-    _set_clipping(gs.clip_box());
     linePaint.master_alpha(gs.master_alpha());
     fillPaint.master_alpha(gs.master_alpha());
 
-    if (gs.stencil() == NULL)
+    // Cached coverage is clipped to whole pixels when it is drawn. A clip box
+    // with fractional edges needs the rasterizer, so rasterize every point.
+    // The same goes for gradients sized by the bounds of the clipped shape.
+    if (!PointTemplates::clip_supported(clip) ||
+        (clip.is_valid() && (_uses_bounding_box(linePaint) || _uses_bounding_box(fillPaint))))
     {
-        for (;;)
-        {
-            cmd = _points.vertex(&pt_trans.tx, &pt_trans.ty);
-            if (cmd == agg::path_cmd_end_poly) break;
+        agg::simple_polygon_vertex_source _points(points, point_count, false, false);
+        agg::trans_affine pt_trans;
+        unsigned cmd;
 
-            _draw_shape_internal(shape, pt_trans * transform, linePaint, fillPaint, gs, m_renderer);
-        }
+        _set_clipping(clip);
+
+        _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+            for (;;)
+            {
+                cmd = _points.vertex(&pt_trans.tx, &pt_trans.ty);
+                if (cmd == agg::path_cmd_end_poly) break;
+
+                _draw_shape_internal(shape, pt_trans * transform, linePaint, fillPaint, gs, renderer);
+            })
+        return;
     }
-    else
+
+    _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+        _draw_shape_at_points_cached(shape, points, point_count, transform, linePaint, fillPaint, gs, renderer))
+}
+
+template<typename pixfmt_t>
+void ndarray_canvas<pixfmt_t>::draw_markers(const double* points,
+    const size_t point_count, const MarkerType type, const double size,
+    const agg::trans_affine& transform, Paint& paint, const GraphicsState& gs)
+{
+    if (point_count == 0 || !(size > 0.0)) return;
+
+    if (!gs.anti_aliased() && paint.type() == Paint::k_PaintTypeSolid)
     {
-        _WITH_MASKED_RENDERER(gs, renderer)
-        for (;;)
-        {
-            cmd = _points.vertex(&pt_trans.tx, &pt_trans.ty);
-            if (cmd == agg::path_cmd_end_poly) break;
+        paint.master_alpha(gs.master_alpha());
+        _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+            _draw_markers_aliased(points, point_count, type, size, transform, paint, gs, renderer))
+        return;
+    }
 
-            _draw_shape_internal(shape, pt_trans * transform, linePaint, fillPaint, gs, renderer);
-        }
+    // Markers keep their size in pixels, so the points are moved to device
+    // space and the marker is stamped there with the cached coverage of
+    // draw_shape_at_points().
+    std::vector<double> device_points(points, points + point_count * 2);
+    for (size_t i = 0; i < point_count; ++i)
+    {
+        transform.transform(&device_points[i*2], &device_points[i*2+1]);
+    }
+
+    PathSource marker;
+    marker_path(type, size / 2.0, marker);
+
+    GraphicsState marker_gs(gs);
+    marker_gs.drawing_mode(marker_is_line(type) ? GraphicsState::DrawStroke : GraphicsState::DrawFill);
+    draw_shape_at_points(marker, device_points.data(), point_count,
+                         agg::trans_affine(), paint, paint, marker_gs);
+}
+
+template<typename pixfmt_t>
+void ndarray_canvas<pixfmt_t>::draw_shapes_compound(VertexSource* const* shapes,
+    const unsigned* styles, const size_t shape_count,
+    Paint* const* paints, const size_t paint_count,
+    const agg::trans_affine& transform, const GraphicsState& gs)
+{
+    if ((gs.drawing_mode() & GraphicsState::DrawFill) != GraphicsState::DrawFill)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < paint_count; ++i)
+    {
+        paints[i]->master_alpha(gs.master_alpha());
     }
+
+    _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+        _draw_shapes_compound_internal(shapes, styles, shape_count, paints, paint_count, transform, gs, renderer))
 }
 
 template<typename pixfmt_t>
@@ -163,39 +336,217 @@ void ndarray_canvas<pixfmt_t>::draw_text(const char* text,
     linePaint.master_alpha(gs.master_alpha());
     fillPaint.master_alpha(gs.master_alpha());
 
-    if (gs.stencil() == NULL)
+    _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+        _draw_text_internal(text, font, transform, linePaint, fillPaint, gs, renderer))
+}
+
+template<typename pixfmt_t>
+void ndarray_canvas<pixfmt_t>::draw_picture(const Picture& picture)
+{
+    const size_t count = picture.size();
+    int box[4];
+
+    for (size_t i = 0; i < count;)
+    {
+        const Picture::Command& cmd = picture.command(i);
+        switch (cmd.type)
+        {
+            case Picture::k_CommandShape:
+                if (!_picture_bounds(cmd, box))
+                {
+                    // draw_image() uses the anti-aliasing of the last shape,
+                    // even when nothing was drawn.
+                    if ((cmd.state->drawing_mode() & GraphicsState::DrawFillStroke) != 0)
+                    {
+                        rasterizer_aa(m_rasterizer, cmd.state->anti_aliased());
+                    }
+                    ++i;
+                }
+                else if (_is_solid_fill(cmd))
+                {
+                    i = _draw_picture_fills(picture, i, box);
+                }
+                else
+                {
+                    draw_shape(*cmd.shape, cmd.transform, *cmd.line_paint, *cmd.fill_paint, *cmd.state);
+                    ++i;
+                }
+                break;
+            case Picture::k_CommandText:
+                draw_text(cmd.text.c_str(), *cmd.font, cmd.transform, *cmd.line_paint, *cmd.fill_paint, *cmd.state);
+                ++i;
+                break;
+            case Picture::k_CommandImage:
+                if (_picture_bounds(cmd, box))
+                {
+                    draw_image(*cmd.image, cmd.transform, *cmd.state);
+                }
+                ++i;
+                break;
+            default:
+                ++i;
+                break;
+        }
+    }
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_blit_image(Image& img,
+    const agg::trans_affine& transform, const GraphicsState& gs)
+{
+    // Only transforms which move image pixels onto whole canvas pixels can be
+    // copied. That's a translation by whole pixels, with or without a whole
+    // number upscale.
+    const double max_offset = double(1 << 30);
+    const double max_scale = double(1 << 16);
+    if (transform.shx != 0.0 || transform.shy != 0.0 ||
+        transform.sx < 1.0 || transform.sx > max_scale ||
+        transform.sy < 1.0 || transform.sy > max_scale ||
+        std::fabs(transform.tx) > max_offset || std::fabs(transform.ty) > max_offset ||
+        std::floor(transform.sx) != transform.sx ||
+        std::floor(transform.sy) != transform.sy ||
+        std::floor(transform.tx) != transform.tx ||
+        std::floor(transform.ty) != transform.ty)
+    {
+        return false;
+    }
+
+    const int scale_x = int(transform.sx);
+    const int scale_y = int(transform.sy);
+    const int x = int(transform.tx);
+    const int y = int(transform.ty);
+
+    // Bilinear filtering samples exactly one pixel when nothing is scaled
+    const ImageFilter filter = gs.image_filter();
+    const bool unscaled = scale_x == 1 && scale_y == 1;
+    if (filter != k_ImageFilterNearest &&
+        !(filter == k_ImageFilterBilinear && unscaled))
+    {
+        return false;
+    }
+
+    // A clip box which cuts through pixels partly covers them
+    const GraphicsState::Rect& clip = gs.clip_box();
+    if (clip.is_valid() &&
+        (std::floor(clip.x1) != clip.x1 || std::floor(clip.y1) != clip.y1 ||
+         std::floor(clip.x2) != clip.x2 || std::floor(clip.y2) != clip.y2))
+    {
+        return false;
+    }
+
+    // The master alpha becomes the cover of every pixel. Formats without
+    // alpha can only be copied when it is opaque.
+    const agg::cover_type cover = agg::cover_type(
+        agg::uround(std::min(std::max(gs.master_alpha(), 0.0), 1.0) * agg::cover_full));
+    pixfmt_t src_pix(img.get_buffer());
+    if (unscaled && !_is_masked(gs) && !_uses_blend_mode(gs.image_blend_mode()) &&
+        (pixfmt_has_alpha<pixfmt_t>::value || cover == agg::cover_full))
     {
-        _draw_text_internal(text, font, transform, linePaint, fillPaint, gs, m_renderer);
+        _set_blit_clipping(clip, m_renderer);
+        _blit_image_copy(img, src_pix, x, y, cover,
+            std::integral_constant<bool, pixfmt_has_alpha<pixfmt_t>::value>());
+        m_renderer.reset_clipping(true);
     }
     else
     {
-        _WITH_MASKED_RENDERER(gs, renderer)
-        _draw_text_internal(text, font, transform, linePaint, fillPaint, gs, renderer);
+        _WITH_RENDERER(gs, gs.image_blend_mode(), renderer,
+            _set_blit_clipping(clip, renderer);
+            _blit_image_rows(src_pix, x, y, scale_x, scale_y, cover, renderer);
+            renderer.reset_clipping(true))
     }
+    return true;
 }
 
 template<typename pixfmt_t>
-template<typename base_renderer_t, typename span_gen_t>
-void ndarray_canvas<pixfmt_t>::_draw_image_internal(Image& img,
+template<typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_set_blit_clipping(const GraphicsState::Rect& clip,
+    base_renderer_t& renderer)
+{
+    if (clip.is_valid())
+    {
+        renderer.clip_box(int(clip.x1), int(clip.y1), int(clip.x2) - 1, int(clip.y2) - 1);
+    }
+}
+
+template<typename pixfmt_t>
+template<typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_blit_image_rows(pixfmt_t& src,
+    const int x, const int y, const int scale_x, const int scale_y,
+    const agg::cover_type cover, base_renderer_t& renderer)
+{
+    typedef typename pixfmt_t::color_type color_type;
+
+    // The visible part of the image, in canvas pixels
+    const int x1 = std::max(x, renderer.xmin());
+    const int y1 = std::max(y, renderer.ymin());
+    const int x2 = int(std::min(x + double(src.width()) * scale_x, renderer.xmax() + 1.0));
+    const int y2 = int(std::min(y + double(src.height()) * scale_y, renderer.ymax() + 1.0));
+    if (x1 >= x2 || y1 >= y2)
+    {
+        return;
+    }
+
+    // Each source row is expanded once and then written to `scale_y` rows
+    const unsigned len = unsigned(x2 - x1);
+    std::vector<color_type> row(len);
+    int src_y = -1;
+    for (int dst_y = y1; dst_y < y2; ++dst_y)
+    {
+        if ((dst_y - y) / scale_y != src_y)
+        {
+            src_y = (dst_y - y) / scale_y;
+            for (unsigned i = 0; i < len; ++i)
+            {
+                row[i] = src.pixel((x1 + int(i) - x) / scale_x, src_y);
+            }
+        }
+        renderer.blend_color_hspan(x1, dst_y, len, &row[0], NULL, cover);
+    }
+}
+
+template<typename pixfmt_t>
+void ndarray_canvas<pixfmt_t>::_blit_image_copy(Image& img, pixfmt_t& src,
+    const int x, const int y, const agg::cover_type cover, std::false_type)
+{
+    // Without alpha, drawing is copying
+    m_renderer.copy_from(img.get_buffer(), NULL, x, y);
+}
+
+template<typename pixfmt_t>
+void ndarray_canvas<pixfmt_t>::_blit_image_copy(Image& img, pixfmt_t& src,
+    const int x, const int y, const agg::cover_type cover, std::true_type)
+{
+    m_renderer.blend_from(src, NULL, x, y, cover);
+}
+
+template<typename pixfmt_t>
+template<typename span_gen_t>
+void ndarray_canvas<pixfmt_t>::_draw_image_filtered(Image& img,
     const agg::trans_affine& transform, const GraphicsState& gs,
+    span_gen_t& span_generator)
+{
+    typedef span_master_alpha<typename pixfmt_t::color_type,
+                              pixfmt_premultiplied<pixfmt_t>::value> alpha_t;
+    typedef agg::span_converter<span_gen_t, alpha_t> alpha_span_gen_t;
+
+    alpha_t alpha(gs.master_alpha());
+    alpha_span_gen_t alpha_span_generator(span_generator, alpha);
+    _WITH_RENDERER(gs, gs.image_blend_mode(), renderer,
+        _draw_image_internal(img, transform, alpha_span_generator, renderer))
+}
+
+template<typename pixfmt_t>
+template<typename span_gen_t, typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_draw_image_internal(Image& img,
+    const agg::trans_affine& transform, span_gen_t& span_generator,
     base_renderer_t& renderer)
 {
-    typedef typename image_filters<pixfmt_t>::source_t source_t;
     typedef typename agg::span_allocator<typename pixfmt_t::color_type> span_alloc_t;
     typedef agg::renderer_scanline_aa<base_renderer_t, span_alloc_t, span_gen_t> img_renderer_t;
     typedef agg::conv_transform<agg::path_storage> trans_curve_t;
 
     agg::path_storage img_outline = img.image_outline();
-    pixfmt_t src_pix(img.get_buffer());
-
     agg::trans_affine src_mtx = transform;
-    agg::trans_affine inv_img_mtx = transform;
-    inv_img_mtx.invert();
-    interpolator_t interpolator(inv_img_mtx);
-
-    typename pixfmt_t::color_type back_color(agg::rgba(0.5, 0.5, 0.5, 1.0));
-    source_t source(src_pix, back_color);
-    span_gen_t span_generator(source, interpolator);
     span_alloc_t span_allocator;
     img_renderer_t img_renderer(renderer, span_allocator, span_generator);
 
@@ -211,95 +562,670 @@ void ndarray_canvas<pixfmt_t>::_draw_shape_internal(VertexSource& shape,
     const agg::trans_affine& transform, Paint& linePaint, Paint& fillPaint,
     const GraphicsState& gs, base_renderer_t& renderer)
 {
-    typedef agg::conv_transform<VertexSource> conv_trans_t;
-    typedef agg::conv_contour<conv_trans_t> contour_shape_t;
     typedef agg::scanline_u8 scanline_t;
 
     const GraphicsState::DrawingMode mode = gs.drawing_mode();
     const bool line = (mode & GraphicsState::DrawStroke) == GraphicsState::DrawStroke;
     const bool fill = (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill;
-    const bool eof = (mode & GraphicsState::DrawEofFill) == GraphicsState::DrawEofFill;
 
     if (line || fill)
     {
-        _set_aa(gs.anti_aliased());
+        rasterizer_aa(m_rasterizer, gs.anti_aliased());
+
+        ShapeView view;
+        if (!_shape_view(shape, transform, linePaint, fillPaint, gs, view))
+        {
+            return;
+        }
+
         scanline_t scanline;
 
         if (fill)
         {
-            agg::trans_affine mtx = transform;
-            conv_trans_t trans_shape(shape, mtx);
-            contour_shape_t contour(trans_shape);
-            contour.auto_detect_orientation(true);
-
-            m_rasterizer.reset();
-            m_rasterizer.add_path(contour);
-            m_rasterizer.filling_rule(eof ? agg::fill_even_odd : agg::fill_non_zero);
-            fillPaint.render<pixfmt_t, rasterizer_t, scanline_t, base_renderer_t>(m_rasterizer, scanline, renderer, mtx);
+            rasterize_fill(m_rasterizer, shape, transform, gs,
+                           view.clip_fill ? view.fill_box : NULL);
+            _render_paint(fillPaint, scanline, renderer, transform);
         }
 
         if (line)
         {
-            // Handle dashing and other such details
-            _draw_shape_stroke_setup(shape, transform, linePaint, gs, renderer);
+            if (_use_hairline(linePaint, transform, gs))
+            {
+                _draw_hairline(shape, transform, linePaint, gs, renderer);
+            }
+            else
+            {
+                // Handle dashing and other such details
+                rasterize_stroke(m_rasterizer, shape, transform, gs,
+                                 view.clip_stroke ? view.stroke_box : NULL);
+                _render_paint(linePaint, scanline, renderer, transform);
+            }
         }
     }
 }
 
 template<typename pixfmt_t>
 template<typename base_renderer_t>
-void ndarray_canvas<pixfmt_t>::_draw_shape_stroke_setup(VertexSource& shape,
+void ndarray_canvas<pixfmt_t>::_draw_shape_at_points_cached(VertexSource& shape,
+    const double* points, const size_t point_count,
+    const agg::trans_affine& transform, Paint& linePaint, Paint& fillPaint,
+    const GraphicsState& gs, base_renderer_t& renderer)
+{
+    typedef agg::scanline_u8 scanline_t;
+    typedef PointTemplates::band_t band_t;
+
+    const GraphicsState::DrawingMode mode = gs.drawing_mode();
+    const bool line = (mode & GraphicsState::DrawStroke) == GraphicsState::DrawStroke;
+    const bool fill = (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill;
+
+    if (!(line || fill) || point_count == 0) return;
+
+    int box[4];
+    const GraphicsState::Rect clip = gs.clip_box();
+    if (!PointTemplates::visible_box(clip, width(), height(), box)) return;
+
+    if (clip.is_valid())
+    {
+        renderer.clip_box(box[0], box[1], box[2], box[3]);
+    }
+
+    scanline_t scanline;
+    PointTemplates::draw(m_rasterizer, points, point_count, transform, box,
+                         gs.anti_aliased(), fill, line,
+        [&](const bool stroke, const agg::trans_affine& mtx)
+        {
+            if (stroke)
+            {
+                rasterize_stroke(m_rasterizer, shape, mtx, gs);
+            }
+            else
+            {
+                rasterize_fill(m_rasterizer, shape, mtx, gs);
+            }
+        },
+        [&](const size_t i, const bool stroke, band_t& band)
+        {
+            // Paints still see the exact transform of the point
+            const agg::trans_affine pt_mtx =
+                agg::trans_affine_translation(points[i*2], points[i*2+1]) * transform;
+            Paint& paint = stroke ? linePaint : fillPaint;
+            paint.render<pixfmt_t, band_t, scanline_t, base_renderer_t>(band, scanline, renderer, pt_mtx);
+        });
+
+    renderer.reset_clipping(true);
+}
+
+template<typename pixfmt_t>
+template<typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_draw_markers_aliased(const double* points,
+    const size_t point_count, const MarkerType type, const double size,
+    const agg::trans_affine& transform, Paint& paint, const GraphicsState& gs,
+    base_renderer_t& renderer)
+{
+    typedef agg::renderer_markers<base_renderer_t> marker_renderer_t;
+
+    const GraphicsState::Rect& clip = gs.clip_box();
+    if (clip.is_valid())
+    {
+        renderer.clip_box(int(std::floor(clip.x1)), int(std::floor(clip.y1)),
+                          int(std::ceil(clip.x2)) - 1, int(std::ceil(clip.y2)) - 1);
+    }
+
+    const typename pixfmt_t::color_type color = paint.solid_color<pixfmt_t>();
+    // AGG's markers are 2 * radius + 1 pixels wide
+    const int radius = std::max(0, agg::iround((size - 1.0) / 2.0));
+
+    marker_renderer_t marker_renderer(renderer);
+    marker_renderer.fill_color(color);
+    marker_renderer.line_color(color);
+    for (size_t i = 0; i < point_count; ++i)
+    {
+        double x = points[i*2], y = points[i*2+1];
+        transform.transform(&x, &y);
+        if (!(std::fabs(x) < k_PointOffsetLimit && std::fabs(y) < k_PointOffsetLimit)) continue;
+
+        marker_render_aliased(marker_renderer, type, int(std::floor(x)), int(std::floor(y)), radius);
+    }
+
+    renderer.reset_clipping(true);
+}
+
+template<typename pixfmt_t>
+template<typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_draw_shapes_compound_internal(VertexSource* const* shapes,
+    const unsigned* styles, const size_t shape_count,
+    Paint* const* paints, const size_t paint_count,
+    const agg::trans_affine& transform, const GraphicsState& gs,
+    base_renderer_t& renderer)
+{
+    typedef agg::rasterizer_compound_aa<> compound_rasterizer_t;
+    typedef agg::conv_transform<VertexSource> conv_trans_t;
+    typedef agg::scanline_u8 scanline_t;
+    typedef CompoundRenderer<base_renderer_t, pixfmt_t> compound_renderer_t;
+    typedef typename compound_renderer_t::color_type color_t;
+
+    const bool eof = (gs.drawing_mode() & GraphicsState::DrawEofFill) == GraphicsState::DrawEofFill;
+    const GraphicsState::Rect& clip = gs.clip_box();
+
+    compound_rasterizer_t ras;
+    ras.filling_rule(eof ? agg::fill_even_odd : agg::fill_non_zero);
+    // The highest style takes the coverage of a pixel first
+    ras.layer_order(agg::layer_direct);
+    if (clip.is_valid())
+    {
+        ras.clip_box(clip.x1, clip.y1, clip.x2, clip.y2);
+    }
+
+    // Bounds of all the shapes drawn with each paint, as x1, y1, x2, y2
+    std::vector<double> bounds(paint_count * 4);
+    for (size_t i = 0; i < paint_count; ++i)
+    {
+        bounds[4*i] = bounds[4*i+1] = 1e100;
+        bounds[4*i+2] = bounds[4*i+3] = -1e100;
+    }
+
+    std::vector<double> coords;
+    std::vector<unsigned> cmds;
+    for (size_t i = 0; i < shape_count; ++i)
+    {
+        agg::trans_affine mtx = transform;
+        conv_trans_t trans_shape(*shapes[i], mtx);
+        double* box = &bounds[4 * styles[i]];
+        double x = 0.0, y = 0.0, start_x = 0.0, start_y = 0.0, prev_x = 0.0, prev_y = 0.0;
+        double area = 0.0;
+        unsigned cmd;
+
+        // The rasterizer needs to know which side of each edge the shape is
+        // on, so the signed area is found before the vertices are added.
+        coords.clear();
+        cmds.clear();
+        trans_shape.rewind(0);
+        while (!agg::is_stop(cmd = trans_shape.vertex(&x, &y)))
+        {
+            if (agg::is_move_to(cmd))
+            {
+                area += prev_x * start_y - start_x * prev_y;
+                start_x = prev_x = x;
+                start_y = prev_y = y;
+            }
+            else if (agg::is_vertex(cmd))
+            {
+                area += prev_x * y - x * prev_y;
+                prev_x = x;
+                prev_y = y;
+            }
+
+            if (agg::is_vertex(cmd))
+            {
+                box[0] = std::min(box[0], x);
+                box[1] = std::min(box[1], y);
+                box[2] = std::max(box[2], x);
+                box[3] = std::max(box[3], y);
+            }
+            coords.push_back(x);
+            coords.push_back(y);
+            cmds.push_back(cmd);
+        }
+        area += prev_x * start_y - start_x * prev_y;
+
+        if (area < 0.0)
+        {
+            ras.styles(styles[i], -1);
+        }
+        else
+        {
+            ras.styles(-1, styles[i]);
+        }
+
+        // Unlike the scanline rasterizer, the compound rasterizer doesn't
+        // close polygons by itself.
+        bool open = false;
+        for (size_t j = 0; j < cmds.size(); ++j)
+        {
+            if (agg::is_move_to(cmds[j]) && open)
+            {
+                ras.add_vertex(0.0, 0.0, agg::path_cmd_end_poly | agg::path_flags_close);
+            }
+            ras.add_vertex(coords[2*j], coords[2*j+1], cmds[j]);
+            open = agg::is_vertex(cmds[j]);
+        }
+        if (open)
+        {
+            ras.add_vertex(0.0, 0.0, agg::path_cmd_end_poly | agg::path_flags_close);
+        }
+    }
+
+    for (size_t i = 0; i < paint_count; ++i)
+    {
+        // x, y, width, height
+        bounds[4*i+2] -= bounds[4*i];
+        bounds[4*i+3] -= bounds[4*i+1];
+    }
+
+    CompoundStyles<pixfmt_t> style_handler(paints, paint_count, transform, bounds.data());
+    compound_renderer_t compound_renderer(renderer);
+    agg::span_allocator<color_t> allocator;
+    scanline_t scanline;
+    render_compound_layered(ras, scanline, compound_renderer, allocator, style_handler);
+}
+
+template<typename pixfmt_t>
+size_t ndarray_canvas<pixfmt_t>::_draw_picture_fills(const Picture& picture,
+    const size_t first, const int* first_box)
+{
+    typedef agg::scanline_u8 scanline_t;
+
+    const Picture::Command& head = picture.command(first);
+    const GraphicsState& gs = *head.state;
+    const bool eof = (gs.drawing_mode() & GraphicsState::DrawEofFill) == GraphicsState::DrawEofFill;
+    Paint& paint = *head.fill_paint;
+    std::vector<int> boxes(first_box, first_box + 4);
+
+    _set_clipping(gs.clip_box());
+    rasterizer_aa(m_rasterizer, gs.anti_aliased());
+    paint.master_alpha(gs.master_alpha());
+
+    m_rasterizer.reset();
+    add_fill_path(m_rasterizer, *head.shape, head.transform);
+
+    // Shapes whose cells can't overlap produce the same coverage whether they
+    // are rasterized together or one at a time. When they also share a color
+    // and a state, all of them can be blended with a single pass.
+    size_t next = first + 1;
+    for (; next < picture.size() && boxes.size() < 4 * k_PictureMergeLimit; ++next)
+    {
+        const Picture::Command& cmd = picture.command(next);
+        if (cmd.type != Picture::k_CommandShape || cmd.state != head.state ||
+            !_is_solid_fill(cmd) || cmd.fill_paint->r() != paint.r() ||
+            cmd.fill_paint->g() != paint.g() || cmd.fill_paint->b() != paint.b() ||
+            cmd.fill_paint->a() != paint.a())
+        {
+            break;
+        }
+
+        // Shapes which won't be drawn don't end the run
+        int box[4];
+        if (!_picture_bounds(cmd, box)) continue;
+
+        bool overlaps = false;
+        for (size_t i = 0; i < boxes.size() && !overlaps; i += 4)
+        {
+            overlaps = box[0] <= boxes[i+2] && box[2] >= boxes[i] &&
+                       box[1] <= boxes[i+3] && box[3] >= boxes[i+1];
+        }
+        if (overlaps) break;
+
+        boxes.insert(boxes.end(), box, box + 4);
+        add_fill_path(m_rasterizer, *cmd.shape, cmd.transform);
+    }
+
+    m_rasterizer.filling_rule(eof ? agg::fill_even_odd : agg::fill_non_zero);
+
+    scanline_t scanline;
+    _WITH_RENDERER(gs, gs.blend_mode(), renderer,
+        _render_paint(paint, scanline, renderer, head.transform))
+
+    return next;
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_picture_bounds(const Picture::Command& cmd, int* box)
+{
+    const GraphicsState& gs = *cmd.state;
+    const double limit = double(k_PointOffsetLimit);
+    double x1, y1, x2, y2;
+    double pad = 0.0;
+
+    if (cmd.type == Picture::k_CommandImage)
+    {
+        agg::path_storage outline = cmd.image->image_outline();
+        if (!agg::bounding_rect_single(outline, 0, &x1, &y1, &x2, &y2)) return false;
+    }
+    else
+    {
+        const GraphicsState::DrawingMode mode = gs.drawing_mode();
+        const bool line = (mode & GraphicsState::DrawStroke) == GraphicsState::DrawStroke;
+        const bool fill = (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill;
+
+        if (!(line || fill)) return false;
+        if (!agg::bounding_rect_single(*cmd.shape, 0, &x1, &y1, &x2, &y2)) return false;
+
+        // Miters reach out to miter_limit half widths from a vertex and
+        // square caps reach sqrt(2) half widths.
+        if (line)
+        {
+            const double reach = std::max(std::max(gs.miter_limit(), gs.inner_miter_limit()), std::sqrt(2.0));
+            pad = 0.5 * gs.line_width() * reach;
+        }
+    }
+
+    // Fills are widened by half a pixel, and every edge may touch the cell
+    // next to it.
+    double xs[4] = { x1 - pad, x2 + pad, x2 + pad, x1 - pad };
+    double ys[4] = { y1 - pad, y1 - pad, y2 + pad, y2 + pad };
+    double min_x = limit, min_y = limit, max_x = -limit, max_y = -limit;
+    for (int i = 0; i < 4; ++i)
+    {
+        cmd.transform.transform(&xs[i], &ys[i]);
+        min_x = std::min(min_x, xs[i]); max_x = std::max(max_x, xs[i]);
+        min_y = std::min(min_y, ys[i]); max_y = std::max(max_y, ys[i]);
+    }
+    box[0] = int(std::floor(std::max(min_x, -limit))) - 1;
+    box[1] = int(std::floor(std::max(min_y, -limit))) - 1;
+    box[2] = int(std::floor(std::min(max_x, limit))) + 1;
+    box[3] = int(std::floor(std::min(max_y, limit))) + 1;
+
+    int vis_x1 = 0, vis_y1 = 0;
+    int vis_x2 = int(width()) - 1, vis_y2 = int(height()) - 1;
+    const GraphicsState::Rect clip = gs.clip_box();
+    if (clip.is_valid())
+    {
+        vis_x1 = std::max(vis_x1, int(std::floor(std::max(clip.x1, -limit))));
+        vis_y1 = std::max(vis_y1, int(std::floor(std::max(clip.y1, -limit))));
+        vis_x2 = std::min(vis_x2, int(std::ceil(std::min(clip.x2, limit))));
+        vis_y2 = std::min(vis_y2, int(std::ceil(std::min(clip.y2, limit))));
+    }
+
+    return box[0] <= vis_x2 && box[2] >= vis_x1 &&
+           box[1] <= vis_y2 && box[3] >= vis_y1;
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_is_solid_fill(const Picture::Command& cmd)
+{
+    const GraphicsState::DrawingMode mode = cmd.state->drawing_mode();
+    return (mode & GraphicsState::DrawStroke) == 0 &&
+           (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill &&
+           cmd.fill_paint->type() == Paint::k_PaintTypeSolid;
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_shape_view(VertexSource& shape,
+    const agg::trans_affine& mtx, Paint& linePaint, Paint& fillPaint,
+    const GraphicsState& gs, ShapeView& view)
+{
+    const GraphicsState::DrawingMode mode = gs.drawing_mode();
+    const bool line = (mode & GraphicsState::DrawStroke) == GraphicsState::DrawStroke;
+    const bool fill = (mode & GraphicsState::DrawFill) == GraphicsState::DrawFill;
+
+    view.clip_fill = false;
+    view.clip_stroke = false;
+
+    // The visible area is the canvas and the clip box, if there is one
+    double vx1 = 0.0, vy1 = 0.0;
+    double vx2 = m_renbuf.width(), vy2 = m_renbuf.height();
+    const GraphicsState::Rect& clip = gs.clip_box();
+    if (clip.is_valid())
+    {
+        vx1 = std::max(vx1, clip.x1);
+        vy1 = std::max(vy1, clip.y1);
+        vx2 = std::min(vx2, clip.x2);
+        vy2 = std::min(vy2, clip.y2);
+    }
+    if (vx1 >= vx2 || vy1 >= vy2)
+    {
+        return false;
+    }
+
+    // Gradients sized by the shape's bounds see the rasterized bounds, which
+    // only match those of the clipped geometry when the clip box is inside
+    // of the canvas.
+    const bool exact_bounds = clip.is_valid() &&
+                              vx1 == clip.x1 && vy1 == clip.y1 &&
+                              vx2 == clip.x2 && vy2 == clip.y2;
+
+    // Fills are clipped in device space, far enough outside of the visible
+    // area that the anti-aliasing of the new edges can't reach it.
+    view.fill_box[0] = vx1 - 4.0;
+    view.fill_box[1] = vy1 - 4.0;
+    view.fill_box[2] = vx2 + 4.0;
+    view.fill_box[3] = vy2 + 4.0;
+
+    // Strokes are clipped in user space before stroking. The margin is the
+    // furthest that a cap or join can reach from the vertex that made it.
+    const double pad = 0.5 * std::fabs(gs.line_width()) *
+                       std::max(std::max(gs.miter_limit(), gs.inner_miter_limit()), M_SQRT2);
+    bool stroke_clippable = line && std::fabs(mtx.determinant()) > agg::affine_epsilon;
+    if (stroke_clippable)
+    {
+        agg::trans_affine inv = mtx;
+        inv.invert();
+
+        const double xs[4] = {vx1 - 1.0, vx2 + 1.0, vx2 + 1.0, vx1 - 1.0};
+        const double ys[4] = {vy1 - 1.0, vy1 - 1.0, vy2 + 1.0, vy2 + 1.0};
+        view.stroke_box[0] = view.stroke_box[1] = std::numeric_limits<double>::max();
+        view.stroke_box[2] = view.stroke_box[3] = -std::numeric_limits<double>::max();
+        for (int i = 0; i < 4; ++i)
+        {
+            double x = xs[i], y = ys[i];
+            inv.transform(&x, &y);
+            view.stroke_box[0] = std::min(view.stroke_box[0], x);
+            view.stroke_box[1] = std::min(view.stroke_box[1], y);
+            view.stroke_box[2] = std::max(view.stroke_box[2], x);
+            view.stroke_box[3] = std::max(view.stroke_box[3], y);
+        }
+        view.stroke_box[0] -= pad;
+        view.stroke_box[1] -= pad;
+        view.stroke_box[2] += pad;
+        view.stroke_box[3] += pad;
+    }
+
+    // Measure the shape in user and device space. Clipping a closed path
+    // turns it into an open one, so note any which would lose the join at
+    // their start.
+    double ux1 = std::numeric_limits<double>::max(), uy1 = ux1;
+    double ux2 = -ux1, uy2 = -ux1;
+    double dx1 = ux1, dy1 = ux1, dx2 = -ux1, dy2 = -ux1;
+    bool start_visible = false;
+    bool closed_start_visible = false;
+    double x, y;
+    unsigned cmd;
+
+    shape.rewind(0);
+    while (!agg::is_stop(cmd = shape.vertex(&x, &y)))
+    {
+        if (agg::is_vertex(cmd))
+        {
+            ux1 = std::min(ux1, x); uy1 = std::min(uy1, y);
+            ux2 = std::max(ux2, x); uy2 = std::max(uy2, y);
+            if (stroke_clippable && agg::is_move_to(cmd))
+            {
+                start_visible = x >= view.stroke_box[0] && x <= view.stroke_box[2] &&
+                                y >= view.stroke_box[1] && y <= view.stroke_box[3];
+            }
+
+            mtx.transform(&x, &y);
+            dx1 = std::min(dx1, x); dy1 = std::min(dy1, y);
+            dx2 = std::max(dx2, x); dy2 = std::max(dy2, y);
+        }
+        else if (agg::is_closed(cmd) && start_visible)
+        {
+            closed_start_visible = true;
+        }
+    }
+
+    if (ux1 > ux2)
+    {
+        // No vertices
+        return false;
+    }
+
+    bool visible = false;
+    if (fill)
+    {
+        visible = dx1 - 1.0 < vx2 && dx2 + 1.0 > vx1 &&
+                  dy1 - 1.0 < vy2 && dy2 + 1.0 > vy1;
+        view.clip_fill = (dx1 < view.fill_box[0] || dy1 < view.fill_box[1] ||
+                          dx2 > view.fill_box[2] || dy2 > view.fill_box[3]) &&
+                         (exact_bounds || !_uses_bounding_box(fillPaint));
+    }
+    if (line && !visible)
+    {
+        const double xs[4] = {ux1 - pad, ux2 + pad, ux2 + pad, ux1 - pad};
+        const double ys[4] = {uy1 - pad, uy1 - pad, uy2 + pad, uy2 + pad};
+        double sx1 = std::numeric_limits<double>::max(), sy1 = sx1;
+        double sx2 = -sx1, sy2 = -sx1;
+        for (int i = 0; i < 4; ++i)
+        {
+            x = xs[i]; y = ys[i];
+            mtx.transform(&x, &y);
+            sx1 = std::min(sx1, x); sy1 = std::min(sy1, y);
+            sx2 = std::max(sx2, x); sy2 = std::max(sy2, y);
+        }
+        visible = sx1 - 1.0 < vx2 && sx2 + 1.0 > vx1 &&
+                  sy1 - 1.0 < vy2 && sy2 + 1.0 > vy1;
+    }
+    if (stroke_clippable)
+    {
+        const bool dashed = gs.line_dash_pattern().size() > 0;
+        view.clip_stroke = (ux1 < view.stroke_box[0] || uy1 < view.stroke_box[1] ||
+                            ux2 > view.stroke_box[2] || uy2 > view.stroke_box[3]) &&
+                           (dashed || !closed_start_visible) &&
+                           (exact_bounds || !_uses_bounding_box(linePaint));
+    }
+
+    return visible;
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_use_hairline(const Paint& paint,
+    const agg::trans_affine& mtx, const GraphicsState& gs)
+{
+    // The outline renderer only draws anti-aliased lines of a solid color
+    const double width = gs.line_width() * mtx.scale();
+    return gs.fast_hairlines() && gs.anti_aliased() &&
+           paint.type() == Paint::k_PaintTypeSolid &&
+           width > 0.0 && width <= 1.0;
+}
+
+template<typename pixfmt_t>
+template<typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_draw_hairline(VertexSource& shape,
     const agg::trans_affine& mtx, Paint& paint, const GraphicsState& gs,
     base_renderer_t& renderer)
 {
+    typedef agg::renderer_outline_aa<base_renderer_t> outline_renderer_t;
+    typedef agg::rasterizer_outline_aa<outline_renderer_t> outline_rasterizer_t;
     typedef agg::conv_dash<VertexSource> dash_t;
-    typedef agg::conv_stroke<dash_t> dash_stroke_t;
-    typedef agg::conv_stroke<VertexSource> stroke_t;
+    typedef agg::conv_transform<VertexSource> trans_shape_t;
+    typedef agg::conv_transform<dash_t> trans_dash_t;
+
+    agg::line_profile_aa profile;
+    profile.width(gs.line_width() * mtx.scale());
+
+    outline_renderer_t outline_renderer(renderer, profile);
+    outline_renderer.color(paint.solid_color<pixfmt_t>());
+
+    // Lines are cut at the clip box, and the pixels that their ends spill
+    // onto outside of it are clipped by the base renderer.
+    double x1 = 0.0, y1 = 0.0;
+    double x2 = m_renbuf.width(), y2 = m_renbuf.height();
+    const GraphicsState::Rect& clip = gs.clip_box();
+    if (clip.is_valid())
+    {
+        x1 = std::max(x1, clip.x1);
+        y1 = std::max(y1, clip.y1);
+        x2 = std::min(x2, clip.x2);
+        y2 = std::min(y2, clip.y2);
+        if (x1 >= x2 || y1 >= y2)
+        {
+            return;
+        }
+        renderer.clip_box(int(std::floor(x1)), int(std::floor(y1)),
+                          int(std::ceil(x2)) - 1, int(std::ceil(y2)) - 1);
+    }
+    outline_renderer.clip_box(x1, y1, x2, y2);
+
+    outline_rasterizer_t outline_rasterizer(outline_renderer);
+    outline_rasterizer.round_cap(gs.line_cap() == GraphicsState::CapRound);
+    switch (gs.line_join())
+    {
+    // The outline rasterizer has no bevel join. At these widths a round join
+    // covers nearly the same pixels, while miters spike out at sharp corners.
+    case GraphicsState::JoinRound:
+    case GraphicsState::JoinBevel:
+        outline_rasterizer.line_join(agg::outline_round_join);
+        break;
+    case GraphicsState::JoinMiter:
+    default:
+        outline_rasterizer.line_join(agg::outline_miter_accurate_join);
+        break;
+    }
 
+    agg::trans_affine src_mtx = mtx;
     if (gs.line_dash_pattern().size() > 0)
     {
         typedef GraphicsState::DashPattern::size_type counter_t;
 
         dash_t dash(shape);
-        dash_stroke_t stroke(dash);
         const GraphicsState::DashPattern& dashPattern = gs.line_dash_pattern();
 
         for (counter_t i=0; i < dashPattern.size(); i+=2)
             dash.add_dash(dashPattern[i], dashPattern[i+1]);
         dash.dash_start(0.0);
 
-        _draw_shape_stroke_final(stroke, mtx, paint, gs, renderer);
+        trans_dash_t trans(dash, src_mtx);
+        outline_rasterizer.add_path(trans);
     }
     else
     {
-        stroke_t stroke(shape);
-        _draw_shape_stroke_final(stroke, mtx, paint, gs, renderer);
+        DecimatedSource decimated(shape, mtx);
+        VertexSource& source = gs.decimate_lines() ? decimated : shape;
+        trans_shape_t trans(source, src_mtx);
+        outline_rasterizer.add_path(trans);
     }
+
+    renderer.reset_clipping(true);
 }
 
 template<typename pixfmt_t>
-template<typename stroke_t, typename base_renderer_t>
-void ndarray_canvas<pixfmt_t>::_draw_shape_stroke_final(stroke_t& stroke,
-    const agg::trans_affine& mtx, Paint& paint, const GraphicsState& gs,
-    base_renderer_t& renderer)
+template<typename scanline_t, typename base_renderer_t>
+void ndarray_canvas<pixfmt_t>::_render_paint(Paint& paint,
+    scanline_t& scanline, base_renderer_t& renderer,
+    const agg::trans_affine& mtx)
 {
-    typedef agg::conv_transform<stroke_t> trans_stroke_t;
-    typedef agg::scanline_u8 scanline_t;
-    scanline_t scanline;
+    // Masked renderers keep scratch buffers and can't be shared by threads
+    paint.render<pixfmt_t, rasterizer_t, scanline_t, base_renderer_t>(m_rasterizer, scanline, renderer, mtx);
+}
 
-    stroke.width(gs.line_width());
-    stroke.miter_limit(gs.miter_limit());
-    stroke.inner_miter_limit(gs.inner_miter_limit());
-    stroke.line_cap(agg::line_cap_e(gs.line_cap()));
-    stroke.line_join(agg::line_join_e(gs.line_join()));
-    stroke.inner_join(agg::inner_join_e(gs.inner_join()));
+template<typename pixfmt_t>
+template<typename scanline_t>
+void ndarray_canvas<pixfmt_t>::_render_paint(Paint& paint,
+    scanline_t& scanline, renderer_t& renderer,
+    const agg::trans_affine& mtx)
+{
+    // rewind_scanlines() sorts the cells, which gives the final bounds
+    if (!m_pool || !m_rasterizer.rewind_scanlines() ||
+        m_rasterizer.max_y() - m_rasterizer.min_y() < int(k_MinParallelRows))
+    {
+        paint.render<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(m_rasterizer, scanline, renderer, mtx);
+        return;
+    }
 
-    agg::trans_affine src_mtx = mtx;
-    trans_stroke_t trans(stroke, src_mtx);
+    // Computing coverage is sequential. Store it, then generate and blend
+    // the spans for horizontal bands of the stored scanlines in parallel.
+    // The spans handed to the paint are exactly those the rasterizer would
+    // produce, so the result is identical to drawing with a single thread.
+    storage_t storage;
+    agg::render_scanlines(m_rasterizer, m_scanline, storage);
 
-    m_rasterizer.reset();
-    m_rasterizer.add_path(trans);
-    paint.render<pixfmt_t, rasterizer_t, scanline_t, base_renderer_t>(m_rasterizer, scanline, renderer, mtx);
+    const unsigned row_count = scanline_storage_rows(storage);
+
+    const unsigned max_bands = row_count / (k_MinParallelRows / 2);
+    const unsigned band_count = std::max(1u, std::min(m_pool->size() * 4, max_bands));
+    const unsigned band_rows = (row_count + band_count - 1) / band_count;
+    const int min_x = m_rasterizer.min_x(), min_y = m_rasterizer.min_y();
+    const int max_x = m_rasterizer.max_x(), max_y = m_rasterizer.max_y();
+
+    m_pool->run(band_count, [&](unsigned index) {
+        const unsigned first = index * band_rows;
+        const unsigned last = std::min(row_count, first + band_rows);
+        band_t band(storage, first, last, min_x, min_y, max_x, max_y);
+        scanline_t band_scanline;
+        renderer_t band_renderer(renderer);
+
+        paint.render<pixfmt_t, band_t, scanline_t, renderer_t>(band, band_scanline, band_renderer, mtx);
+    });
 }
 
 template<typename pixfmt_t>
@@ -308,26 +1234,27 @@ void ndarray_canvas<pixfmt_t>::_draw_text_internal(const char* text, Font& font,
     const agg::trans_affine& transform, Paint& linePaint, Paint& fillPaint,
     const GraphicsState& gs, base_renderer_t& renderer)
 {
-    // Flip the font?
-    const bool font_flip = font.flip();
-    font.flip(!m_bottom_up);
+    // Flip the font? Work on a copy so that the caller's font is never
+    // modified, even temporarily. Fonts may be shared between threads.
+    Font flipped_font(font);
+    flipped_font.flip(!m_bottom_up);
+
+    // The font engine is shared by every canvas using this cache
+    std::lock_guard<std::mutex> lock(m_font_cache.mutex());
 
     GlyphIterator iterator(text, m_font_cache, true);
     if (gs.text_drawing_mode() == GraphicsState::TextDrawRaster)
     {
         // Raster text only uses the fill paint!
-        _draw_text_raster(iterator, font, transform, fillPaint, gs, renderer);
+        _draw_text_raster(iterator, flipped_font, transform, fillPaint, gs, renderer);
     }
     else
     {
         // Pick the correct drawing mode for the glyph paths
         GraphicsState copy_state(gs);
         copy_state.drawing_mode(_convert_text_mode(gs.text_drawing_mode()));
-        _draw_text_vector(iterator, font, transform, linePaint, fillPaint, copy_state, renderer);
+        _draw_text_vector(iterator, flipped_font, transform, linePaint, fillPaint, copy_state, renderer);
     }
-
-    // Restore the font's flip state to whatever it was
-    font.flip(font_flip);
 }
 
 template<typename pixfmt_t>
@@ -425,16 +1352,24 @@ GraphicsState::DrawingMode ndarray_canvas<pixfmt_t>::_convert_text_mode(const Gr
 }
 
 template<typename pixfmt_t>
-void ndarray_canvas<pixfmt_t>::_set_aa(const bool& aa)
+bool ndarray_canvas<pixfmt_t>::_uses_bounding_box(const Paint& paint)
 {
-    if(aa)
-    {
-        m_rasterizer.gamma(agg::gamma_linear());
-    }
-    else
-    {
-        m_rasterizer.gamma(agg::gamma_threshold(0.5));
-    }
+    return (paint.type() == Paint::k_PaintTypeLinearGradient ||
+            paint.type() == Paint::k_PaintTypeRadialGradient) &&
+           paint.units() == Paint::k_GradientUnitsObjectBoundingBox;
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_uses_blend_mode(const GraphicsState::BlendMode mode)
+{
+    return blend_traits_t::supported && mode != GraphicsState::BlendAlpha;
+}
+
+template<typename pixfmt_t>
+bool ndarray_canvas<pixfmt_t>::_is_masked(const GraphicsState& gs)
+{
+    return gs.stencil() != NULL || gs.compact_stencil() != NULL ||
+           gs.clip_path() != NULL;
 }
 
 template<typename pixfmt_t>
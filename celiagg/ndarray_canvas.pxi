@@ -26,15 +26,35 @@
 cimport numpy
 
 ctypedef unsigned char _bytes_t
+ctypedef unsigned short _words_t
 
 ctypedef _ndarray_canvas.ndarray_canvas_base canvas_base_t
 ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgba128] canvas_rgba128_t
 ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_bgra32] canvas_brga32_t
 ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgba32] canvas_rgba32_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgba128_pre] canvas_rgba128_pre_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgba64] canvas_rgba64_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgb48] canvas_rgb48_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_gray16] canvas_gray16_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_gray32] canvas_gray32_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_bgra32_pre] canvas_bgra32_pre_t
+ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgba32_pre] canvas_rgba32_pre_t
 ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_rgb24] canvas_rgb24_t
 ctypedef _ndarray_canvas.ndarray_canvas[_ndarray_canvas.pixfmt_gray8] canvas_ga16_t
 
 
+cdef _get_colormap(colormap):
+    colors = numpy.asarray(colormap)
+    if colors.ndim != 2 or colors.shape[1] not in (3, 4) or colors.shape[0] == 0:
+        raise ValueError('colormap must be an Nx3 or Nx4 array of colors.')
+    if colors.dtype == numpy.uint8:
+        colors = colors / 255.0
+    colors = numpy.asarray(colors, dtype=numpy.float64)
+    if colors.shape[1] == 3:
+        colors = numpy.hstack([colors, numpy.ones((colors.shape[0], 1))])
+    return numpy.ascontiguousarray(colors)
+
+
 @cython.internal
 cdef class CanvasBase:
     cdef canvas_base_t* _this
@@ -43,9 +63,12 @@ cdef class CanvasBase:
     cdef object font_cache
     cdef bool bottom_up
 
-    cdef int base_init(self, image, int channel_count, bool has_alpha) except -1:
+    cdef int base_init(self, image, int threads, int channel_count,
+                       bool has_alpha) except -1:
         if image is None:
             raise ValueError('image argument must not be None.')
+        if threads < 1:
+            raise ValueError('threads argument must be at least 1.')
 
         cdef numpy.npy_int32[:] image_shape = numpy.asarray(image.shape,
                                                             dtype=numpy.int32,
@@ -90,6 +113,10 @@ cdef class CanvasBase:
         def __get__(self):
             return self._this.height()
 
+    property threads:
+        def __get__(self):
+            return self._this.threads()
+
     property array:
         def __get__(self):
             # User is not likely to be concerned with the details of the cython
@@ -116,7 +143,8 @@ cdef class CanvasBase:
         :param b: Blue value in [0, 1]
         :param a: Alpha value in [0, 1] (defaults to 1.0)
         """
-        self._this.clear(r, g, b, a)
+        with nogil:
+            self._this.clear(r, g, b, a)
 
     def draw_image(self, image, fmt, transform, state, bottom_up=False):
         """draw_image(image, format, transform, state, bottom_up=False)
@@ -143,17 +171,87 @@ cdef class CanvasBase:
         cdef Image img
         cdef Image input_img
 
-        self._check_stencil(gs)
-
         if isinstance(image, Image):
             input_img = image
         else:
             input_img = Image(image, pix_fmt, bottom_up=bottom_up)
 
         img = self._get_native_image(input_img, self.pixel_format)
-        self._this.draw_image(dereference(img._this),
-                              dereference(trans._this),
-                              dereference(gs._this))
+        with nogil:
+            self._this.draw_image(dereference(img._this),
+                                  dereference(trans._this),
+                                  dereference(gs._this))
+
+    def draw_scalar_image(self, array, colormap, vmin, vmax, transform,
+                          state, bottom_up=False):
+        """draw_scalar_image(array, colormap, vmin, vmax, transform, state, bottom_up=False)
+        Draw a 2D array of values on the canvas, colored by a colormap.
+
+        Values are mapped linearly from [vmin, vmax] onto the colors of the
+        colormap, and values outside of that range get the first or last
+        color. NaN values are transparent. The values are sampled before they
+        are colored: by nearest neighbor when ``state.image_filter`` is
+        ``ImageFilter.Nearest`` and bilinearly otherwise. ``master_alpha``,
+        ``image_blend_mode``, clipping and stencils apply as they do for
+        ``draw_image``.
+
+        :param array: A 2D array of values, or an ``Image`` with the ``Gray32``
+                      format. Arrays which aren't C-contiguous ``float32`` are
+                      copied.
+        :param colormap: An Nx3 or Nx4 array of RGB(A) colors, as floats in
+                         [0, 1] or ``uint8`` values
+        :param vmin: The value which gets the first color
+        :param vmax: The value which gets the last color
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param bottom_up: If True, the array is flipped in the y axis
+        """
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+
+        cdef GraphicsState gs = <GraphicsState>state
+        cdef Transform trans = <Transform>transform
+        cdef double _vmin = vmin
+        cdef double _vmax = vmax
+        cdef double[:, ::1] colors = _get_colormap(colormap)
+        cdef Image img
+
+        if isinstance(array, Image):
+            img = array
+            if img.pixel_format != PixelFormat.Gray32:
+                raise ValueError("A scalar image must have the Gray32 format")
+        else:
+            values = numpy.ascontiguousarray(array, dtype=numpy.float32)
+            if values.ndim != 2:
+                raise ValueError("A scalar image array must be 2 dimensional")
+            img = Image(values, PixelFormat.Gray32, bottom_up=bottom_up)
+
+        with nogil:
+            self._this.draw_scalar_image(dereference(img._this),
+                                         &colors[0, 0], colors.shape[0],
+                                         _vmin, _vmax,
+                                         dereference(trans._this),
+                                         dereference(gs._this))
+
+    def draw_picture(self, picture):
+        """draw_picture(picture)
+        Draw all of the commands recorded in a ``Picture`` on the canvas.
+
+        :param picture: A ``Picture`` object
+        """
+        if not isinstance(picture, Picture):
+            raise TypeError("picture must be a Picture instance")
+
+        cdef:
+            Picture pic = <Picture>picture
+            _NativePicture native
+
+        native = pic._compile(self)
+
+        with nogil:
+            self._this.draw_picture(dereference(native._this))
 
     def draw_shape(self, shape, transform, state, stroke=None, fill=None):
         """draw_shape(shape, transform, state, stroke=SolidColor(0, 0, 0), fill=SolidColor(0, 0, 0))
@@ -188,20 +286,27 @@ cdef class CanvasBase:
             Paint stroke_paint
             Paint fill_paint
 
-        self._check_stencil(gs)
         stroke_paint = self._get_native_paint(stroke, fmt)
         fill_paint = self._get_native_paint(fill, fmt)
 
-        self._this.draw_shape(dereference(shp._this),
-                              dereference(trans._this),
-                              dereference(stroke_paint._this),
-                              dereference(fill_paint._this),
-                              dereference(gs._this))
+        with nogil:
+            self._this.draw_shape(dereference(shp._this),
+                                  dereference(trans._this),
+                                  dereference(stroke_paint._this),
+                                  dereference(fill_paint._this),
+                                  dereference(gs._this))
 
     def draw_shape_at_points(self, shape, points, transform, state, stroke=None, fill=None):
         """draw_shape_at_points(shape, points, transform, state, stroke=SolidColor(0, 0, 0), fill=SolidColor(0, 0, 0))
         Draw a shape at multiple points on the canvas.
 
+        The shape is only rasterized once for each quarter pixel offset it
+        lands on, and that coverage is reused for every point which shares the
+        offset. Point positions are therefore rounded to the nearest quarter of
+        a device pixel. If the ``clip_box`` of ``state`` has fractional edges,
+        or a gradient is sized relative to the shape's bounding box while a
+        ``clip_box`` is set, every point is rasterized separately instead.
+
         .. note::
            Use ``GraphicsState.drawing_mode`` to enable/disable stroke or fill
            drawing.
@@ -231,6 +336,7 @@ cdef class CanvasBase:
             GraphicsState gs = <GraphicsState>state
             Transform trans = <Transform>transform
             PixelFormat fmt = self.pixel_format
+            const double* pts
             Paint stroke_paint
             Paint fill_paint
 
@@ -238,16 +344,152 @@ cdef class CanvasBase:
             msg = 'Points argument must be an iterable of (x, y) pairs.'
             raise ValueError(msg)
 
-        self._check_stencil(gs)
         stroke_paint = self._get_native_paint(stroke, fmt)
         fill_paint = self._get_native_paint(fill, fmt)
 
-        self._this.draw_shape_at_points(dereference(shp._this),
-                                        &_points[0][0], _points.shape[0],
-                                        dereference(trans._this),
-                                        dereference(stroke_paint._this),
-                                        dereference(fill_paint._this),
-                                        dereference(gs._this))
+        pts = &_points[0][0]
+        with nogil:
+            self._this.draw_shape_at_points(dereference(shp._this),
+                                            pts, _points.shape[0],
+                                            dereference(trans._this),
+                                            dereference(stroke_paint._this),
+                                            dereference(fill_paint._this),
+                                            dereference(gs._this))
+
+    def draw_markers(self, points, marker_type, size, paint, state, transform=None):
+        """draw_markers(points, marker_type, size, paint, state, transform=None)
+        Draw a marker at each of a set of points on the canvas.
+
+        Markers are drawn at a fixed size in pixels, no matter what
+        ``transform`` does. Filled markers are filled with ``paint``, and the
+        ``MarkerCross``, ``MarkerX`` and ``MarkerDash`` markers are stroked
+        with it. When ``anti_aliased`` is set on ``state``, markers are drawn
+        like ``draw_shape_at_points``, so their positions are rounded to a
+        quarter of a pixel. Otherwise, solid paints are drawn by AGG's marker
+        renderer, which puts each marker on a whole pixel and draws line
+        markers one pixel wide.
+
+        :param points: An Nx2 array of (x, y) marker centers. A C contiguous
+                       float64 array is used without being copied.
+        :param marker_type: A ``MarkerType`` value
+        :param size: The width of a marker in pixels
+        :param paint: The ``Paint`` to draw the markers with
+        :param state: A ``GraphicsState`` object
+        :param transform: A ``Transform`` for the points. Defaults to the
+                          identity transform.
+        """
+        if not isinstance(marker_type, MarkerType):
+            raise TypeError("marker_type must be a MarkerType value")
+        if not isinstance(paint, Paint):
+            raise TypeError("paint must be a Paint instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+        if transform is None:
+            transform = Transform()
+        elif not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+
+        cdef:
+            double[:,::1] _points = numpy.asarray(points, dtype=numpy.float64,
+                                                  order='c')
+            GraphicsState gs = <GraphicsState>state
+            Transform trans = <Transform>transform
+            PixelFormat fmt = self.pixel_format
+            _enums.MarkerType mtype = marker_type
+            double msize = size
+            const double* pts
+            Paint native_paint
+
+        if _points.shape[1] != 2:
+            msg = 'Points argument must be an iterable of (x, y) pairs.'
+            raise ValueError(msg)
+        if _points.shape[0] == 0:
+            return
+
+        native_paint = self._get_native_paint(paint, fmt)
+
+        pts = &_points[0][0]
+        with nogil:
+            self._this.draw_markers(pts, _points.shape[0], mtype, msize,
+                                    dereference(trans._this),
+                                    dereference(native_paint._this),
+                                    dereference(gs._this))
+
+    def draw_shapes_compound(self, shapes, paints, transform, state, styles=None):
+        """draw_shapes_compound(shapes, paints, transform, state, styles=None)
+        Fill several shapes on the canvas with a single rasterizer pass.
+
+        Every shape is filled with one of the ``paints``. Edges which are
+        shared by two shapes are drawn without the seams that appear when the
+        shapes are drawn one at a time. Where shapes overlap, the shape whose
+        paint has the higher index is on top, and the shapes below it only get
+        the part of each pixel's coverage that it leaves uncovered.
+
+        .. note::
+           Only fills are drawn. Shapes are filled exactly to their outlines,
+           which makes them half a pixel narrower than ``draw_shape`` fills.
+           The ``anti_aliased`` setting of ``state`` is ignored. Gradients with
+           ``ObjectBoundingBox`` units use the bounds of all of the shapes
+           drawn with them.
+
+        :param shapes: A sequence of ``VertexSource`` objects
+        :param paints: A sequence of ``Paint`` objects. There can be at most
+                       32767 of them.
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param styles: A sequence with the index in ``paints`` of the paint
+                       for each shape. By default shape N uses paint N.
+        """
+        shapes = list(shapes)
+        paints = list(paints)
+        if not all(isinstance(s, VertexSource) for s in shapes):
+            raise TypeError("shapes must be VertexSource (Path, BSpline, etc) instances")
+        if not all(isinstance(p, Paint) for p in paints):
+            raise TypeError("paints must be Paint instances")
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+        if len(paints) > 32767:
+            raise ValueError("There can be at most 32767 paints")
+        if styles is None:
+            styles = numpy.arange(len(shapes))
+        styles = numpy.asarray(styles)
+        if styles.ndim != 1 or len(styles) != len(shapes):
+            raise ValueError("styles must have one entry for each shape")
+        if len(styles) > 0 and (styles.min() < 0 or styles.max() >= len(paints)):
+            raise ValueError("styles must be indices of paints")
+
+        cdef:
+            GraphicsState gs = <GraphicsState>state
+            Transform trans = <Transform>transform
+            PixelFormat fmt = self.pixel_format
+            unsigned[::1] _styles = styles.astype(numpy.uintc)
+            vector[_vertex_source.VertexSource*] shape_ptrs
+            vector[_paint.Paint*] paint_ptrs
+            VertexSource shp
+            Paint pnt
+            list native_paints = []
+            const unsigned* stls = NULL
+
+        for shp in shapes:
+            shape_ptrs.push_back(shp._this)
+        for paint in paints:
+            pnt = self._get_native_paint(paint, fmt)
+            native_paints.append(pnt)
+            paint_ptrs.push_back(pnt._this)
+
+        if shape_ptrs.size() == 0:
+            return
+
+        stls = &_styles[0]
+        with nogil:
+            self._this.draw_shapes_compound(shape_ptrs.data(), stls,
+                                            shape_ptrs.size(),
+                                            paint_ptrs.data(),
+                                            paint_ptrs.size(),
+                                            dereference(trans._this),
+                                            dereference(gs._this))
 
     def draw_text(self, text, font, transform, state, stroke=None, fill=None):
         """draw_text(text, font, transform, state, stroke=SolidColor(0, 0, 0), fill=SolidColor(0, 0, 0))
@@ -289,31 +531,19 @@ cdef class CanvasBase:
             PixelFormat fmt = self.pixel_format
             Paint stroke_paint
             Paint fill_paint
+            const char* c_text
 
-        self._check_stencil(gs)
         stroke_paint = self._get_native_paint(stroke, fmt)
         fill_paint = self._get_native_paint(fill, fmt)
 
         text = _get_utf8_text(text, "The text argument must be unicode.")
-        self._this.draw_text(text, dereference(fnt._this),
-                             dereference(trans._this),
-                             dereference(stroke_paint._this),
-                             dereference(fill_paint._this),
-                             dereference(gs._this))
-
-    cdef _check_stencil(self, GraphicsState state):
-        """Internal. Checks if a stencil's dimensions match those of the
-        canvas.
-        """
-        cdef Image stencil = state.stencil
-        if stencil is not None:
-            w, h = self.width, self.height
-            sw, sh = stencil.width, stencil.height
-            if sw != w or sh != h:
-                msg = ("The stencil set on the GraphicsState object does not "
-                       "have the same dimensions as the target canvas! "
-                       "(({}, {}) vs. ({}, {}))").format(sw, sh, w, h)
-                raise AggError(msg)
+        c_text = text
+        with nogil:
+            self._this.draw_text(c_text, dereference(fnt._this),
+                                 dereference(trans._this),
+                                 dereference(stroke_paint._this),
+                                 dereference(fill_paint._this),
+                                 dereference(gs._this))
 
     cdef Image _get_native_image(self, Image image, PixelFormat fmt):
         """_get_native_image(image, format)
@@ -322,10 +552,7 @@ cdef class CanvasBase:
                       format.
         :param format: The desired output pixel format
         """
-        if image.pixel_format == fmt:
-            return image
-
-        return convert_image(image, fmt, bottom_up=image.bottom_up)
+        return image._with_format(fmt)
 
     cdef Paint _get_native_paint(self, paint, PixelFormat fmt):
         """_get_native_paint(paint, format)
@@ -344,11 +571,12 @@ cdef class CanvasBase:
 
 
 cdef class CanvasRGBA128(CanvasBase):
-    def __cinit__(self, float[:,:,::1] image, FontCache cache, bottom_up=False):
+    def __cinit__(self, float[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
         cdef:
             FontCache font_cache = <FontCache>cache
 
-        self.base_init(image, 4, True)
+        self.base_init(image, threads, 4, True)
         self.pixel_format = PixelFormat.RGBA128
         self.bottom_up = bottom_up
         self.font_cache = cache
@@ -357,15 +585,16 @@ cdef class CanvasRGBA128(CanvasBase):
                                                            image.shape[0],
                                                            image.strides[0], 4,
                                                            dereference(font_cache._this),
-                                                           bottom_up)
+                                                           bottom_up, threads)
 
 
 cdef class CanvasBGRA32(CanvasBase):
-    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False):
+    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
         cdef:
             FontCache font_cache = <FontCache>cache
 
-        self.base_init(image, 4, True)
+        self.base_init(image, threads, 4, True)
         self.pixel_format = PixelFormat.BGRA32
         self.bottom_up = bottom_up
         self.font_cache = cache
@@ -374,15 +603,16 @@ cdef class CanvasBGRA32(CanvasBase):
                                                           image.shape[0],
                                                           image.strides[0], 4,
                                                           dereference(font_cache._this),
-                                                          bottom_up)
+                                                          bottom_up, threads)
 
 
 cdef class CanvasRGBA32(CanvasBase):
-    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False):
+    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
         cdef:
             FontCache font_cache = <FontCache>cache
 
-        self.base_init(image, 4, True)
+        self.base_init(image, threads, 4, True)
         self.pixel_format = PixelFormat.RGBA32
         self.bottom_up = bottom_up
         self.font_cache = cache
@@ -391,15 +621,106 @@ cdef class CanvasRGBA32(CanvasBase):
                                                           image.shape[0],
                                                           image.strides[0], 4,
                                                           dereference(font_cache._this),
-                                                          bottom_up)
+                                                          bottom_up, threads)
+
+
+cdef class CanvasRGBA128Pre(CanvasBase):
+    def __cinit__(self, float[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 4, True)
+        self.pixel_format = PixelFormat.RGBA128Pre
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_rgba128_pre_t(<_bytes_t*>&image[0][0][0],
+                                                               image.shape[1],
+                                                               image.shape[0],
+                                                               image.strides[0], 4,
+                                                               dereference(font_cache._this),
+                                                               bottom_up, threads)
+
+
+cdef class CanvasBGRA32Pre(CanvasBase):
+    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 4, True)
+        self.pixel_format = PixelFormat.BGRA32Pre
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_bgra32_pre_t(&image[0][0][0],
+                                                              image.shape[1],
+                                                              image.shape[0],
+                                                              image.strides[0], 4,
+                                                              dereference(font_cache._this),
+                                                              bottom_up, threads)
+
+
+cdef class CanvasRGBA32Pre(CanvasBase):
+    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 4, True)
+        self.pixel_format = PixelFormat.RGBA32Pre
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_rgba32_pre_t(&image[0][0][0],
+                                                              image.shape[1],
+                                                              image.shape[0],
+                                                              image.strides[0], 4,
+                                                              dereference(font_cache._this),
+                                                              bottom_up, threads)
+
+
+cdef class CanvasRGBA64(CanvasBase):
+    def __cinit__(self, _words_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 4, True)
+        self.pixel_format = PixelFormat.RGBA64
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_rgba64_t(<_bytes_t*>&image[0][0][0],
+                                                          image.shape[1],
+                                                          image.shape[0],
+                                                          image.strides[0], 4,
+                                                          dereference(font_cache._this),
+                                                          bottom_up, threads)
+
+
+cdef class CanvasRGB48(CanvasBase):
+    def __cinit__(self, _words_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 4, False)
+        self.pixel_format = PixelFormat.RGB48
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_rgb48_t(<_bytes_t*>&image[0][0][0],
+                                                         image.shape[1],
+                                                         image.shape[0],
+                                                         image.strides[0], 3,
+                                                         dereference(font_cache._this),
+                                                         bottom_up, threads)
 
 
 cdef class CanvasRGB24(CanvasBase):
-    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False):
+    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
         cdef:
             FontCache font_cache = <FontCache>cache
 
-        self.base_init(image, 4, False)
+        self.base_init(image, threads, 4, False)
         self.pixel_format = PixelFormat.RGB24
         self.bottom_up = bottom_up
         self.font_cache = cache
@@ -408,15 +729,16 @@ cdef class CanvasRGB24(CanvasBase):
                                                          image.shape[0],
                                                          image.strides[0], 3,
                                                          dereference(font_cache._this),
-                                                         bottom_up)
+                                                         bottom_up, threads)
 
 
 cdef class CanvasGA16(CanvasBase):
-    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False):
+    def __cinit__(self, _bytes_t[:,:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
         cdef:
             FontCache font_cache = <FontCache>cache
 
-        self.base_init(image, 2, True)
+        self.base_init(image, threads, 2, True)
         self.pixel_format = PixelFormat.Gray8
         self.bottom_up = bottom_up
         self.font_cache = cache
@@ -425,15 +747,16 @@ cdef class CanvasGA16(CanvasBase):
                                                         image.shape[0],
                                                         image.strides[0], 2,
                                                         dereference(font_cache._this),
-                                                        bottom_up)
+                                                        bottom_up, threads)
 
 
 cdef class CanvasG8(CanvasBase):
-    def __cinit__(self, _bytes_t[:,::1] image, FontCache cache, bottom_up=False):
+    def __cinit__(self, _bytes_t[:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
         cdef:
             FontCache font_cache = <FontCache>cache
 
-        self.base_init(image, 2, False)
+        self.base_init(image, threads, 2, False)
         self.pixel_format = PixelFormat.Gray8
         self.bottom_up = bottom_up
         self.font_cache = cache
@@ -442,4 +765,40 @@ cdef class CanvasG8(CanvasBase):
                                                         image.shape[0],
                                                         image.strides[0], 1,
                                                         dereference(font_cache._this),
-                                                        bottom_up)
+                                                        bottom_up, threads)
+
+
+cdef class CanvasG16(CanvasBase):
+    def __cinit__(self, _words_t[:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 2, False)
+        self.pixel_format = PixelFormat.Gray16
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_gray16_t(<_bytes_t*>&image[0][0],
+                                                          image.shape[1],
+                                                          image.shape[0],
+                                                          image.strides[0], 1,
+                                                          dereference(font_cache._this),
+                                                          bottom_up, threads)
+
+
+cdef class CanvasG32(CanvasBase):
+    def __cinit__(self, float[:,::1] image, FontCache cache, bottom_up=False,
+                  int threads=1):
+        cdef:
+            FontCache font_cache = <FontCache>cache
+
+        self.base_init(image, threads, 2, False)
+        self.pixel_format = PixelFormat.Gray32
+        self.bottom_up = bottom_up
+        self.font_cache = cache
+        self._this = <canvas_base_t*> new canvas_gray32_t(<_bytes_t*>&image[0][0],
+                                                          image.shape[1],
+                                                          image.shape[0],
+                                                          image.strides[0], 1,
+                                                          dereference(font_cache._this),
+                                                          bottom_up, threads)
@@ -35,6 +35,8 @@ Paint::Paint(const double r, const double g, const double b, const double a)
 , m_spread(k_GradientSpreadInvalid)
 , m_units(k_GradientUnitsInvalid)
 , m_pattern_style(k_PatternStyleInvalid)
+, m_colors_key(NULL)
+, m_colors_alpha(0.0)
 {
 }
 
@@ -51,6 +53,8 @@ Paint::Paint(const PaintType type,
 , m_spread(spread)
 , m_units(units)
 , m_pattern_style(k_PatternStyleInvalid)
+, m_colors_key(NULL)
+, m_colors_alpha(0.0)
 {
 }
 
@@ -64,6 +68,8 @@ Paint::Paint(const PatternStyle style, Image* img)
 , m_spread(k_GradientSpreadInvalid)
 , m_units(k_GradientUnitsUserSpace)
 , m_pattern_style(style)
+, m_colors_key(NULL)
+, m_colors_alpha(0.0)
 {
 }
 
@@ -26,8 +26,15 @@
 #ifndef CELIAGG_PAINT_H
 #define CELIAGG_PAINT_H
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <agg_array.h>
 #include <agg_basics.h>
+#include <agg_color_gray.h>
 #include <agg_color_rgba.h>
 #include <agg_pixfmt_rgb.h>
 #include <agg_renderer_scanline.h>
@@ -37,6 +44,7 @@
 #include <agg_span_interpolator_linear.h>
 #include <agg_trans_affine.h>
 
+#include "gradient_span.h"
 #include "image.h"
 
 struct GradientStop
@@ -54,6 +62,44 @@ struct GradientStop
                  off(o), r(_r), g(_g), b(_b), a(_a) {}
 };
 
+// The number of colors which gradients are generated with for `color_t`.
+// Deeper color types get more, so that long gradients don't show steps.
+template<typename color_t>
+struct gradient_lut_size { enum { value = 256 }; };
+template<> struct gradient_lut_size<agg::rgba16> { enum { value = 1024 }; };
+template<> struct gradient_lut_size<agg::rgba32> { enum { value = 1024 }; };
+template<> struct gradient_lut_size<agg::gray16> { enum { value = 1024 }; };
+template<> struct gradient_lut_size<agg::gray32> { enum { value = 1024 }; };
+
+// The color lookup table of a gradient, shared with the Paint which caches it.
+// This is the color function of agg::span_gradient.
+template<typename color_t>
+class GradientColors
+{
+public:
+    typedef std::vector<color_t> colors_t;
+
+    explicit GradientColors(const std::shared_ptr<const colors_t>& colors)
+    : m_colors(colors)
+    {}
+
+    unsigned size() const { return unsigned(m_colors->size()); }
+    const color_t& operator [] (const unsigned i) const { return (*m_colors)[i]; }
+
+private:
+    std::shared_ptr<const colors_t> m_colors;
+};
+
+// Generates the colors of a paint one span at a time, for renderers which
+// need the colors of more than one paint at once.
+template<typename color_t>
+class PaintSpanSource
+{
+public:
+    virtual ~PaintSpanSource() {}
+    virtual void generate(color_t* span, int x, int y, unsigned len) = 0;
+};
+
 
 class Paint
 {
@@ -141,6 +187,8 @@ public:
     void transform(const agg::trans_affine& mat);
     const agg::trans_affine& transform() const;
 
+    PaintType type() const { return m_type; }
+
     void spread(const GradientSpread spread) { m_spread = spread; }
     GradientSpread spread() const { return m_spread; }
 
@@ -153,25 +201,35 @@ public:
     template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
     void render(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, const agg::trans_affine& transform);
 
+    // Returns a new span source for a gradient or pattern, or NULL for a solid
+    // color. `bbox` holds the x, y, width and height of the device space bounds
+    // of the shape, which are used by gradients with bounding box units.
+    template <typename pixfmt_t>
+    PaintSpanSource<typename pixfmt_t::color_type>* span_source(const agg::trans_affine& transform, const double* bbox);
+
+    // The color of a solid paint, with the master alpha applied
+    template <typename pixfmt_t>
+    typename pixfmt_t::color_type solid_color() const;
+
 private:
 
-    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
-    void _render_linear_grad(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer);
+    template <typename pixfmt_t>
+    PaintSpanSource<typename pixfmt_t::color_type>* _linear_grad_source(const agg::trans_affine& mtx, const double* bbox);
 
-    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
-    void _render_radial_grad(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer);
+    template <typename pixfmt_t>
+    PaintSpanSource<typename pixfmt_t::color_type>* _radial_grad_source(const agg::trans_affine& mtx, const double* bbox);
 
-    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t, typename grad_func_t, typename vector_t>
-    void _render_spread_grad(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, grad_func_t& func, vector_t& points);
+    template <typename pixfmt_t, typename vector_t>
+    PaintSpanSource<typename pixfmt_t::color_type>* _gradient_source_final(GradientIndexParams& params, const vector_t& points, const agg::trans_affine& mtx);
 
-    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t, typename grad_func_t, typename vector_t>
-    void _render_gradient_final(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, grad_func_t& func, vector_t& points);
+    template <typename pixfmt_t>
+    GradientColors<typename pixfmt_t::color_type> _gradient_colors();
 
-    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
-    void _render_pattern(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer);
+    template <typename pixfmt_t>
+    PaintSpanSource<typename pixfmt_t::color_type>* _pattern_source(const agg::trans_affine& mtx);
 
-    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t, typename source_t, typename span_gen_t>
-    void _render_pattern_final(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer);
+    template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
+    void _render_spans(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, PaintSpanSource<typename pixfmt_t::color_type>& source);
 
     template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
     void _render_solid(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer);
@@ -193,6 +251,20 @@ private:
     GradientSpread      m_spread;
     GradientUnits       m_units;
     PatternStyle        m_pattern_style;
+
+    // The gradient colors of the last draw. They are generated again when the
+    // master alpha, the color type of the canvas or the stops change. The
+    // stops are in an array which the caller owns and can change, so the
+    // colors keep a copy of the stops they were made from.
+    std::mutex                  m_colors_mutex;
+    const void*                 m_colors_key;
+    double                      m_colors_alpha;
+    std::vector<GradientStop>   m_colors_stops;
+    std::shared_ptr<const void> m_colors;
+
+    // Not copyable
+    Paint(const Paint&);
+    Paint& operator = (const Paint&);
 };
 
 #include "paint.hxx"
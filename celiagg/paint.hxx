@@ -36,8 +36,8 @@ void _generate_colors(const agg::pod_array_adaptor<GradientStop>& stops, double
         const GradientStop& next_stop = stops[stop_idx+1];
         const agg::rgba curr_rgba(curr_stop.r, curr_stop.g, curr_stop.b, alpha*curr_stop.a);
         const agg::rgba next_rgba(next_stop.r, next_stop.g, next_stop.b, alpha*next_stop.a);
-        const typename pixfmt_t::color_type curr_color(curr_rgba);
-        const typename pixfmt_t::color_type next_color(next_rgba);
+        const typename pixfmt_t::color_type curr_color(pixfmt_color<pixfmt_t>(curr_rgba));
+        const typename pixfmt_t::color_type next_color(pixfmt_color<pixfmt_t>(next_rgba));
         const double offset_range = next_stop.off - curr_stop.off;
 
         while (offset <= next_stop.off && arr_index < array_size)
@@ -48,6 +48,16 @@ void _generate_colors(const agg::pod_array_adaptor<GradientStop>& stops, double
     }
 }
 
+// Identifies the gradient colors generated for `color_t`, premultiplied or not
+template <typename color_t, bool premultiplied>
+struct gradient_colors_key
+{
+    static const char id;
+};
+
+template <typename color_t, bool premultiplied>
+const char gradient_colors_key<color_t, premultiplied>::id = 0;
+
 template <typename rasterizer_t>
 void _rasterizer_path_bbox(rasterizer_t& ras, double& x, double& y, double& w, double& h)
 {
@@ -57,44 +67,209 @@ void _rasterizer_path_bbox(rasterizer_t& ras, double& x, double& y, double& w, d
     h = ras.max_y() - y;
 }
 
+// agg::span_gradient with agg::span_interpolator_linear<> for the gradients
+// of Paint. The color indices of a span are computed together by
+// gradient_span_indices().
+template <typename color_t, typename color_array_t>
+class span_gradient_indexed
+{
+public:
+    typedef color_t color_type;
+
+    span_gradient_indexed(const agg::trans_affine& mtx,
+                          const GradientIndexParams& params,
+                          const color_array_t& colors)
+    : m_mtx(&mtx)
+    , m_params(params)
+    , m_colors(&colors)
+    {
+        m_params.size = m_colors->size();
+    }
+
+    void prepare() {}
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        // The ends of the span, as agg::span_interpolator_linear::begin()
+        double tx = x + 0.5, ty = y + 0.5;
+        m_mtx->transform(&tx, &ty);
+        const int x1 = agg::iround(tx * agg::image_subpixel_scale);
+        const int y1 = agg::iround(ty * agg::image_subpixel_scale);
+
+        tx = x + 0.5 + len;
+        ty = y + 0.5;
+        m_mtx->transform(&tx, &ty);
+        const int x2 = agg::iround(tx * agg::image_subpixel_scale);
+        const int y2 = agg::iround(ty * agg::image_subpixel_scale);
+
+        m_indices.resize(len);
+        int* indices = &m_indices[0];
+        gradient_span_indices(m_params, x1, y1, x2, y2, len, indices);
+        for (unsigned i = 0; i < len; ++i)
+        {
+            span[i] = (*m_colors)[indices[i]];
+        }
+    }
+
+private:
+    const agg::trans_affine* m_mtx;
+    GradientIndexParams m_params;
+    const color_array_t* m_colors;
+    std::vector<int>    m_indices;
+};
+
+// Owns a gradient span generator along with everything that it refers to
+template <typename pixfmt_t>
+class GradientSpanSource : public PaintSpanSource<typename pixfmt_t::color_type>
+{
+public:
+    typedef typename pixfmt_t::color_type color_t;
+    typedef GradientColors<color_t> color_array_t;
+
+    GradientSpanSource(const GradientIndexParams& params, const agg::trans_affine& mtx,
+                       const color_array_t& colors)
+    : m_mtx(mtx)
+    , m_colors(colors)
+    , m_span_gradient(m_mtx, params, m_colors)
+    {
+        m_span_gradient.prepare();
+    }
+
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        m_span_gradient.generate(span, x, y, len);
+    }
+
+private:
+    typedef span_gradient_indexed<color_t, color_array_t> span_gradient_t;
+
+    agg::trans_affine   m_mtx;
+    color_array_t       m_colors;
+    span_gradient_t     m_span_gradient;
+
+    // Not copyable
+    GradientSpanSource(const GradientSpanSource&);
+    GradientSpanSource& operator = (const GradientSpanSource&);
+};
+
+// Owns a pattern span generator along with everything that it refers to
+template <typename pixfmt_t, typename source_t, typename span_gen_t>
+class PatternSpanSource : public PaintSpanSource<typename pixfmt_t::color_type>
+{
+public:
+    typedef typename pixfmt_t::color_type color_t;
+    typedef span_master_alpha<color_t, pixfmt_premultiplied<pixfmt_t>::value> alpha_t;
+    typedef agg::span_converter<span_gen_t, alpha_t> alpha_span_gen_t;
+
+    PatternSpanSource(Image& image, const agg::trans_affine& inv_mtx, const double alpha)
+    : m_pixfmt(image.get_buffer())
+    , m_source(m_pixfmt)
+    , m_mtx(inv_mtx)
+    , m_interpolator(m_mtx)
+    , m_span_gen(m_source, m_interpolator)
+    , m_alpha(alpha)
+    , m_alpha_span_gen(m_span_gen, m_alpha)
+    {
+        m_alpha_span_gen.prepare();
+    }
+
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        m_alpha_span_gen.generate(span, x, y, len);
+    }
+
+private:
+    pixfmt_t            m_pixfmt;
+    source_t            m_source;
+    agg::trans_affine   m_mtx;
+    interpolator_t      m_interpolator;
+    span_gen_t          m_span_gen;
+    alpha_t             m_alpha;
+    alpha_span_gen_t    m_alpha_span_gen;
+
+    // Not copyable
+    PatternSpanSource(const PatternSpanSource&);
+    PatternSpanSource& operator = (const PatternSpanSource&);
+};
+
+// Adapts a PaintSpanSource to AGG's span generator interface
+template <typename color_t>
+class PaintSpanGenerator
+{
+public:
+    PaintSpanGenerator(PaintSpanSource<color_t>& source) : m_source(source) {}
+
+    void prepare() {}
+    void generate(color_t* span, int x, int y, unsigned len)
+    {
+        m_source.generate(span, x, y, len);
+    }
+
+private:
+    PaintSpanSource<color_t>& m_source;
+};
+
 template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
 void Paint::render(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, const agg::trans_affine& transform)
 {
-    const agg::trans_affine saved_transform(m_transform);
+    typedef PaintSpanSource<typename pixfmt_t::color_type> span_source_t;
+
+    if (m_type == Paint::k_PaintTypeSolid)
+    {
+        _render_solid<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(ras, scanline, renderer);
+        return;
+    }
+
+    double bbox[4] = { 0.0, 0.0, 0.0, 0.0 };
+    if (m_units == Paint::k_GradientUnitsObjectBoundingBox)
+    {
+        _rasterizer_path_bbox(ras, bbox[0], bbox[1], bbox[2], bbox[3]);
+    }
+
+    std::unique_ptr<span_source_t> source(span_source<pixfmt_t>(transform, bbox));
+    if (source)
+    {
+        _render_spans<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(ras, scanline, renderer, *source);
+    }
+}
+
+template <typename pixfmt_t>
+PaintSpanSource<typename pixfmt_t::color_type>* Paint::span_source(const agg::trans_affine& transform, const double* bbox)
+{
+    // Only the cached gradient colors of the paint are modified here, under
+    // a lock, so that it can be rendered by more than one thread at once.
+    agg::trans_affine mtx(m_transform);
 
     if (m_units == Paint::k_GradientUnitsUserSpace)
     {
-        m_transform *= transform;
+        mtx *= transform;
     }
 
     switch (m_type)
     {
-    case Paint::k_PaintTypeSolid:
-        _render_solid<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(ras, scanline, renderer);
-        break;
-
     case Paint::k_PaintTypeLinearGradient:
-        _render_linear_grad<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(ras, scanline, renderer);
-        break;
+        return _linear_grad_source<pixfmt_t>(mtx, bbox);
 
     case Paint::k_PaintTypeRadialGradient:
-        _render_radial_grad<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(ras, scanline, renderer);
-        break;
+        return _radial_grad_source<pixfmt_t>(mtx, bbox);
 
     case Paint::k_PaintTypePattern:
-        _render_pattern<pixfmt_t, rasterizer_t, scanline_t, renderer_t>(ras, scanline, renderer);
-        break;
+        return _pattern_source<pixfmt_t>(mtx);
 
+    case Paint::k_PaintTypeSolid:
     default:
-        break;
+        return NULL;
     }
-
-    m_transform = saved_transform;
 }
 
+template <typename pixfmt_t>
+typename pixfmt_t::color_type Paint::solid_color() const
+{
+    const agg::rgba color_with_alpha(m_color, m_master_alpha*m_color.a);
+    return pixfmt_color<pixfmt_t>(color_with_alpha);
+}
 
-template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
-void Paint::_render_linear_grad(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer)
+template <typename pixfmt_t>
+PaintSpanSource<typename pixfmt_t::color_type>* Paint::_linear_grad_source(const agg::trans_affine& mtx, const double* bbox)
 {
     typedef agg::pod_auto_vector<double, k_LinearPointsSize> vector_t;
 
@@ -105,36 +280,22 @@ void Paint::_render_linear_grad(rasterizer_t& ras, scanline_t& scanline, rendere
 
     if (m_units == Paint::k_GradientUnitsObjectBoundingBox)
     {
-        double x, y, w, h;
-        _rasterizer_path_bbox(ras, x, y, w, h);
+        const double x = bbox[0], y = bbox[1], w = bbox[2], h = bbox[3];
         points[k_LinearX1] = x + points[k_LinearX1] * w;
         points[k_LinearX2] = x + points[k_LinearX2] * w;
         points[k_LinearY1] = y + points[k_LinearY1] * h;
         points[k_LinearY2] = y + points[k_LinearY2] * h;
     }
 
-    if (points[0] == points[2])
-    {
-        typedef agg::gradient_y function_t;
-        function_t func;
-        _render_spread_grad<pixfmt_t, rasterizer_t, scanline_t, renderer_t, function_t, vector_t>(ras, scanline, renderer, func, points);
-    }
-    else if (points[1] == points[3])
-    {
-        typedef agg::gradient_x function_t;
-        function_t func;
-        _render_spread_grad<pixfmt_t, rasterizer_t, scanline_t, renderer_t, function_t, vector_t>(ras, scanline, renderer, func, points);
-    }
-    else
-    {
-        typedef agg::gradient_x function_t;
-        function_t func;
-        _render_spread_grad<pixfmt_t, rasterizer_t, scanline_t, renderer_t, function_t, vector_t>(ras, scanline, renderer, func, points);
-    }
+    // Vertical gradients use the y coordinate, like agg::gradient_y
+    GradientIndexParams params;
+    params.function = points[0] == points[2] ? GradientIndexParams::k_FunctionY
+                                             : GradientIndexParams::k_FunctionX;
+    return _gradient_source_final<pixfmt_t, vector_t>(params, points, mtx);
 }
 
-template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
-void Paint::_render_radial_grad(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer)
+template <typename pixfmt_t>
+PaintSpanSource<typename pixfmt_t::color_type>* Paint::_radial_grad_source(const agg::trans_affine& mtx, const double* bbox)
 {
     // m_points: cx, cy, r, fx, fy
     typedef agg::pod_auto_vector<double, k_RadialPointsSize> vector_t;
@@ -146,8 +307,7 @@ void Paint::_render_radial_grad(rasterizer_t& ras, scanline_t& scanline, rendere
 
     if (m_units == Paint::k_GradientUnitsObjectBoundingBox)
     {
-        double x, y, w, h;
-        _rasterizer_path_bbox(ras, x, y, w, h);
+        const double x = bbox[0], y = bbox[1], w = bbox[2], h = bbox[3];
         points[k_RadialR] = points[k_RadialR] * w;
         points[k_RadialCX] = x + points[k_RadialCX] * w;
         points[k_RadialFX] = x + points[k_RadialFX] * w;
@@ -156,55 +316,19 @@ void Paint::_render_radial_grad(rasterizer_t& ras, scanline_t& scanline, rendere
     }
 
     // function args: radius, focus dx, focus dy
-    typedef agg::gradient_radial_focus grad_func_t;
-    agg::gradient_radial_focus func(points[k_RadialR],
-                                    points[k_RadialFX] - points[k_RadialCX],
-                                    points[k_RadialFY] - points[k_RadialCY]);
-    _render_spread_grad<pixfmt_t, rasterizer_t, scanline_t, renderer_t, grad_func_t, vector_t>(ras, scanline, renderer, func, points);
+    GradientIndexParams params;
+    params.radial_focus(points[k_RadialR],
+                        points[k_RadialFX] - points[k_RadialCX],
+                        points[k_RadialFY] - points[k_RadialCY]);
+    return _gradient_source_final<pixfmt_t, vector_t>(params, points, mtx);
 }
 
-template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t, typename grad_func_t, typename vector_t>
-void Paint::_render_spread_grad(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, grad_func_t& func, vector_t& points)
+template <typename pixfmt_t, typename vector_t>
+PaintSpanSource<typename pixfmt_t::color_type>* Paint::_gradient_source_final(GradientIndexParams& params, const vector_t& points, const agg::trans_affine& mtx)
 {
-    // apply the proper fill adapter based on the spread method
-    switch (m_spread)
-    {
-    case Paint::k_GradientSpreadReflect:
-        {
-            typedef agg::gradient_reflect_adaptor<grad_func_t> adapted_func_t;
-            agg::gradient_reflect_adaptor<grad_func_t> adaptor(func);
-            _render_gradient_final<pixfmt_t, rasterizer_t, scanline_t, renderer_t, adapted_func_t, vector_t>(ras, scanline, renderer, adaptor, points);
-        }
-        break;
-
-    case Paint::k_GradientSpreadRepeat:
-        {
-            typedef agg::gradient_repeat_adaptor<grad_func_t> adapted_func_t;
-            agg::gradient_repeat_adaptor<grad_func_t> adaptor(func);
-            _render_gradient_final<pixfmt_t, rasterizer_t, scanline_t, renderer_t, adapted_func_t, vector_t>(ras, scanline, renderer, adaptor, points);
-        }
-        break;
-
-    case Paint::k_GradientSpreadPad:
-    default:
-        _render_gradient_final<pixfmt_t, rasterizer_t, scanline_t, renderer_t, grad_func_t, vector_t>(ras, scanline, renderer, func, points);
-        break;
-    }
-}
-
-template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t, typename grad_func_t, typename vector_t>
-void Paint::_render_gradient_final(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, grad_func_t& func, vector_t& points)
-{
-    typedef agg::span_interpolator_linear<> span_interpolator_t;
-    typedef agg::pod_auto_array<typename pixfmt_t::color_type, 256> color_array_t;
-    typedef agg::span_gradient<typename pixfmt_t::color_type, span_interpolator_t, grad_func_t, color_array_t> span_gradient_t;
-    typedef agg::span_allocator<typename pixfmt_t::color_type> span_allocator_t;
-    typedef agg::renderer_scanline_aa<renderer_t, span_allocator_t, span_gradient_t> gradient_renderer_t;
+    typedef GradientSpanSource<pixfmt_t> source_t;
 
     agg::trans_affine gradient_mtx;
-    span_interpolator_t span_interpolator(gradient_mtx);
-    span_allocator_t span_allocator;
-    color_array_t color_array;
     double d1 = 0, d2 = 0;
 
     if (m_type == Paint::k_PaintTypeRadialGradient)
@@ -239,20 +363,71 @@ void Paint::_render_gradient_final(rasterizer_t& ras, scanline_t& scanline, rend
     gradient_mtx *= agg::trans_affine_translation(points[k_GradX], points[k_GradY]);
     if (m_units == Paint::k_GradientUnitsUserSpace)
     {
-        gradient_mtx *= m_transform;
+        gradient_mtx *= mtx;
     }
     gradient_mtx.invert();
 
-    _generate_colors<pixfmt_t, color_array_t>(m_stops, m_master_alpha, color_array);
+    // apply the proper fill adapter based on the spread method
+    switch (m_spread)
+    {
+    case Paint::k_GradientSpreadReflect:
+        params.spread = GradientIndexParams::k_SpreadReflect;
+        break;
+    case Paint::k_GradientSpreadRepeat:
+        params.spread = GradientIndexParams::k_SpreadRepeat;
+        break;
+    case Paint::k_GradientSpreadPad:
+    default:
+        params.spread = GradientIndexParams::k_SpreadPad;
+        break;
+    }
+    params.d1 = agg::iround(d1 * agg::gradient_subpixel_scale);
+    params.d2 = agg::iround(d2 * agg::gradient_subpixel_scale);
 
-    span_gradient_t span_gradient(span_interpolator, func, color_array, d1, d2);
-    gradient_renderer_t grad_renderer(renderer, span_allocator, span_gradient);
-    agg::render_scanlines(ras, scanline, grad_renderer);
+    return new source_t(params, gradient_mtx, _gradient_colors<pixfmt_t>());
 }
 
-template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
-void Paint::_render_pattern(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer)
+template <typename pixfmt_t>
+GradientColors<typename pixfmt_t::color_type> Paint::_gradient_colors()
+{
+    typedef typename pixfmt_t::color_type color_t;
+    typedef typename GradientColors<color_t>::colors_t colors_t;
+    typedef gradient_colors_key<color_t, pixfmt_premultiplied<pixfmt_t>::value> key_t;
+
+    // Sources which are already drawing keep their own reference to the colors
+    std::lock_guard<std::mutex> lock(m_colors_mutex);
+    const unsigned n_stops = m_stops.size();
+    const GradientStop* stops = n_stops ? &m_stops[0] : NULL;
+    const bool stops_changed = m_colors_stops.size() != n_stops ||
+        (n_stops && std::memcmp(&m_colors_stops[0], stops, n_stops * sizeof(GradientStop)) != 0);
+    if (!m_colors || m_colors_key != &key_t::id || m_colors_alpha != m_master_alpha || stops_changed)
+    {
+        std::shared_ptr<colors_t> colors(new colors_t(gradient_lut_size<color_t>::value));
+        _generate_colors<pixfmt_t, colors_t>(m_stops, m_master_alpha, *colors);
+        m_colors = colors;
+        m_colors_key = &key_t::id;
+        m_colors_alpha = m_master_alpha;
+        m_colors_stops.assign(stops, stops + n_stops);
+    }
+    return GradientColors<color_t>(std::static_pointer_cast<const colors_t>(m_colors));
+}
+
+template <typename pixfmt_t>
+PaintSpanSource<typename pixfmt_t::color_type>* Paint::_pattern_source(const agg::trans_affine& mtx)
 {
+    // Minified patterns are sampled from a mip level. Only levels which
+    // evenly divide the image keep the pattern's period.
+    unsigned level = m_image->mip_level(mtx);
+    while (level > 0 && ((m_image->width() | m_image->height()) & ((1u << level) - 1)))
+    {
+        --level;
+    }
+    Image& image = m_image->mip<pixfmt_t>(level);
+
+    agg::trans_affine inv_img_mtx = agg::trans_affine_scaling(double(1 << level));
+    inv_img_mtx *= mtx;
+    inv_img_mtx.invert();
+
     switch (m_pattern_style)
     {
     case k_PatternStyleReflect:
@@ -260,42 +435,34 @@ void Paint::_render_pattern(rasterizer_t& ras, scanline_t& scanline, renderer_t&
             typedef typename image_filters<pixfmt_t>::source_reflect_t source_t;
             typedef typename image_filters<pixfmt_t>::nearest_reflect_t span_gen_t;
 
-            _render_pattern_final<pixfmt_t, rasterizer_t, scanline_t, renderer_t, source_t, span_gen_t>(ras, scanline, renderer);
+            return new PatternSpanSource<pixfmt_t, source_t, span_gen_t>(image, inv_img_mtx, m_master_alpha);
         }
-        break;
 
     case k_PatternStyleRepeat:
         {
             typedef typename image_filters<pixfmt_t>::source_repeat_t source_t;
             typedef typename image_filters<pixfmt_t>::nearest_repeat_t span_gen_t;
 
-            _render_pattern_final<pixfmt_t, rasterizer_t, scanline_t, renderer_t, source_t, span_gen_t>(ras, scanline, renderer);
+            return new PatternSpanSource<pixfmt_t, source_t, span_gen_t>(image, inv_img_mtx, m_master_alpha);
         }
-        break;
 
     default:
-        break;
+        return NULL;
     }
 }
 
-template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t, typename source_t, typename span_gen_t>
-void Paint::_render_pattern_final(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer)
+template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
+void Paint::_render_spans(rasterizer_t& ras, scanline_t& scanline, renderer_t& renderer, PaintSpanSource<typename pixfmt_t::color_type>& source)
 {
-    typedef typename agg::span_allocator<typename pixfmt_t::color_type> span_alloc_t;
-    typedef agg::renderer_scanline_aa<renderer_t, span_alloc_t, span_gen_t> img_renderer_t;
-
-    agg::trans_affine inv_img_mtx = m_transform;
-    inv_img_mtx.invert();
-    interpolator_t interpolator(inv_img_mtx);
+    typedef typename pixfmt_t::color_type color_t;
+    typedef PaintSpanGenerator<color_t> span_gen_t;
+    typedef agg::span_allocator<color_t> span_alloc_t;
+    typedef agg::renderer_scanline_aa<renderer_t, span_alloc_t, span_gen_t> span_renderer_t;
 
+    span_gen_t span_generator(source);
     span_alloc_t span_allocator;
-    pixfmt_t src_pix(m_image->get_buffer());
-    source_t source(src_pix);
-    span_gen_t span_generator(source, interpolator);
-    img_renderer_t pattern_renderer(renderer, span_allocator, span_generator);
-
-    // XXX: Apply master alpha here somehow!
-    agg::render_scanlines(ras, scanline, pattern_renderer);
+    span_renderer_t span_renderer(renderer, span_allocator, span_generator);
+    agg::render_scanlines(ras, scanline, span_renderer);
 }
 
 template <typename pixfmt_t, typename rasterizer_t, typename scanline_t, typename renderer_t>
@@ -304,9 +471,6 @@ void Paint::_render_solid(rasterizer_t& ras, scanline_t& scanline, renderer_t& r
     typedef agg::renderer_scanline_aa_solid<renderer_t> solid_renderer_t;
 
     solid_renderer_t solid_renderer(renderer);
-    const agg::rgba color_with_alpha(m_color, m_master_alpha*m_color.a);
-    typename pixfmt_t::color_type color(color_with_alpha);
-
-    solid_renderer.color(color);
+    solid_renderer.color(solid_color<pixfmt_t>());
     agg::render_scanlines(ras, scanline, solid_renderer);
 }
@@ -183,8 +183,7 @@ cdef class PatternPaint(Paint):
         if self.img_obj.format == fmt:
             return self
 
-        fmt_image = convert_image(self.img_obj, fmt,
-                                  bottom_up=self.img_obj.bottom_up)
+        fmt_image = self.img_obj._with_format(fmt)
         fmt_pattern = PatternPaint(self.style, fmt_image)
         fmt_pattern.transform = self.transform
         return fmt_pattern
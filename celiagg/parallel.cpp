@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "parallel.h"
+
+ThreadPool::ThreadPool(const unsigned size)
+: m_task(0)
+, m_next(0)
+, m_count(0)
+, m_active(0)
+, m_generation(0)
+, m_stop(false)
+{
+    for (unsigned i = 1; i < size; ++i)
+    {
+        m_threads.push_back(std::thread(&ThreadPool::_worker, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i].join();
+    }
+}
+
+unsigned
+ThreadPool::size() const
+{
+    return unsigned(m_threads.size()) + 1;
+}
+
+void
+ThreadPool::run(const unsigned count, const Task& task)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_count = count;
+    m_next = 0;
+    m_error = std::exception_ptr();
+    ++m_generation;
+    lock.unlock();
+    m_wake.notify_all();
+
+    _work(task);
+
+    // Workers which wake up after the task is cleared will find nothing to do
+    lock.lock();
+    m_done.wait(lock, [this] { return m_active == 0; });
+    m_task = 0;
+
+    if (m_error)
+    {
+        std::exception_ptr error = m_error;
+        m_error = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+void
+ThreadPool::_worker()
+{
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        m_wake.wait(lock, [this, seen] { return m_stop || m_generation != seen; });
+        if (m_stop) return;
+
+        seen = m_generation;
+        if (m_task == 0) continue;
+
+        const Task& task = *m_task;
+        ++m_active;
+        lock.unlock();
+
+        _work(task);
+
+        lock.lock();
+        if (--m_active == 0) m_done.notify_all();
+    }
+}
+
+void
+ThreadPool::_work(const Task& task)
+{
+    for (;;)
+    {
+        const unsigned index = m_next++;
+        if (index >= m_count) break;
+
+        try
+        {
+            task(index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error) m_error = std::current_exception();
+        }
+    }
+}
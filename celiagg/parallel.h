@@ -0,0 +1,72 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_PARALLEL_H
+#define CELIAGG_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed-size pool of worker threads. The thread which calls run()
+// also does work, so a pool of size N owns N-1 threads.
+class ThreadPool
+{
+public:
+    typedef std::function<void (unsigned)> Task;
+
+                        ThreadPool(const unsigned size);
+                        ~ThreadPool();
+
+    unsigned            size() const;
+
+    // Call `task` once for each index in [0, count) and wait for all of the
+    // calls to finish. The first exception thrown by a task is rethrown here.
+    void                run(const unsigned count, const Task& task);
+
+private:
+
+    void                _worker();
+    void                _work(const Task& task);
+
+    std::vector<std::thread>    m_threads;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_wake;
+    std::condition_variable     m_done;
+    const Task*                 m_task;
+    std::atomic<unsigned>       m_next;
+    unsigned                    m_count;
+    unsigned                    m_active;
+    unsigned long               m_generation;
+    std::exception_ptr          m_error;
+    bool                        m_stop;
+
+    // Not copyable
+                        ThreadPool(const ThreadPool&);
+    ThreadPool&         operator = (const ThreadPool&);
+};
+
+#endif // CELIAGG_PARALLEL_H
@@ -0,0 +1,92 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "picture.h"
+
+Picture::Picture()
+{}
+
+void
+Picture::add_image(Image& img, const agg::trans_affine& transform,
+                   const GraphicsState& gs)
+{
+    Command& cmd = _add(k_CommandImage, transform, gs);
+    cmd.image = &img;
+}
+
+void
+Picture::add_shape(VertexSource& shape, const agg::trans_affine& transform,
+                   Paint& linePaint, Paint& fillPaint, const GraphicsState& gs)
+{
+    Command& cmd = _add(k_CommandShape, transform, gs);
+    cmd.shape = &shape;
+    cmd.line_paint = &linePaint;
+    cmd.fill_paint = &fillPaint;
+}
+
+void
+Picture::add_text(const char* text, Font& font,
+                  const agg::trans_affine& transform,
+                  Paint& linePaint, Paint& fillPaint, const GraphicsState& gs)
+{
+    Command& cmd = _add(k_CommandText, transform, gs);
+    cmd.text = text;
+    cmd.font = &font;
+    cmd.line_paint = &linePaint;
+    cmd.fill_paint = &fillPaint;
+}
+
+void
+Picture::clear()
+{
+    m_commands.clear();
+}
+
+size_t
+Picture::size() const
+{
+    return m_commands.size();
+}
+
+const Picture::Command&
+Picture::command(const size_t index) const
+{
+    return m_commands[index];
+}
+
+Picture::Command&
+Picture::_add(const CommandType type, const agg::trans_affine& transform,
+              const GraphicsState& gs)
+{
+    Command cmd;
+    cmd.type = type;
+    cmd.shape = 0;
+    cmd.font = 0;
+    cmd.image = 0;
+    cmd.transform = transform;
+    cmd.line_paint = 0;
+    cmd.fill_paint = 0;
+    cmd.state = &gs;
+
+    m_commands.push_back(cmd);
+    return m_commands.back();
+}
@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_PICTURE_H
+#define CELIAGG_PICTURE_H
+
+#include <string>
+#include <vector>
+
+#include <agg_trans_affine.h>
+
+#include "font.h"
+#include "graphics_state.h"
+#include "image.h"
+#include "paint.h"
+#include "vertex_source.h"
+
+// A recorded list of drawing commands which can be replayed onto a canvas
+// with ndarray_canvas_base::draw_picture(). Shapes, fonts, images, paints and
+// states are held by pointer and must outlive the picture. Transforms and
+// text are copied.
+class Picture
+{
+public:
+    enum CommandType
+    {
+        k_CommandShape = 0,
+        k_CommandText,
+        k_CommandImage
+    };
+
+    struct Command
+    {
+        CommandType             type;
+        VertexSource*           shape;
+        Font*                   font;
+        Image*                  image;
+        std::string             text;
+        agg::trans_affine       transform;
+        Paint*                  line_paint;
+        Paint*                  fill_paint;
+        const GraphicsState*    state;
+    };
+
+                    Picture();
+
+    void            add_image(Image& img,
+                              const agg::trans_affine& transform,
+                              const GraphicsState& gs);
+    void            add_shape(VertexSource& shape,
+                              const agg::trans_affine& transform,
+                              Paint& linePaint, Paint& fillPaint,
+                              const GraphicsState& gs);
+    void            add_text(const char* text, Font& font,
+                             const agg::trans_affine& transform,
+                             Paint& linePaint, Paint& fillPaint,
+                             const GraphicsState& gs);
+
+    void            clear();
+    size_t          size() const;
+    const Command&  command(const size_t index) const;
+
+private:
+
+    Command&        _add(const CommandType type,
+                         const agg::trans_affine& transform,
+                         const GraphicsState& gs);
+
+    std::vector<Command>    m_commands;
+
+    // Not copyable
+                    Picture(const Picture&);
+    Picture&        operator = (const Picture&);
+};
+
+#endif // CELIAGG_PICTURE_H
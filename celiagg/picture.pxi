@@ -0,0 +1,229 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+cdef enum _PictureCommand:
+    _PICTURE_SHAPE
+    _PICTURE_TEXT
+    _PICTURE_IMAGE
+
+
+@cython.internal
+cdef class _NativePicture:
+    """Internal. A recorded command list, with every paint and image converted
+    to a single pixel format.
+    """
+    cdef _picture.Picture* _this
+    cdef list _objects
+
+    def __cinit__(self):
+        self._this = new _picture.Picture()
+        self._objects = []
+
+    def __dealloc__(self):
+        del self._this
+
+
+cdef class Picture:
+    """Picture()
+    A list of drawing commands which can be drawn on any canvas with a single
+    call to ``draw_picture``.
+
+    A ``Picture`` has the same ``draw_image``, ``draw_shape`` and ``draw_text``
+    methods as a canvas, but it records the calls instead of drawing them.
+    Shapes, paints, states, fonts and images are kept by reference, so any
+    changes made to them later will be seen the next time the picture is
+    drawn. As when drawing directly, images in another pixel format than the
+    canvas's need ``Image.invalidate()`` after their pixels change in place.
+    Transforms and text are copied.
+
+    When a picture is drawn, commands which fall completely outside of the
+    canvas or the clip box are skipped, and consecutive fills of the same
+    solid color with the same state are drawn together when they don't
+    overlap.
+    """
+    cdef list _commands
+    cdef dict _native
+
+    def __cinit__(self):
+        self._commands = []
+        self._native = {}
+
+    def __len__(self):
+        return len(self._commands)
+
+    def clear(self):
+        """clear()
+        Remove all of the recorded commands.
+        """
+        self._commands = []
+        self._native = {}
+
+    def draw_image(self, image, fmt, transform, state, bottom_up=False):
+        """draw_image(image, format, transform, state, bottom_up=False)
+        Record an image drawing command.
+
+        :param image: A 2D or 3D numpy array containing image data
+        :param format: A ``PixelFormat`` describing the array's data
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param bottom_up: If True, the image data is flipped in the y axis
+        """
+        if not isinstance(image, (numpy.ndarray, Image)):
+            raise TypeError("image must be an ndarray or Image instance")
+        if not isinstance(fmt, PixelFormat) and isinstance(image, numpy.ndarray):
+            raise TypeError("format must be a PixelFormat value")
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+
+        if not isinstance(image, Image):
+            image = Image(image, fmt, bottom_up=bottom_up)
+
+        self._record((_PICTURE_IMAGE, image, transform.copy(), state))
+
+    def draw_shape(self, shape, transform, state, stroke=None, fill=None):
+        """draw_shape(shape, transform, state, stroke=SolidColor(0, 0, 0), fill=SolidColor(0, 0, 0))
+        Record a shape drawing command.
+
+        :param shape: A ``VertexSource`` object
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param stroke: The ``Paint`` to use for outlines. Defaults to black.
+        :param fill: The ``Paint`` to use for fills. Defaults to black.
+        """
+        if not isinstance(shape, VertexSource):
+            raise TypeError("shape must be a VertexSource (Path, BSpline, etc)")
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+        if stroke is not None and not isinstance(stroke, Paint):
+            raise TypeError("stroke must be a Paint instance")
+        if fill is not None and not isinstance(fill, Paint):
+            raise TypeError("fill must be a Paint instance")
+
+        self._record((_PICTURE_SHAPE, shape, transform.copy(), state,
+                      stroke, fill))
+
+    def draw_text(self, text, font, transform, state, stroke=None, fill=None):
+        """draw_text(text, font, transform, state, stroke=SolidColor(0, 0, 0), fill=SolidColor(0, 0, 0))
+        Record a text drawing command.
+
+        :param text: A Unicode string of text to be renderered. Newlines will
+                     be ignored.
+        :param font: A ``Font`` object
+        :param transform: A ``Transform`` object
+        :param state: A ``GraphicsState`` object
+        :param stroke: The ``Paint`` to use for outlines. Defaults to black.
+        :param fill: The ``Paint`` to use for fills. Defaults to black.
+        """
+        if not _text_support._has_text_rendering():
+            msg = ("The celiagg library was compiled without font support!  "
+                   "If you would like to render text, you will need to "
+                   "reinstall the library.")
+            raise RuntimeError(msg)
+
+        if not isinstance(font, FontBase):
+            raise TypeError("font must be a Font instance")
+        if not isinstance(transform, Transform):
+            raise TypeError("transform must be a Transform instance")
+        if not isinstance(state, GraphicsState):
+            raise TypeError("state must be a GraphicsState instance")
+        if stroke is not None and not isinstance(stroke, Paint):
+            raise TypeError("stroke must be a Paint instance")
+        if fill is not None and not isinstance(fill, Paint):
+            raise TypeError("fill must be a Paint instance")
+
+        text = _get_utf8_text(text, "The text argument must be unicode.")
+        self._record((_PICTURE_TEXT, text, font, transform.copy(),
+                      state, stroke, fill))
+
+    cdef _record(self, tuple command):
+        """Internal. Adds a command and drops any compiled command lists.
+        """
+        self._commands.append(command)
+        self._native = {}
+
+    cdef _NativePicture _compile(self, CanvasBase canvas):
+        """Internal. Returns the command list for the pixel format of
+        ``canvas``. The list is built the first time that it's needed, and
+        again on every later draw when it holds images or paints converted to
+        another pixel format, since those are copies of the recorded objects.
+        """
+        cdef:
+            PixelFormat fmt = canvas.pixel_format
+            _NativePicture native = self._native.get(fmt)
+            VertexSource shp
+            FontBase fnt
+            Transform trans
+            GraphicsState gs
+            Image img
+            Paint stroke_paint
+            Paint fill_paint
+            bool converted = False
+
+        if native is not None:
+            return native
+
+        native = _NativePicture()
+        for command in self._commands:
+            kind = command[0]
+            if kind == _PICTURE_IMAGE:
+                img = canvas._get_native_image(command[1], fmt)
+                converted = converted or img is not command[1]
+                trans = command[2]
+                gs = command[3]
+                native._objects.append(img)
+                native._this.add_image(dereference(img._this),
+                                       dereference(trans._this),
+                                       dereference(gs._this))
+                continue
+
+            stroke_paint = canvas._get_native_paint(command[-2], fmt)
+            fill_paint = canvas._get_native_paint(command[-1], fmt)
+            for paint, native_paint in zip(command[-2:], (stroke_paint, fill_paint)):
+                if paint is not None and native_paint is not paint:
+                    converted = True
+            native._objects.extend((stroke_paint, fill_paint))
+            if kind == _PICTURE_SHAPE:
+                shp = command[1]
+                trans = command[2]
+                gs = command[3]
+                native._this.add_shape(dereference(shp._this),
+                                       dereference(trans._this),
+                                       dereference(stroke_paint._this),
+                                       dereference(fill_paint._this),
+                                       dereference(gs._this))
+            else:
+                fnt = command[2]
+                trans = command[3]
+                gs = command[4]
+                native._this.add_text(command[1], dereference(fnt._this),
+                                      dereference(trans._this),
+                                      dereference(stroke_paint._this),
+                                      dereference(fill_paint._this),
+                                      dereference(gs._this))
+
+        if not converted:
+            self._native[fmt] = native
+        return native
@@ -0,0 +1,190 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_POINT_TEMPLATES_H
+#define CELIAGG_POINT_TEMPLATES_H
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <agg_basics.h>
+#include <agg_renderer_scanline.h>
+#include <agg_scanline_p.h>
+#include <agg_scanline_storage_aa.h>
+#include <agg_trans_affine.h>
+
+#include "graphics_state.h"
+#include "rasterize.h"
+#include "scanline_band.h"
+
+// Draws a shape at many points from coverage which is rasterized once for
+// each sub-pixel offset the points land on. This is the shared part of the
+// canvases' draw_shape_at_points().
+struct PointTemplates
+{
+    typedef agg::scanline_storage_aa8 storage_t;
+    typedef ScanlineBand<storage_t> band_t;
+
+    // Points are snapped to 1/k_Subpixels of a pixel. Offsets outside of
+    // +/- k_OffsetLimit can't be rasterized anyway.
+    enum { k_Subpixels = 4 };
+    enum { k_OffsetLimit = 1 << 23 };
+
+    // Stored coverage is clipped to whole pixels when it is drawn, so a clip
+    // box with fractional edges needs every point to be rasterized instead.
+    static bool clip_supported(const GraphicsState::Rect& clip)
+    {
+        return !clip.is_valid() ||
+               (std::floor(clip.x1) == clip.x1 && std::floor(clip.y1) == clip.y1 &&
+                std::floor(clip.x2) == clip.x2 && std::floor(clip.y2) == clip.y2);
+    }
+
+    // Sets `box` to the pixels of a `width` by `height` canvas inside of a
+    // whole pixel clip box, inclusive. False if there are none.
+    static bool visible_box(const GraphicsState::Rect& clip,
+                            const unsigned width, const unsigned height,
+                            int* box)
+    {
+        box[0] = 0; box[1] = 0;
+        box[2] = int(width) - 1; box[3] = int(height) - 1;
+        if (clip.is_valid())
+        {
+            box[0] = int(std::max(clip.x1, double(box[0])));
+            box[1] = int(std::max(clip.y1, double(box[1])));
+            box[2] = int(std::min(clip.x2 - 1.0, double(box[2])));
+            box[3] = int(std::min(clip.y2 - 1.0, double(box[3])));
+        }
+        return box[0] <= box[2] && box[1] <= box[3];
+    }
+
+    // Draws the fill and/or the stroke of a shape at every point. The first
+    // time an offset needs one of them, rasterize(stroke, mtx) adds it to
+    // `ras` under `mtx`. Then render(i, stroke, band) draws it for point `i`
+    // from the stored coverage, if that reaches the visible `box`.
+    template<typename rasterizer_t, typename rasterize_t, typename render_t>
+    static void draw(rasterizer_t& ras, const double* points,
+                     const size_t point_count,
+                     const agg::trans_affine& transform, const int* box,
+                     const bool anti_aliased, const bool fill, const bool line,
+                     rasterize_t rasterize, render_t render)
+    {
+        const int subpixels = k_Subpixels;
+
+        // Translating a shape by a point in user space moves it by the linear
+        // part of the transform applied to that point in device space. Split
+        // each of those offsets into whole pixels and a sub-pixel bucket.
+        std::vector<int> offsets(point_count * 2);
+        std::vector<bool> valid(point_count, false);
+        int min_nx = k_OffsetLimit, min_ny = k_OffsetLimit;
+        int max_nx = -k_OffsetLimit, max_ny = -k_OffsetLimit;
+        for (size_t i = 0; i < point_count; ++i)
+        {
+            const double px = points[i*2], py = points[i*2+1];
+            const double dx = px * transform.sx + py * transform.shx;
+            const double dy = px * transform.shy + py * transform.sy;
+            if (!(std::fabs(dx) < k_OffsetLimit && std::fabs(dy) < k_OffsetLimit)) continue;
+
+            const int qx = agg::iround(dx * subpixels);
+            const int qy = agg::iround(dy * subpixels);
+            const int nx = int(std::floor(double(qx) / subpixels));
+            const int ny = int(std::floor(double(qy) / subpixels));
+
+            offsets[i*2] = qx;
+            offsets[i*2+1] = qy;
+            valid[i] = true;
+            min_nx = std::min(min_nx, nx); max_nx = std::max(max_nx, nx);
+            min_ny = std::min(min_ny, ny); max_ny = std::max(max_ny, ny);
+        }
+        if (min_nx > max_nx) return;
+
+        // Only the part of a template which lands on a visible pixel for some
+        // point needs to be stored. The margin keeps the rasterizer's clipping
+        // artifacts away from any pixel which is drawn.
+        const int margin = 2;
+        ras.clip_box(box[0] - max_nx - margin, box[1] - max_ny - margin,
+                     box[2] + 1 - min_nx + margin, box[3] + 1 - min_ny + margin);
+        rasterizer_aa(ras, anti_aliased);
+
+        // The fill and the stroke of each offset are stored apart
+        agg::scanline_p8 scanline;
+        std::vector<std::unique_ptr<Template> > templates(subpixels * subpixels * 2);
+        for (size_t i = 0; i < point_count; ++i)
+        {
+            if (!valid[i]) continue;
+
+            const int qx = offsets[i*2], qy = offsets[i*2+1];
+            const int nx = int(std::floor(double(qx) / subpixels));
+            const int ny = int(std::floor(double(qy) / subpixels));
+            const int bx = qx - nx * subpixels, by = qy - ny * subpixels;
+
+            for (int part = 0; part < 2; ++part)
+            {
+                const bool stroke = part == 1;
+                if (!(stroke ? line : fill)) continue;
+
+                // Rasterize the shape the first time its sub-pixel offset is seen
+                std::unique_ptr<Template>& tmpl = templates[(by * subpixels + bx) * 2 + part];
+                if (!tmpl)
+                {
+                    const agg::trans_affine mtx = transform *
+                        agg::trans_affine_translation(double(bx) / subpixels, double(by) / subpixels);
+
+                    tmpl.reset(new Template);
+                    tmpl->rows = 0;
+                    rasterize(stroke, mtx);
+                    if (ras.rewind_scanlines())
+                    {
+                        tmpl->box[0] = ras.min_x(); tmpl->box[1] = ras.min_y();
+                        tmpl->box[2] = ras.max_x(); tmpl->box[3] = ras.max_y();
+                        agg::render_scanlines(ras, scanline, tmpl->storage);
+                        tmpl->rows = scanline_storage_rows(tmpl->storage);
+                    }
+                }
+
+                const int* tbox = tmpl->box;
+                if (tmpl->rows == 0 ||
+                    tbox[0] + nx > box[2] || tbox[2] + nx < box[0] ||
+                    tbox[1] + ny > box[3] || tbox[3] + ny < box[1])
+                {
+                    continue;
+                }
+
+                band_t band(tmpl->storage, 0, tmpl->rows,
+                            tbox[0], tbox[1], tbox[2], tbox[3], nx, ny);
+                render(i, stroke, band);
+            }
+        }
+    }
+
+private:
+    // Coverage of a fill or stroke at one sub-pixel offset
+    struct Template
+    {
+        storage_t storage;
+        int box[4];
+        unsigned rows;
+    };
+};
+
+#endif // CELIAGG_POINT_TEMPLATES_H
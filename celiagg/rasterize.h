@@ -0,0 +1,198 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_RASTERIZE_H
+#define CELIAGG_RASTERIZE_H
+
+#include <agg_conv_clip_polygon.h>
+#include <agg_conv_clip_polyline.h>
+#include <agg_conv_contour.h>
+#include <agg_conv_dash.h>
+#include <agg_conv_stroke.h>
+#include <agg_conv_transform.h>
+#include <agg_gamma_functions.h>
+#include <agg_trans_affine.h>
+
+#include "graphics_state.h"
+#include "vertex_source.h"
+
+// Turns the fills and strokes of shapes into coverage in a rasterizer, the
+// same way for every kind of canvas. `clip` is an optional x1, y1, x2, y2 box
+// which the geometry is cut down to before it's rasterized.
+
+template<typename rasterizer_t>
+void rasterizer_aa(rasterizer_t& ras, const bool aa)
+{
+    if (aa)
+    {
+        ras.gamma(agg::gamma_linear());
+    }
+    else
+    {
+        ras.gamma(agg::gamma_threshold(0.5));
+    }
+}
+
+// Adds the fill of `shape` to `ras` without resetting it
+template<typename rasterizer_t>
+void add_fill_path(rasterizer_t& ras, VertexSource& shape,
+                   const agg::trans_affine& transform,
+                   const double* clip = NULL)
+{
+    typedef agg::conv_transform<VertexSource> conv_trans_t;
+    typedef agg::conv_contour<conv_trans_t> contour_shape_t;
+    typedef agg::conv_clip_polygon<contour_shape_t> clip_contour_t;
+
+    agg::trans_affine mtx = transform;
+    conv_trans_t trans_shape(shape, mtx);
+    contour_shape_t contour(trans_shape);
+    contour.auto_detect_orientation(true);
+
+    // The contour is clipped rather than the shape, so that polygons which
+    // the contour generator ignores stay ignored.
+    if (clip == NULL)
+    {
+        ras.add_path(contour);
+    }
+    else
+    {
+        clip_contour_t clipped(contour);
+        clipped.clip_box(clip[0], clip[1], clip[2], clip[3]);
+        ras.add_path(clipped);
+    }
+}
+
+template<typename rasterizer_t>
+void rasterize_fill(rasterizer_t& ras, VertexSource& shape,
+                    const agg::trans_affine& transform,
+                    const GraphicsState& gs, const double* clip = NULL)
+{
+    const bool eof = (gs.drawing_mode() & GraphicsState::DrawEofFill) == GraphicsState::DrawEofFill;
+
+    ras.reset();
+    add_fill_path(ras, shape, transform, clip);
+    ras.filling_rule(eof ? agg::fill_even_odd : agg::fill_non_zero);
+}
+
+// Rasterizes the fill of `shape` without the contour which canvases add to
+// it, so that the coverage adds up to the area of the shape.
+template<typename rasterizer_t>
+void rasterize_exact_fill(rasterizer_t& ras, VertexSource& shape,
+                          const agg::trans_affine& transform,
+                          const GraphicsState& gs)
+{
+    typedef agg::conv_transform<VertexSource> conv_trans_t;
+
+    const bool eof = (gs.drawing_mode() & GraphicsState::DrawEofFill) == GraphicsState::DrawEofFill;
+
+    agg::trans_affine mtx = transform;
+    conv_trans_t trans_shape(shape, mtx);
+
+    ras.reset();
+    ras.add_path(trans_shape);
+    ras.filling_rule(eof ? agg::fill_even_odd : agg::fill_non_zero);
+}
+
+template<typename rasterizer_t, typename stroke_t>
+void _rasterize_stroke_final(rasterizer_t& ras, stroke_t& stroke,
+                             const agg::trans_affine& mtx,
+                             const GraphicsState& gs)
+{
+    typedef agg::conv_transform<stroke_t> trans_stroke_t;
+
+    stroke.width(gs.line_width());
+    stroke.miter_limit(gs.miter_limit());
+    stroke.inner_miter_limit(gs.inner_miter_limit());
+    stroke.line_cap(agg::line_cap_e(gs.line_cap()));
+    stroke.line_join(agg::line_join_e(gs.line_join()));
+    stroke.inner_join(agg::inner_join_e(gs.inner_join()));
+
+    agg::trans_affine src_mtx = mtx;
+    trans_stroke_t trans(stroke, src_mtx);
+
+    ras.reset();
+    ras.add_path(trans);
+}
+
+// Rasterizes the stroke of `shape`, with the dashes and line style of `gs`.
+// The clip box is in user space here.
+template<typename rasterizer_t>
+void rasterize_stroke(rasterizer_t& ras, VertexSource& shape,
+                      const agg::trans_affine& mtx, const GraphicsState& gs,
+                      const double* clip = NULL)
+{
+    typedef agg::conv_dash<VertexSource> dash_t;
+    typedef agg::conv_stroke<dash_t> dash_stroke_t;
+    typedef agg::conv_stroke<VertexSource> stroke_t;
+    typedef agg::conv_clip_polyline<dash_t> clip_dash_t;
+    typedef agg::conv_stroke<clip_dash_t> clip_dash_stroke_t;
+    typedef agg::conv_clip_polyline<VertexSource> clip_shape_t;
+    typedef agg::conv_stroke<clip_shape_t> clip_stroke_t;
+
+    if (gs.line_dash_pattern().size() > 0)
+    {
+        typedef GraphicsState::DashPattern::size_type counter_t;
+
+        dash_t dash(shape);
+        const GraphicsState::DashPattern& dashPattern = gs.line_dash_pattern();
+
+        for (counter_t i=0; i < dashPattern.size(); i+=2)
+            dash.add_dash(dashPattern[i], dashPattern[i+1]);
+        dash.dash_start(0.0);
+
+        // Dashes are clipped after dashing, so that they keep their phase
+        if (clip == NULL)
+        {
+            dash_stroke_t stroke(dash);
+            _rasterize_stroke_final(ras, stroke, mtx, gs);
+        }
+        else
+        {
+            clip_dash_t clipped(dash);
+            clipped.clip_box(clip[0], clip[1], clip[2], clip[3]);
+            clip_dash_stroke_t stroke(clipped);
+            _rasterize_stroke_final(ras, stroke, mtx, gs);
+        }
+    }
+    else
+    {
+        // Dashes depend on the length of the line, so only undashed lines
+        // are decimated.
+        DecimatedSource decimated(shape, mtx);
+        VertexSource& source = gs.decimate_lines() ? decimated : shape;
+
+        if (clip == NULL)
+        {
+            stroke_t stroke(source);
+            _rasterize_stroke_final(ras, stroke, mtx, gs);
+        }
+        else
+        {
+            clip_shape_t clipped(source);
+            clipped.clip_box(clip[0], clip[1], clip[2], clip[3]);
+            clip_stroke_t stroke(clipped);
+            _rasterize_stroke_final(ras, stroke, mtx, gs);
+        }
+    }
+}
+
+#endif // CELIAGG_RASTERIZE_H
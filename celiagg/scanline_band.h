@@ -0,0 +1,124 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2016-2021 Celiagg Contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CELIAGG_SCANLINE_BAND_H
+#define CELIAGG_SCANLINE_BAND_H
+
+// A horizontal band of the scanlines held by an agg::scanline_storage_aa,
+// optionally shifted by a whole number of pixels. It implements the
+// rasterizer interface used by agg::render_scanlines, so stored coverage can
+// be handed to a Paint. The storage itself is only read, so any number of
+// bands can be swept at once by different threads.
+//
+// Storage filled from an agg::scanline_p8 keeps solid runs compact. Sweeping
+// it into an agg::scanline_u8 merges the runs back together, which gives the
+// same spans as sweeping the rasterizer into a scanline_u8 directly.
+//
+// The bounding box is supplied by the caller so that it matches the
+// rasterizer which filled the storage, regardless of which band is drawn.
+template<typename storage_t>
+class ScanlineBand
+{
+public:
+    ScanlineBand(const storage_t& storage,
+                 const unsigned first, const unsigned last,
+                 const int min_x, const int min_y,
+                 const int max_x, const int max_y,
+                 const int dx = 0, const int dy = 0)
+    : m_storage(storage)
+    , m_first(first)
+    , m_last(last)
+    , m_current(first)
+    , m_min_x(min_x + dx)
+    , m_min_y(min_y + dy)
+    , m_max_x(max_x + dx)
+    , m_max_y(max_y + dy)
+    , m_dx(dx)
+    , m_dy(dy)
+    {}
+
+    int min_x() const { return m_min_x; }
+    int min_y() const { return m_min_y; }
+    int max_x() const { return m_max_x; }
+    int max_y() const { return m_max_y; }
+
+    bool rewind_scanlines()
+    {
+        m_current = m_first;
+        return m_current < m_last;
+    }
+
+    template<typename scanline_t>
+    bool sweep_scanline(scanline_t& sl)
+    {
+        sl.reset_spans();
+        for (;;)
+        {
+            if (m_current >= m_last) return false;
+
+            const typename storage_t::scanline_data& line =
+                m_storage.scanline_by_index(m_current++);
+            unsigned span_idx = line.start_span;
+            for (unsigned i = 0; i < line.num_spans; ++i)
+            {
+                const typename storage_t::span_data& sp = m_storage.span_by_index(span_idx++);
+                if (sp.len < 0)
+                {
+                    sl.add_span(sp.x + m_dx, unsigned(-sp.len), *m_storage.covers_by_index(sp.covers_id));
+                }
+                else
+                {
+                    sl.add_cells(sp.x + m_dx, sp.len, m_storage.covers_by_index(sp.covers_id));
+                }
+            }
+            if (sl.num_spans())
+            {
+                sl.finalize(line.y + m_dy);
+                return true;
+            }
+        }
+    }
+
+private:
+    const storage_t&    m_storage;
+    unsigned            m_first;
+    unsigned            m_last;
+    unsigned            m_current;
+    int                 m_min_x;
+    int                 m_min_y;
+    int                 m_max_x;
+    int                 m_max_y;
+    int                 m_dx;
+    int                 m_dy;
+};
+
+// The number of scanlines held by an agg::scanline_storage_aa. Stored
+// scanlines are never empty, and out of range indices give an empty one.
+template<typename storage_t>
+unsigned scanline_storage_rows(const storage_t& storage)
+{
+    unsigned count = 0;
+    while (storage.scanline_by_index(count).num_spans > 0) ++count;
+    return count;
+}
+
+#endif // CELIAGG_SCANLINE_BAND_H
@@ -85,14 +85,20 @@ class TestCanvas(unittest.TestCase):
                 canvas.draw_text(text, font, transform, gs)
 
     def test_stencil_size_mismatch(self):
+        # Nothing is drawn outside of a stencil smaller than the canvas
         canvas = agg.CanvasRGB24(np.zeros((4, 5, 3), dtype=np.uint8))
-        stencil_canvas = agg.CanvasG8(np.zeros((1, 2), dtype=np.uint8))
-        gs = agg.GraphicsState(stencil=stencil_canvas.image)
+        stencil_canvas = agg.CanvasG8(np.full((1, 2), 255, dtype=np.uint8))
+        gs = agg.GraphicsState(stencil=stencil_canvas.image,
+                               drawing_mode=agg.DrawingMode.DrawFill)
         path = agg.Path()
+        path.rect(0, 0, 5, 4)
         transform = agg.Transform()
+        paint = agg.SolidPaint(1, 1, 1)
 
-        with self.assertRaises(agg.AggError):
-            canvas.draw_shape(path, transform, gs)
+        canvas.draw_shape(path, transform, gs, fill=paint)
+        expected = np.zeros((4, 5, 3), dtype=np.uint8)
+        expected[:1, :2] = 255
+        assert_equal(expected, canvas.array)
 
     def test_rasterizer_cell_overflow(self):
         canvas = agg.CanvasRGB24(np.zeros((100, 100, 3), dtype=np.uint8))
@@ -30,6 +30,100 @@ from numpy.testing import assert_equal
 import celiagg as agg
 
 
+def _iround(value):
+    return int(value - 0.5) if value < 0 else int(value + 0.5)
+
+
+def _dda_steps(v1, v2, count):
+    # agg::dda2_line_interpolator, with C division and remainder
+    lft = abs(v2 - v1) // count * (1 if v2 >= v1 else -1)
+    rem = (v2 - v1) - lft * count
+    mod = rem
+    if mod <= 0:
+        mod += count
+        rem += count
+        lft -= 1
+    mod -= count
+
+    steps = []
+    value = v1
+    for _ in range(count):
+        steps.append(value)
+        mod += rem
+        value += lft
+        if mod > 0:
+            mod -= count
+            value += 1
+    return steps
+
+
+def _gradient_reference(kind, points, spread, transform, x, width, height):
+    """ Computes the color table indices of a gradient drawn in spans from `x`
+    to `x + width` in each row, the same way as agg::span_gradient with
+    agg::span_interpolator_linear.
+    `transform` must be exactly invertible in doubles and linear gradients
+    must be horizontal or vertical, so that the gradient matrix is exact.
+    """
+    sx, shy, shx, sy, tx, ty = transform
+    gx, gy = points[:2]
+    tx, ty = gx * sx + gy * shx + tx, gx * shy + gy * sy + ty
+
+    # agg::trans_affine::invert()
+    d = 1.0 / (sx * sy - shy * shx)
+    sx, sy, shy, shx = sy * d, sx * d, -shy * d, -shx * d
+    tx, ty = -tx * sx - ty * shx, -tx * shy - ty * sy
+
+    size = 256
+    if kind == 'radial':
+        r = _iround(points[2] * 16)
+        fx = _iround((points[3] - points[0]) * 16)
+        fy = _iround((points[4] - points[1]) * 16)
+        r2 = float(r) * r
+        dd = r2 - (float(fx) * fx + float(fy) * fy)
+        if dd == 0:
+            fx -= (fx > 0) - (fx < 0)
+            fy -= (fy > 0) - (fy < 0)
+            dd = r2 - (float(fx) * fx + float(fy) * fy)
+        mul = r / dd
+        d2 = r
+
+        def position(x, y):
+            dx, dy = float(x - fx), float(y - fy)
+            dist = dx * fy - dy * fx
+            d3 = r2 * (dx * dx + dy * dy) - dist * dist
+            return _iround((dx * fx + dy * fy + np.sqrt(abs(d3))) * mul)
+    else:
+        vertical = points[0] == points[2]
+        d2 = _iround(abs(points[3] - points[1] if vertical
+                         else points[2] - points[0]) * 16)
+
+        def position(x, y):
+            return y if vertical else x
+
+    indices = np.empty((height, width), dtype=int)
+    for row in range(height):
+        ends = []
+        for end_x in (x + 0.5, x + 0.5 + width):
+            end_y = row + 0.5
+            ends.append((_iround((end_x * sx + end_y * shx + tx) * 256),
+                         _iround((end_x * shy + end_y * sy + ty) * 256)))
+        xs = _dda_steps(ends[0][0], ends[1][0], width)
+        ys = _dda_steps(ends[0][1], ends[1][1], width)
+        for col in range(width):
+            pos = position(xs[col] >> 4, ys[col] >> 4)
+            if spread == agg.GradientSpread.SpreadRepeat:
+                pos %= d2
+            elif spread == agg.GradientSpread.SpreadReflect:
+                pos %= 2 * d2
+                if pos >= d2:
+                    pos = 2 * d2 - pos
+            index = abs(pos * size) // max(d2, 1)
+            if pos < 0:
+                index = -index
+            indices[row, col] = min(max(index, 0), size - 1)
+    return indices
+
+
 class TestDrawing(unittest.TestCase):
     def setUp(self):
         buffer = np.zeros((5, 5), dtype=np.uint8)
@@ -148,3 +242,1094 @@ class TestDrawing(unittest.TestCase):
             path, points, self.transform, self.state, stroke=self.paint
         )
         assert_equal(expected, self.canvas.array)
+
+    def test_draw_shape_at_points_matches_draw_shape(self):
+        # Points on a quarter pixel grid are drawn from cached coverage at
+        # exactly the same place as the shape drawn on its own.
+        shape = agg.Path()
+        shape.ellipse(0, 0, 3.3, 2.1)
+        points = np.random.RandomState(42).uniform(-5, 45, size=(200, 2))
+        points = np.round(points * 4) / 4
+        transform = agg.Transform()
+        transform.translate(0.3, 0.6)
+        fill = agg.RadialGradientPaint(
+            0.5, 0.5, 0.5, 0.5, 0.5,
+            [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 0.0, 1.0, 0.5)],
+            agg.GradientSpread.SpreadPad, agg.GradientUnits.ObjectBoundingBox,
+        )
+        stroke = agg.SolidPaint(0.0, 1.0, 0.0, 0.5)
+
+        for clip_box in (None, agg.Rect(5, 7, 20, 25)):
+            state = agg.GraphicsState(
+                drawing_mode=agg.DrawingMode.DrawFillStroke, line_width=1.5,
+            )
+            if clip_box is not None:
+                state.clip_box = clip_box
+
+            expected = agg.CanvasRGBA32(np.zeros((40, 40, 4), dtype=np.uint8))
+            for x, y in points:
+                pt_transform = transform.copy()
+                pt_transform.translate(x, y)
+                expected.draw_shape(shape, pt_transform, state,
+                                    stroke=stroke, fill=fill)
+
+            actual = agg.CanvasRGBA32(np.zeros((40, 40, 4), dtype=np.uint8))
+            actual.draw_shape_at_points(shape, points, transform, state,
+                                        stroke=stroke, fill=fill)
+            if clip_box is None:
+                assert_equal(expected.array, actual.array)
+            else:
+                # The rasterizer's clipping rounds slightly differently in
+                # the pixels along the edges of the clip box.
+                diff = np.abs(expected.array.astype(int) - actual.array)
+                self.assertLessEqual(diff.max(), 1)
+
+    def test_draw_shapes_compound(self):
+        # Shapes sharing an edge in the middle of a pixel leave no seam
+        left = agg.Path()
+        left.rect(0, 0, 2.5, 5)
+        right = agg.Path()
+        right.rect(2.5, 0, 2.5, 5)
+        white = agg.SolidPaint(1, 1, 1)
+        self.canvas.draw_shapes_compound(
+            [left, right], [white, white], self.transform, agg.GraphicsState()
+        )
+        assert_equal(np.full((5, 5), 255), self.canvas.array)
+
+    def test_draw_shapes_compound_styles(self):
+        canvas = agg.CanvasRGB24(np.zeros((5, 5, 3), dtype=np.uint8))
+        state = agg.GraphicsState()
+        paints = [agg.SolidPaint(1, 0, 0), agg.SolidPaint(0, 0, 1)]
+        back = agg.Path()
+        back.rect(0, 0, 5, 5)
+        # Drawn counterclockwise to check that orientation doesn't matter
+        front = agg.Path()
+        front.move_to(1, 1)
+        front.line_to(1, 4)
+        front.line_to(4, 4)
+        front.line_to(4, 1)
+        red, blue = [255, 0, 0], [0, 0, 255]
+
+        # The shape with the higher paint index is on top
+        for shapes, styles in (([back, front], [0, 1]),
+                               ([front, back], [1, 0])):
+            canvas.clear(0, 0, 0)
+            canvas.draw_shapes_compound(shapes, paints, self.transform, state,
+                                        styles=styles)
+            expected = np.empty((5, 5, 3), dtype=np.uint8)
+            expected[...] = red
+            expected[1:4, 1:4] = blue
+            assert_equal(expected, canvas.array)
+
+        canvas.clear(0, 0, 0)
+        canvas.draw_shapes_compound([back, front], paints, self.transform,
+                                    state, styles=[1, 0])
+        assert_equal(np.broadcast_to(blue, (5, 5, 3)), canvas.array)
+
+        # Nothing is drawn without the fill drawing mode
+        canvas.clear(0, 0, 0)
+        state.drawing_mode = agg.DrawingMode.DrawStroke
+        canvas.draw_shapes_compound([back], paints, self.transform, state)
+        assert_equal(np.zeros((5, 5, 3)), canvas.array)
+
+        with self.assertRaises(ValueError):
+            canvas.draw_shapes_compound([back], paints, self.transform, state,
+                                        styles=[2])
+        with self.assertRaises(ValueError):
+            canvas.draw_shapes_compound([back, front], paints,
+                                        self.transform, state, styles=[0])
+        with self.assertRaises(TypeError):
+            canvas.draw_shapes_compound([back], [None], self.transform, state)
+
+    def test_draw_shapes_compound_gradient(self):
+        # Span generating paints match the same paint drawn by draw_shape,
+        # away from the edges where draw_shape's fills are widened.
+        shape = agg.Path()
+        shape.rect(2, 2, 16, 16)
+        paint = agg.LinearGradientPaint(
+            0, 0, 1, 1, [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 0.0, 1.0, 1.0)],
+            agg.GradientSpread.SpreadReflect, agg.GradientUnits.UserSpace,
+        )
+        state = agg.GraphicsState()
+        expected = agg.CanvasRGBA32(np.zeros((20, 20, 4), dtype=np.uint8))
+        expected.draw_shape(shape, self.transform, state, fill=paint)
+        actual = agg.CanvasRGBA32(np.zeros((20, 20, 4), dtype=np.uint8))
+        actual.draw_shapes_compound([shape], [paint], self.transform, state)
+        assert_equal(expected.array[3:17, 3:17], actual.array[3:17, 3:17])
+        assert_equal(0, actual.array[:2])
+
+    def test_draw_shapes_compound_premultiplied(self):
+        # Premultiplied canvases get premultiplied colors, the same as from
+        # draw_shape away from the seam where its fills are widened
+        left = agg.Path()
+        left.rect(0, 0, 5, 10)
+        right = agg.Path()
+        right.rect(5, 0, 5, 10)
+        red = agg.SolidPaint(1, 0, 0, 0.5)
+        blue = agg.SolidPaint(0, 0, 1, 0.5)
+        state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+        for canvas_type in (agg.CanvasRGBA32, agg.CanvasRGBA32Pre):
+            expected = canvas_type(np.zeros((10, 10, 4), dtype=np.uint8))
+            expected.draw_shape(left, self.transform, state, fill=red)
+            expected.draw_shape(right, self.transform, state, fill=blue)
+            actual = canvas_type(np.zeros((10, 10, 4), dtype=np.uint8))
+            actual.draw_shapes_compound([left, right], [red, blue],
+                                        self.transform, state)
+            assert_equal(expected.array[:, :4], actual.array[:, :4])
+            assert_equal(expected.array[:, 6:], actual.array[:, 6:])
+
+        canvas = agg.CanvasRGBA32Pre(np.zeros((10, 10, 4), dtype=np.uint8))
+        canvas.draw_shapes_compound([left], [red], self.transform, state)
+        assert_equal([128, 0, 0, 128], canvas.array[5, 2])
+
+    def test_gradient_spans(self):
+        # Black to white stops make the red channel the color table index.
+        # Spans shorter and longer than the vector width are checked against
+        # AGG's stepping and gradient functions.
+        stops = [(0.0, 0.0, 0.0, 0.0, 1.0), (1.0, 1.0, 1.0, 1.0, 1.0)]
+        paints = (
+            ('linear', agg.LinearGradientPaint, (2.5, 1.0, 13.5, 1.0)),
+            ('linear', agg.LinearGradientPaint, (1.0, 2.0, 1.0, 12.0)),
+            ('radial', agg.RadialGradientPaint, (6.5, 5.0, 7.0, 8.0, 4.0)),
+        )
+        transforms = (
+            (1.0, 0.0, 0.0, 1.0, 0.0, 0.0),
+            (0.0, 1.0, -1.0, 0.0, 20.0, -3.0),
+            (0.5, 0.5, -1.0, 1.0, 3.0, 1.0),
+            # Steps which aren't whole subpixels
+            (1.0, 3 / 1024, 1.0, 1 + 3 / 1024, 2.0, 1.0),
+        )
+        state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+        for kind, paint_type, points in paints:
+            for spread in agg.GradientSpread:
+                paint = paint_type(*(points + (stops, spread,
+                                               agg.GradientUnits.UserSpace)))
+                for transform in transforms:
+                    paint.transform = agg.Transform(*transform)
+                    for width in (1, 2, 3, 5, 6, 7, 8, 37, 203):
+                        # Compound shapes are drawn in one span per row,
+                        # without being widened
+                        shape = agg.Path()
+                        shape.rect(3, 0, width, 16)
+                        canvas = agg.CanvasRGBA32(
+                            np.zeros((16, width + 6, 4), dtype=np.uint8)
+                        )
+                        canvas.draw_shapes_compound(
+                            [shape], [paint], self.transform, state
+                        )
+                        expected = _gradient_reference(
+                            kind, points, spread, transform, 3, width, 16
+                        )
+                        assert_equal(canvas.array[:, 3:-3, 0], expected,
+                                     err_msg='{} {} {} {}'.format(
+                                         points, spread.name, transform,
+                                         width))
+
+    def test_gradient_colors_cache(self):
+        stops = [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 0.0, 1.0, 0.5)]
+        shape = agg.Path()
+        shape.rect(0, 0, 20, 20)
+
+        def gradient():
+            return agg.LinearGradientPaint(0, 0, 20, 0, stops,
+                                           agg.GradientSpread.SpreadPad,
+                                           agg.GradientUnits.UserSpace)
+
+        def draw(canvas_type, dtype, paint, alpha):
+            canvas = canvas_type(np.zeros((20, 20, 4), dtype=dtype))
+            canvas.draw_shape(shape, agg.Transform(),
+                              agg.GraphicsState(master_alpha=alpha),
+                              fill=paint)
+            return canvas.array
+
+        # A paint which is reused matches a new paint when the canvas type or
+        # the master alpha changes
+        paint = gradient()
+        for canvas_type, dtype in [(agg.CanvasRGBA32, np.uint8),
+                                   (agg.CanvasRGBA32Pre, np.uint8),
+                                   (agg.CanvasRGBA128, np.float32),
+                                   (agg.CanvasRGBA32, np.uint8)]:
+            for alpha in (1.0, 0.5, 1.0):
+                assert_equal(draw(canvas_type, dtype, paint, alpha),
+                             draw(canvas_type, dtype, gradient(), alpha))
+
+        # Changes to the stops array of a paint are seen by its next draw
+        stop_array = np.array([(0.0, 1.0, 0.0, 0.0, 1.0),
+                               (1.0, 1.0, 0.0, 0.0, 1.0)])
+        paint = agg.LinearGradientPaint(0, 0, 20, 0, stop_array,
+                                        agg.GradientSpread.SpreadPad,
+                                        agg.GradientUnits.UserSpace)
+        colors = draw(agg.CanvasRGBA32, np.uint8, paint, 1.0)[2:-2, 2:-2, :3]
+        assert_equal(colors, np.broadcast_to([255, 0, 0], (16, 16, 3)))
+        stop_array[:, 1:4] = (0.0, 0.0, 1.0)
+        colors = draw(agg.CanvasRGBA32, np.uint8, paint, 1.0)[2:-2, 2:-2, :3]
+        assert_equal(colors, np.broadcast_to([0, 0, 255], (16, 16, 3)))
+
+        # Float canvases get more than 256 steps
+        canvas = agg.CanvasRGBA128(np.zeros((1, 2000, 4), dtype=np.float32))
+        shape = agg.Path()
+        shape.rect(0, 0, 2000, 1)
+        paint = agg.LinearGradientPaint(0, 0, 2000, 0, stops,
+                                        agg.GradientSpread.SpreadPad,
+                                        agg.GradientUnits.UserSpace)
+        canvas.draw_shape(shape, agg.Transform(),
+                          agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill),
+                          fill=paint)
+        self.assertGreater(len(np.unique(canvas.array[0, :, 0])), 256)
+
+    def test_fast_hairlines(self):
+        path = agg.Path()
+        path.move_to(0, 2.5)
+        path.line_to(5, 2.5)
+        path.move_to(1.5, 0)
+        path.line_to(1.5, 5)
+        paint = agg.SolidPaint(1, 1, 1)
+        expected = [
+            [0, 255, 0, 0, 0],
+            [0, 255, 0, 0, 0],
+            [255, 255, 255, 255, 255],
+            [0, 255, 0, 0, 0],
+            [0, 255, 0, 0, 0],
+        ]
+        state = agg.GraphicsState(fast_hairlines=True, line_width=1.0)
+        self.canvas.draw_shape(path, self.transform, state, stroke=paint)
+        assert_equal(expected, self.canvas.array)
+
+        # Strokes are clipped to the clip box
+        self.canvas.clear(0, 0, 0)
+        state.clip_box = agg.Rect(0, 0, 3, 3)
+        self.canvas.draw_shape(path, self.transform, state, stroke=paint)
+        expected = np.array(expected)
+        expected[3:] = 0
+        expected[:, 3:] = 0
+        assert_equal(expected, self.canvas.array)
+
+        # Bevel and round joins don't spike out past sharp corners like miters
+        path = agg.Path()
+        path.move_to(2, 2)
+        path.line_to(30, 5.5)
+        path.line_to(2, 9)
+        for join in (agg.LineJoin.JoinBevel, agg.LineJoin.JoinRound):
+            canvas = agg.CanvasG8(np.zeros((12, 40), dtype=np.uint8))
+            state = agg.GraphicsState(fast_hairlines=True, line_width=1.0,
+                                      line_join=join)
+            canvas.draw_shape(path, self.transform, state, stroke=paint)
+            self.assertGreater(canvas.array[:, 29].max(), 0)
+            assert_equal(canvas.array[:, 31:], 0)
+
+    def test_fast_hairlines_fallback(self):
+        # Wide, aliased or gradient strokes aren't drawn as hairlines
+        path = agg.Path()
+        path.move_to(1, 1)
+        path.line_to(18, 7)
+        path.line_to(3, 17)
+        gradient = agg.LinearGradientPaint(
+            0, 0, 20, 20, [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 0.0, 1.0, 1.0)],
+            agg.GradientSpread.SpreadPad, agg.GradientUnits.UserSpace,
+        )
+        solid = agg.SolidPaint(0.0, 1.0, 0.0)
+        for kwargs, paint in (({'line_width': 1.5}, solid),
+                              ({'anti_aliased': False}, solid),
+                              ({}, gradient)):
+            results = []
+            for fast in (False, True):
+                canvas = agg.CanvasRGBA32(np.zeros((20, 20, 4), np.uint8))
+                state = agg.GraphicsState(fast_hairlines=fast, **kwargs)
+                canvas.draw_shape(path, self.transform, state, stroke=paint)
+                results.append(canvas.array)
+            assert_equal(results[0], results[1])
+
+    def test_partially_visible_shape(self):
+        # Shapes reaching past the canvas are clipped before being stroked,
+        # which must not change what is visible.
+        path = agg.Path()
+        path.move_to(10, 10)
+        for i in range(1, 19):
+            path.line_to(10 + i * 10, 10 + (i % 2) * 180)
+        path.close()
+        path.move_to(30, 95)
+        path.line_to(170, 105)
+        paint = agg.SolidPaint(0.0, 1.0, 0.0, 0.75)
+        fill = agg.SolidPaint(1.0, 0.0, 0.0, 0.5)
+        cases = (
+            ({'line_width': 3.0}, None),
+            ({'line_width': 5.0, 'line_dash_pattern': [[7.0, 3.0]]}, None),
+            ({'line_width': 2.0}, (3, 2, 12, 15)),
+            ({'line_width': 4.0, 'drawing_mode': agg.DrawingMode.DrawStroke,
+              'line_join': agg.LineJoin.JoinMiter}, None),
+        )
+        for kwargs, clip in cases:
+            full = agg.CanvasRGBA32(np.zeros((200, 200, 4), np.uint8))
+            state = agg.GraphicsState(**kwargs)
+            if clip is not None:
+                state.clip_box = agg.Rect(clip[0] + 90, clip[1] + 90, *clip[2:])
+            full.draw_shape(path, agg.Transform(), state,
+                            stroke=paint, fill=fill)
+
+            canvas = agg.CanvasRGBA32(np.zeros((20, 20, 4), np.uint8))
+            if clip is not None:
+                state.clip_box = agg.Rect(*clip)
+            transform = agg.Transform()
+            transform.translate(-90, -90)
+            canvas.draw_shape(path, transform, state, stroke=paint, fill=fill)
+            # Vertices added by clipping snap to the rasterizer's sub-pixel
+            # grid, which can move an edge by a fraction of a level.
+            diff = canvas.array.astype(int) - full.array[90:110, 90:110]
+            self.assertLessEqual(np.abs(diff).max(), 1)
+
+    def test_offscreen_shape(self):
+        path = agg.Path()
+        path.ellipse(50, 50, 10, 10)
+        canvas = agg.CanvasRGBA32(np.zeros((20, 20, 4), np.uint8))
+        state = agg.GraphicsState(line_width=8.0)
+        canvas.draw_shape(path, self.transform, state)
+        assert_equal(canvas.array, np.zeros((20, 20, 4), np.uint8))
+
+        # The edge of a wide stroke still reaches the canvas
+        path = agg.Path()
+        path.ellipse(28, 10, 10, 10)
+        state = agg.GraphicsState(line_width=8.0,
+                                  drawing_mode=agg.DrawingMode.DrawStroke)
+        canvas.draw_shape(path, self.transform, state)
+        self.assertTrue(canvas.array[:, 19, 3].any())
+
+    def test_decimate_lines(self):
+        paint = agg.SolidPaint(0.0, 0.0, 0.0)
+
+        def draw(path, decimate):
+            canvas = agg.CanvasRGBA32(np.zeros((20, 20, 4), np.uint8))
+            state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawStroke,
+                                      decimate_lines=decimate)
+            canvas.draw_shape(path, self.transform, state, stroke=paint)
+            return canvas.array[..., 3]
+
+        # Lines with at most one vertex per column are left alone
+        path = agg.Path()
+        path.lines([[1, 1], [5, 17], [9, 4], [13, 15], [18, 2]])
+        assert_equal(draw(path, True), draw(path, False))
+
+        # Dense lines keep their shape
+        x = np.linspace(0, 20, 2000)
+        y = 10 + 6 * np.sin(x * 3.1) * np.cos(x * 17.0)
+        path = agg.Path()
+        path.lines(np.stack([x, y], axis=1))
+        expected = draw(path, False)
+        actual = draw(path, True)
+        assert_equal(actual > 127, expected > 127)
+
+    def test_draw_markers(self):
+        paint = agg.SolidPaint(1, 1, 1)
+        points = np.array([[2.5, 2.5]])
+        state = agg.GraphicsState(anti_aliased=False)
+        self.canvas.draw_markers(points, agg.MarkerType.MarkerSquare, 3,
+                                 paint, state)
+        expected = np.zeros((5, 5), dtype=np.uint8)
+        expected[1:4, 1:4] = 255
+        assert_equal(expected, self.canvas.array)
+
+        # The transform moves the points but doesn't scale the markers
+        self.canvas.clear(0, 0, 0)
+        transform = agg.Transform()
+        transform.scale(2.0, 2.0)
+        self.canvas.draw_markers([[1.25, 0.25]], agg.MarkerType.MarkerDash,
+                                 3, paint, state, transform=transform)
+        expected = np.zeros((5, 5), dtype=np.uint8)
+        expected[0, 1:4] = 255
+        assert_equal(expected, self.canvas.array)
+
+    def test_draw_markers_anti_aliased(self):
+        # Anti-aliased markers match the same shape drawn at the points
+        points = np.random.RandomState(0).uniform(0, 40, size=(50, 2))
+        transform = agg.Transform()
+        transform.translate(3.0, -2.0)
+        transform.scale(0.5, 0.5)
+        paint = agg.SolidPaint(0.2, 0.4, 1.0, 0.75)
+        state = agg.GraphicsState(line_width=1.5)
+
+        triangle = agg.Path()
+        triangle.move_to(0.0, -3.0)
+        triangle.line_to(2.4, 1.8)
+        triangle.line_to(-2.4, 1.8)
+        triangle.close()
+        cross = agg.Path()
+        cross.move_to(-3.0, 0.0)
+        cross.line_to(3.0, 0.0)
+        cross.move_to(0.0, -3.0)
+        cross.line_to(0.0, 3.0)
+
+        device_points = [transform.worldToScreen(x, y) for x, y in points]
+        for marker, shape, mode in (
+                (agg.MarkerType.MarkerTriangleUp, triangle,
+                 agg.DrawingMode.DrawFill),
+                (agg.MarkerType.MarkerCross, cross,
+                 agg.DrawingMode.DrawStroke)):
+            expected = agg.CanvasRGBA32(np.zeros((30, 30, 4), np.uint8))
+            shape_state = state.copy()
+            shape_state.drawing_mode = mode
+            expected.draw_shape_at_points(shape, device_points,
+                                          agg.Transform(), shape_state,
+                                          stroke=paint, fill=paint)
+            actual = agg.CanvasRGBA32(np.zeros((30, 30, 4), np.uint8))
+            actual.draw_markers(points, marker, 6, paint, state,
+                                transform=transform)
+            assert_equal(expected.array, actual.array)
+
+        with self.assertRaises(TypeError):
+            actual.draw_markers(points, 1, 6, paint, state)
+        with self.assertRaises(ValueError):
+            actual.draw_markers([1, 2, 3], agg.MarkerType.MarkerCircle, 6,
+                                paint, state)
+
+    def test_blend_modes(self):
+        dst = np.random.RandomState(1).randint(0, 256, size=(8, 8, 4))
+        dst = dst.astype(np.uint8)
+        dst[..., 3] = 255
+        path = agg.Path()
+        path.rect(0, 0, 8, 8)
+        paint = agg.SolidPaint(0.2, 0.6, 1.0, 0.5)
+        src = np.array([0.2, 0.6, 1.0]) * 0.5
+        d = dst[..., :3] / 255.0
+        expected = {
+            agg.BlendMode.BlendMultiply: src * d + d * 0.5,
+            agg.BlendMode.BlendScreen: src + d - src * d,
+            agg.BlendMode.BlendAdd: np.minimum(src + d, 1.0),
+            agg.BlendMode.BlendDarken: np.minimum(src + d * 0.5, d),
+            agg.BlendMode.BlendLighten: np.maximum(src + d * 0.5, d),
+            # Drawn by AGG's own compositing
+            agg.BlendMode.BlendDifference: src + d - 2 * np.minimum(src,
+                                                                    d * 0.5),
+        }
+        for mode, result in expected.items():
+            state = agg.GraphicsState(blend_mode=mode, anti_aliased=False,
+                                      drawing_mode=agg.DrawingMode.DrawFill)
+            rgba = agg.CanvasRGBA32(dst.copy())
+            rgba.draw_shape(path, self.transform, state, fill=paint)
+            diff = np.abs(rgba.array[..., :3] - np.round(result * 255))
+            self.assertLessEqual(diff.max(), 2)
+            assert_equal(rgba.array[..., 3], 255)
+
+            # Both byte orders blend the same way
+            bgra = agg.CanvasBGRA32(dst[..., [2, 1, 0, 3]].copy())
+            bgra.draw_shape(path, self.transform, state, fill=paint)
+            assert_equal(rgba.array, bgra.array[..., [2, 1, 0, 3]])
+
+        # Images use their own blend mode. Multiplying by white is a no-op.
+        white = np.full((8, 8, 4), 255, dtype=np.uint8)
+        state = agg.GraphicsState(image_blend_mode=agg.BlendMode.BlendMultiply)
+        rgba = agg.CanvasRGBA32(dst.copy())
+        rgba.draw_image(white, agg.PixelFormat.RGBA32, self.transform, state)
+        assert_equal(rgba.array, dst)
+        state.image_blend_mode = agg.BlendMode.BlendAlpha
+        rgba.draw_image(white, agg.PixelFormat.RGBA32, self.transform, state)
+        assert_equal(rgba.array, white)
+
+    def test_image_filters(self):
+        state = agg.GraphicsState()
+        self.assertEqual(state.image_filter, agg.ImageFilter.Nearest)
+
+        # Shrinking a checkerboard averages it instead of aliasing
+        checker = np.indices((64, 64)).sum(axis=0) % 2 * 255
+        image = np.zeros((64, 64, 4), dtype=np.uint8)
+        image[..., :3] = checker[..., np.newaxis]
+        image[..., 3] = 255
+        transform = agg.Transform()
+        transform.scale(0.25, 0.25)
+        for image_filter in agg.ImageFilter:
+            state.image_filter = image_filter
+            canvas = agg.CanvasRGBA32(np.zeros((16, 16, 4), dtype=np.uint8))
+            canvas.draw_image(image, agg.PixelFormat.RGBA32, transform, state)
+            values = canvas.array[2:14, 2:14, :3]
+            if image_filter == agg.ImageFilter.Nearest:
+                self.assertTrue(np.all((values == 0) | (values == 255)))
+            else:
+                assert_equal(values, 127)
+
+        # Translucent images keep their colors when they are filtered
+        image = np.zeros((8, 8, 4), dtype=np.uint8)
+        image[..., 0] = 255
+        image[..., 3] = 128
+        transform = agg.Transform()
+        transform.scale(3.0, 3.0)
+        state.image_filter = agg.ImageFilter.Nearest
+        expected = agg.CanvasRGBA32(np.zeros((24, 24, 4), dtype=np.uint8))
+        expected.draw_image(image, agg.PixelFormat.RGBA32, transform, state)
+        for image_filter in agg.ImageFilter:
+            state.image_filter = image_filter
+            canvas = agg.CanvasRGBA32(np.zeros((24, 24, 4), dtype=np.uint8))
+            canvas.draw_image(image, agg.PixelFormat.RGBA32, transform, state)
+            diff = np.abs(canvas.array.astype(int) - expected.array)
+            self.assertLessEqual(diff.max(), 1)
+
+    def test_draw_image_blit(self):
+        # Whole pixel translations and upscales copy pixels directly. The
+        # result matches drawing through the rasterizer, which a vanishing
+        # shear forces.
+        rs = np.random.RandomState(0)
+        image = rs.randint(0, 256, size=(20, 17, 4)).astype(np.uint8)
+        background = rs.randint(0, 256, size=(40, 50, 4)).astype(np.uint8)
+        stencil = agg.Image(
+            (rs.uniform(size=(40, 50)) > 0.5).astype(np.uint8) * 200,
+            agg.PixelFormat.Gray8,
+        )
+        states = (
+            agg.GraphicsState(),
+            agg.GraphicsState(stencil=stencil),
+            agg.GraphicsState(clip_box=agg.Rect(4, 5, 20, 10)),
+            agg.GraphicsState(image_blend_mode=agg.BlendMode.BlendMultiply),
+        )
+        for sx, sy, tx, ty in ((1, 1, 3, -2), (2, 3, -5, 7), (3, 1, 40, 30)):
+            for state in states:
+                blit = agg.CanvasRGBA32(background.copy())
+                blit.draw_image(image, agg.PixelFormat.RGBA32,
+                                agg.Transform(sx, 0, 0, sy, tx, ty), state)
+                expected = agg.CanvasRGBA32(background.copy())
+                expected.draw_image(image, agg.PixelFormat.RGBA32,
+                                    agg.Transform(sx, 0, 1e-300, sy, tx, ty),
+                                    state)
+                assert_equal(expected.array, blit.array)
+
+                gray = image[..., 0].copy()
+                blit = agg.CanvasG8(background[..., 0].copy())
+                blit.draw_image(gray, agg.PixelFormat.Gray8,
+                                agg.Transform(sx, 0, 0, sy, tx, ty), state)
+                expected = agg.CanvasG8(background[..., 0].copy())
+                expected.draw_image(gray, agg.PixelFormat.Gray8,
+                                    agg.Transform(sx, 0, 1e-300, sy, tx, ty),
+                                    state)
+                assert_equal(expected.array, blit.array)
+
+    def test_image_mipmap(self):
+        checker = np.indices((64, 64)).sum(axis=0) % 2 * 255
+        image = np.zeros((64, 64, 4), dtype=np.uint8)
+        image[..., :3] = checker[..., np.newaxis]
+        image[..., 3] = 255
+        transform = agg.Transform()
+        transform.scale(0.125, 0.125)
+        state = agg.GraphicsState()
+
+        def assert_gray(values):
+            # Half gray rounds either way depending on the format
+            self.assertTrue(np.all((values == 127) | (values == 128)))
+
+        # Shrunken levels average the checkerboard, even for nearest
+        for fmt, canvas_type in ((agg.PixelFormat.RGBA32, agg.CanvasRGBA32),
+                                 (agg.PixelFormat.BGRA32, agg.CanvasBGRA32)):
+            mipmapped = agg.Image(image, fmt, mipmap=True)
+            self.assertTrue(mipmapped.mipmap)
+            canvas = canvas_type(np.zeros((8, 8, 4), dtype=np.uint8))
+            canvas.draw_image(mipmapped, None, transform, state)
+            assert_gray(canvas.array[..., :3])
+
+        gray = agg.Image(checker.astype(np.uint8), agg.PixelFormat.Gray8,
+                         mipmap=True)
+        canvas = agg.CanvasG8(np.zeros((8, 8), dtype=np.uint8))
+        canvas.draw_image(gray, None, transform, state)
+        assert_gray(canvas.array)
+
+        # Levels are rebuilt after the pixels change
+        gray.pixels[:] = 255
+        gray.invalidate()
+        canvas.draw_image(gray, None, transform, state)
+        assert_equal(canvas.array, 255)
+
+        # Patterns use the levels as well
+        gray.pixels[:] = checker
+        gray.invalidate()
+        paint = agg.PatternPaint(agg.PatternStyle.StyleRepeat, gray)
+        paint.transform = transform
+        path = agg.Path()
+        path.rect(0, 0, 8, 8)
+        fill = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+        canvas.clear(0, 0, 0)
+        canvas.draw_shape(path, agg.Transform(), fill, fill=paint)
+        assert_gray(canvas.array)
+
+    def test_image_conversion(self):
+        rs = np.random.RandomState(0)
+        pixels = rs.randint(0, 256, size=(8, 8, 4)).astype(np.uint8)
+        pixels[..., 3] = 255
+        image = agg.Image(pixels, agg.PixelFormat.RGBA32)
+        transform = agg.Transform()
+        state = agg.GraphicsState()
+
+        canvas = agg.CanvasBGRA32(np.zeros((8, 8, 4), dtype=np.uint8))
+        canvas.draw_image(image, None, transform, state)
+        assert_equal(canvas.array, pixels[..., [2, 1, 0, 3]])
+
+        # Gray is the rounded mean of the color channels
+        canvas = agg.CanvasG8(np.zeros((8, 8), dtype=np.uint8))
+        canvas.draw_image(image, None, transform, state)
+        expected = (pixels[..., :3].astype(int).sum(axis=-1) + 1) // 3
+        assert_equal(canvas.array, expected)
+
+        # The converted pixels are kept until the image is invalidated
+        pixels[..., :3] = 255
+        canvas.draw_image(image, None, transform, state)
+        assert_equal(canvas.array, expected)
+        image.invalidate()
+        canvas.draw_image(image, None, transform, state)
+        assert_equal(canvas.array, 255)
+
+        # or its pixels are assigned to
+        rgb = agg.Image(np.zeros((8, 8, 3), dtype=np.uint8),
+                        agg.PixelFormat.RGB24)
+        canvas = agg.CanvasRGBA32(np.zeros((8, 8, 4), dtype=np.uint8))
+        canvas.draw_image(rgb, None, transform, state)
+        assert_equal(canvas.array[..., :3], 0)
+        rgb.pixels = 100
+        canvas.draw_image(rgb, None, transform, state)
+        assert_equal(canvas.array[..., :3], 100)
+
+    def test_convert_image(self):
+        rs = np.random.RandomState(0)
+        pixels = rs.uniform(size=(512, 512, 4)).astype(np.float32)
+        image = agg.Image(pixels, agg.PixelFormat.RGBA128)
+
+        scaled = pixels[..., [2, 1, 0, 3]].astype(np.float64) * 255.0
+        expected = np.floor(scaled + 0.5).astype(np.uint8)
+        out = np.zeros((512, 512, 4), dtype=np.uint8)
+        converted = agg.convert_image(image, agg.PixelFormat.BGRA32, out=out,
+                                      threads=4)
+        self.assertIs(converted.pixels, out)
+        assert_equal(out, expected)
+
+        # Premultiplied colors round trip
+        premultiplied = agg.convert_image(image, agg.PixelFormat.RGBA128,
+                                          premultiply=True)
+        assert_equal(premultiplied.pixels[..., 3], pixels[..., 3])
+        colors = pixels[..., :3] * pixels[..., 3:]
+        self.assertLess(np.abs(premultiplied.pixels[..., :3] - colors).max(),
+                        1e-6)
+        straight = agg.convert_image(premultiplied, agg.PixelFormat.RGBA128,
+                                     demultiply=True)
+        self.assertLess(np.abs(straight.pixels - pixels).max(), 1e-5)
+
+        # Every channel is clamped and rounded the same way, whether or not
+        # alpha is converted too
+        values = np.array([[[0.999, -0.5, 7.0, 1.0],
+                            [np.nan, 0.5, 0.001, 1.0]]], dtype=np.float32)
+        source = agg.Image(values, agg.PixelFormat.RGBA128)
+        for kwargs in ({}, {'premultiply': True}, {'demultiply': True}):
+            for fmt, expected in ((agg.PixelFormat.RGBA32,
+                                   [[[255, 0, 255, 255], [0, 128, 0, 255]]]),
+                                  (agg.PixelFormat.RGBA64,
+                                   [[[65469, 0, 65535, 65535],
+                                     [0, 32768, 66, 65535]]])):
+                converted = agg.convert_image(source, fmt, **kwargs)
+                assert_equal(converted.pixels, expected)
+
+        with self.assertRaises(ValueError):
+            agg.convert_image(image, agg.PixelFormat.RGBA32,
+                              out=np.zeros((512, 512, 3), dtype=np.uint8))
+        with self.assertRaises(ValueError):
+            agg.convert_image(image, agg.PixelFormat.RGBA32, premultiply=True,
+                              demultiply=True)
+
+    def test_image_master_alpha(self):
+        # Drawing with a master alpha matches drawing a copy of the image
+        # with its alpha scaled
+        rs = np.random.RandomState(0)
+        image = rs.randint(0, 256, size=(20, 17, 4)).astype(np.uint8)
+        background = rs.randint(0, 256, size=(40, 50, 4)).astype(np.uint8)
+        faded = image.copy()
+        product = faded[..., 3].astype(int) * 128 + 128
+        faded[..., 3] = (product + (product >> 8)) >> 8
+
+        fmt = agg.PixelFormat.RGBA32
+        state = agg.GraphicsState(master_alpha=0.5)
+        for transform in (agg.Transform(1, 0, 0, 1, 3, 4),
+                          agg.Transform(2, 0, 0, 2, 3, 4),
+                          agg.Transform(2, 0, 1e-300, 2, 3, 4)):
+            canvas = agg.CanvasRGBA32(background.copy())
+            canvas.draw_image(image, fmt, transform, state)
+            expected = agg.CanvasRGBA32(background.copy())
+            expected.draw_image(faded, fmt, transform, agg.GraphicsState())
+            assert_equal(expected.array, canvas.array)
+
+        # Canvases without alpha blend instead of copying
+        opaque = image.copy()
+        opaque[..., 3] = 255
+        for transform in (agg.Transform(1, 0, 0, 1, 3, 4),
+                          agg.Transform(1, 0, 1e-300, 1, 3, 4)):
+            canvas = agg.CanvasRGB24(background[..., :3].copy())
+            canvas.draw_image(image[..., :3].copy(), agg.PixelFormat.RGB24,
+                              transform, state)
+            expected = agg.CanvasRGBA32(background.copy())
+            expected.draw_image(opaque, fmt, transform, state)
+            assert_equal(expected.array[..., :3], canvas.array)
+
+        # Patterns fade as well
+        path = agg.Path()
+        path.rect(0, 0, 50, 40)
+        paint = agg.PatternPaint(agg.PatternStyle.StyleRepeat,
+                                 agg.Image(image, fmt))
+        faded_paint = agg.PatternPaint(agg.PatternStyle.StyleRepeat,
+                                       agg.Image(faded, fmt))
+        fill = agg.DrawingMode.DrawFill
+        canvas = agg.CanvasRGBA32(background.copy())
+        canvas.draw_shape(path, agg.Transform(),
+                          agg.GraphicsState(drawing_mode=fill,
+                                            master_alpha=0.5),
+                          fill=paint)
+        expected = agg.CanvasRGBA32(background.copy())
+        expected.draw_shape(path, agg.Transform(),
+                            agg.GraphicsState(drawing_mode=fill),
+                            fill=faded_paint)
+        assert_equal(expected.array, canvas.array)
+
+    def test_premultiplied_canvas(self):
+        # Drawing on a transparent canvas already gives premultiplied pixels,
+        # so the Pre canvases should match the straight canvases there.
+        path = agg.Path()
+        path.rect(2, 3, 10, 8)
+        state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+        stops = [(0, 1, 0, 0, 0.5), (1, 0, 0, 1, 0.5)]
+        paints = (agg.SolidPaint(1, 0, 0, 0.5),
+                  agg.LinearGradientPaint(0, 0, 16, 0, stops,
+                                          agg.GradientSpread.SpreadPad,
+                                          agg.GradientUnits.UserSpace))
+        for paint in paints:
+            expected = agg.CanvasRGBA32(np.zeros((16, 16, 4), np.uint8))
+            expected.draw_shape(path, agg.Transform(), state, fill=paint)
+            canvas = agg.CanvasRGBA32Pre(np.zeros((16, 16, 4), np.uint8))
+            canvas.draw_shape(path, agg.Transform(), state, fill=paint)
+            assert_equal(expected.array, canvas.array)
+
+        canvas = agg.CanvasBGRA32Pre(np.zeros((16, 16, 4), np.uint8))
+        canvas.clear(0, 0, 1, 0.5)
+        assert_equal(canvas.array[0, 0], [128, 0, 0, 128])
+        canvas = agg.CanvasRGBA128Pre(np.zeros((16, 16, 4), np.float32))
+        canvas.draw_shape(path, agg.Transform(), state, fill=paints[0])
+        assert_equal(canvas.array[6, 5], [0.5, 0, 0, 0.5])
+
+        # Converting to a premultiplied format premultiplies
+        rs = np.random.RandomState(0)
+        pixels = rs.randint(0, 256, size=(8, 8, 4)).astype(np.uint8)
+        image = agg.Image(pixels, agg.PixelFormat.RGBA32)
+        premultiplied = agg.convert_image(image, agg.PixelFormat.RGBA32Pre)
+        assert_equal(premultiplied.format, agg.PixelFormat.RGBA32Pre)
+        assert_equal(premultiplied.pixels,
+                     agg.convert_image(image, agg.PixelFormat.RGBA32,
+                                       premultiply=True).pixels)
+
+        # Premultiplied images draw like their straight originals
+        for transform in (agg.Transform(1, 0, 0, 1, 3, 4),
+                          agg.Transform(2, 0, 0, 2, 3, 4),
+                          agg.Transform(2, 0, 1e-300, 2, 3, 4)):
+            state = agg.GraphicsState()
+            expected = agg.CanvasRGBA32(np.zeros((30, 30, 4), np.uint8))
+            expected.draw_image(image, None, transform, state)
+            canvas = agg.CanvasRGBA32Pre(np.zeros((30, 30, 4), np.uint8))
+            canvas.draw_image(premultiplied, None, transform, state)
+            assert_equal(expected.array, canvas.array)
+
+            # Straight images are converted before drawing
+            state = agg.GraphicsState(master_alpha=0.5)
+            expected = agg.CanvasRGBA32Pre(np.zeros((30, 30, 4), np.uint8))
+            expected.draw_image(premultiplied, None, transform, state)
+            canvas = agg.CanvasRGBA32Pre(np.zeros((30, 30, 4), np.uint8))
+            canvas.draw_image(image, None, transform, state)
+            assert_equal(expected.array, canvas.array)
+
+    def test_16bit_canvases(self):
+        # 16 bit canvases draw the same as 8 bit ones, up to rounding
+        path = agg.Path()
+        path.ellipse(20, 15, 12, 9)
+        stops = [(0, 1, 0, 0, 1), (1, 0, 0, 1, 0.5)]
+        gradient = agg.LinearGradientPaint(0, 0, 40, 0, stops,
+                                           agg.GradientSpread.SpreadPad,
+                                           agg.GradientUnits.UserSpace)
+        rs = np.random.RandomState(0)
+        image = agg.Image(rs.randint(0, 256, size=(10, 10, 4)).astype(np.uint8),
+                          agg.PixelFormat.RGBA32)
+        state = agg.GraphicsState(
+            drawing_mode=agg.DrawingMode.DrawFillStroke, line_width=2,
+        )
+
+        def draw(canvas):
+            canvas.draw_shape(path, agg.Transform(), state,
+                              stroke=agg.SolidPaint(0, 0, 1, 0.7),
+                              fill=gradient)
+            for image_filter in (agg.ImageFilter.Nearest,
+                                 agg.ImageFilter.Bilinear,
+                                 agg.ImageFilter.Bicubic):
+                canvas.draw_image(image, None,
+                                  agg.Transform(1.5, 0, 0.2, 1.5, 5, 2),
+                                  agg.GraphicsState(image_filter=image_filter,
+                                                    master_alpha=0.7))
+            return canvas.array
+
+        for canvas16, canvas8, shape in ((agg.CanvasRGBA64, agg.CanvasRGBA32,
+                                          (40, 50, 4)),
+                                         (agg.CanvasRGB48, agg.CanvasRGB24,
+                                          (40, 50, 3)),
+                                         (agg.CanvasG16, agg.CanvasG8,
+                                          (40, 50))):
+            expected = draw(canvas8(np.zeros(shape, dtype=np.uint8)))
+            actual = draw(canvas16(np.zeros(shape, dtype=np.uint16)))
+            self.assertEqual(actual.dtype, np.uint16)
+            self.assertLessEqual(np.abs(actual / 257.0 - expected).max(), 3)
+
+        canvas = agg.CanvasRGBA64(np.zeros((4, 4, 4), dtype=np.uint16))
+        canvas.clear(1, 0.5, 0, 1)
+        assert_equal(canvas.array[0, 0], [65535, 32768, 0, 65535])
+
+    def test_float_gray_canvas(self):
+        path = agg.Path()
+        path.ellipse(20, 15, 12, 9)
+        rs = np.random.RandomState(0)
+        image = agg.Image(rs.randint(0, 256, size=(10, 10, 4)).astype(np.uint8),
+                          agg.PixelFormat.RGBA32)
+        state = agg.GraphicsState(
+            drawing_mode=agg.DrawingMode.DrawFillStroke, line_width=2,
+        )
+
+        def draw(canvas):
+            canvas.draw_shape(path, agg.Transform(), state,
+                              stroke=agg.SolidPaint(0.5, 0.5, 0.5, 0.7),
+                              fill=agg.SolidPaint(1, 1, 1, 0.5))
+            canvas.draw_image(image, None,
+                              agg.Transform(1.5, 0, 0.2, 1.5, 5, 2),
+                              agg.GraphicsState(master_alpha=0.7))
+            canvas.draw_shapes_compound([path], [agg.SolidPaint(1, 1, 1, 0.3)],
+                                        agg.Transform(1, 0, 0, 1, 10, 10),
+                                        agg.GraphicsState())
+            return canvas.array
+
+        expected = draw(agg.CanvasG8(np.zeros((40, 50), dtype=np.uint8)))
+        actual = draw(agg.CanvasG32(np.zeros((40, 50), dtype=np.float32)))
+        self.assertEqual(actual.dtype, np.float32)
+        self.assertLessEqual(np.abs(actual * 255 - expected).max(), 2)
+
+        canvas = agg.CanvasG32(np.zeros((4, 4), dtype=np.float32))
+        canvas.clear(0.25, 0.25, 0.25)
+        np.testing.assert_allclose(canvas.array, 0.25, rtol=1e-6)
+
+    def test_draw_scalar_image(self):
+        rs = np.random.RandomState(0)
+        values = rs.uniform(-1, 3, size=(6, 8))
+        values[2, 5] = np.nan
+        colormap = rs.randint(0, 256, size=(16, 4)).astype(np.uint8)
+        colormap[:, 3] = 255
+        nearest = agg.GraphicsState(image_filter=agg.ImageFilter.Nearest)
+
+        # Nearest sampling maps each value to one color of the colormap
+        indices = np.clip(np.floor(values * 16 / 2), 0, 15)
+        colors = colormap[np.nan_to_num(indices).astype(int)]
+        colors[np.isnan(values)] = 0
+        expected = np.zeros((15, 20, 4), dtype=np.uint8)
+        expected[3:15, 2:18] = colors.repeat(2, axis=0).repeat(2, axis=1)
+        canvas = agg.CanvasRGBA32(np.zeros((15, 20, 4), dtype=np.uint8))
+        canvas.draw_scalar_image(values, colormap, 0, 2,
+                                 agg.Transform(2, 0, 0, 2, 2, 3), nearest)
+        assert_equal(canvas.array, expected)
+
+        # Bilinear sampling doesn't blend with NaN values
+        gray = np.linspace(0, 1, 256)[:, np.newaxis].repeat(3, axis=1)
+        canvas = agg.CanvasRGBA32(np.zeros((4, 8, 4), dtype=np.uint8))
+        canvas.draw_scalar_image([[0, np.nan]], gray, 0, 1,
+                                 agg.Transform(4, 0, 0, 4, 0, 0),
+                                 agg.GraphicsState())
+        self.assertTrue(np.all(canvas.array[:, :4] == [0, 0, 0, 255]))
+        assert_equal(canvas.array[:, 4:], 0)
+
+        canvas = agg.CanvasRGBA32(np.zeros((1, 8, 4), dtype=np.uint8))
+        canvas.draw_scalar_image([[0, 1]], gray, 0, 1,
+                                 agg.Transform(4, 0, 0, 1, 0, 0),
+                                 agg.GraphicsState(master_alpha=0.5))
+        self.assertTrue(np.all(np.diff(canvas.array[0, :, 0].astype(int)) >= 0))
+        self.assertLess(canvas.array[0, 2, 0], canvas.array[0, 5, 0])
+        assert_equal(canvas.array[0, :, 3], 128)
+
+        with self.assertRaises(ValueError):
+            canvas.draw_scalar_image([[0, 1]], np.zeros((0, 4)), 0, 1,
+                                     agg.Transform(), agg.GraphicsState())
+
+    def test_density_canvas(self):
+        fill = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+        rect = agg.Path()
+        rect.rect(2, 2, 4, 3)
+
+        # Fills add their area times their weight
+        canvas = agg.DensityCanvas(np.zeros((10, 10), dtype=np.float32))
+        canvas.draw_shape(rect, agg.Transform(), fill)
+        canvas.draw_shape(rect, agg.Transform(), fill, weight=2.5)
+        self.assertEqual(canvas.array[3, 3], 3.5)
+        self.assertAlmostEqual(canvas.array.sum(), 12 * 3.5, places=4)
+        canvas.clear()
+        assert_equal(canvas.array, 0)
+
+        # Integer buffers count hits
+        dot = agg.Path()
+        dot.rect(0, 0, 1, 1)
+        points = [(3, 3), (3, 3), (5, 7), (25, 2)]
+        canvas = agg.DensityCanvas(np.zeros((10, 10), dtype=np.uint32))
+        aliased = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill,
+                                    anti_aliased=False)
+        canvas.draw_shape_at_points(dot, points, agg.Transform(), aliased)
+        canvas.draw_shape_at_points(dot, points, agg.Transform(), aliased,
+                                    weights=[0, 1, 3, 1])
+        self.assertEqual(canvas.array[3, 3], 3)
+        self.assertEqual(canvas.array[7, 5], 4)
+        self.assertEqual(canvas.array.sum(), 7)
+
+        # Points add the same as drawing the shape at each of them
+        shape = agg.Path()
+        shape.ellipse(0, 0, 3.2, 2.1)
+        rs = np.random.RandomState(0)
+        points = np.round(rs.uniform(-3, 43, size=(100, 2)) * 4) / 4
+        weights = rs.uniform(0, 2, size=100)
+        state = agg.GraphicsState(
+            drawing_mode=agg.DrawingMode.DrawFillStroke, line_width=0.7,
+        )
+        expected = agg.DensityCanvas(np.zeros((40, 40), dtype=np.float32))
+        for (x, y), weight in zip(points, weights):
+            expected.draw_shape(shape, agg.Transform(1, 0, 0, 1, x, y), state,
+                                weight=weight)
+        actual = agg.DensityCanvas(np.zeros((40, 40), dtype=np.float32))
+        actual.draw_shape_at_points(shape, points, agg.Transform(), state,
+                                    weights=weights)
+        assert_equal(expected.array, actual.array)
+
+        # Crossing segments both count
+        canvas = agg.DensityCanvas(np.zeros((10, 10), dtype=np.float32))
+        canvas.draw_line_segments([(0, 5.5, 10, 5.5), (5.5, 0, 5.5, 10)],
+                                  agg.Transform(), agg.GraphicsState(),
+                                  weights=[1, 2])
+        self.assertEqual(canvas.array[0, 5], 2)
+        self.assertEqual(canvas.array[5, 0], 1)
+        self.assertAlmostEqual(canvas.array[5, 5], 3, places=5)
+
+        with self.assertRaises(ValueError):
+            canvas.draw_line_segments([(0, 0, 1, 1)], agg.Transform(),
+                                      agg.GraphicsState(), weights=[1, 2])
+        with self.assertRaises(TypeError):
+            agg.DensityCanvas(np.zeros((10, 10), dtype=np.uint8))
+        with self.assertRaises(ValueError):
+            agg.DensityCanvas(np.zeros((0, 10), dtype=np.float32))
+        with self.assertRaises(ValueError):
+            agg.DensityCanvas(np.zeros((10, 0), dtype=np.uint32))
+
+    def test_clip_path(self):
+        # A clip path masks drawing the same way as a stencil of the path
+        path = agg.Path()
+        path.ellipse(20, 15, 14.3, 9.7)
+        transform = agg.Transform(1, 0, 0, 1, 2.25, 3.5)
+        fill = agg.DrawingMode.DrawFill
+        stencil = agg.CanvasG8(np.zeros((30, 40), dtype=np.uint8))
+        stencil.draw_shape(path, transform,
+                           agg.GraphicsState(drawing_mode=fill),
+                           fill=agg.SolidPaint(1, 1, 1))
+
+        shape = agg.Path()
+        shape.rect(0, 0, 40, 30)
+        paint = agg.LinearGradientPaint(
+            0, 0, 40, 0, [(0, 1, 0, 0, 1), (1, 0, 0, 1, 0.5)],
+            agg.GradientSpread.SpreadPad, agg.GradientUnits.UserSpace
+        )
+        image = np.random.RandomState(0).randint(
+            0, 256, size=(30, 40, 4)).astype(np.uint8)
+        for state in (agg.GraphicsState(drawing_mode=fill),
+                      agg.GraphicsState(drawing_mode=fill,
+                                        blend_mode=agg.BlendMode.BlendMultiply)):
+            clipped = agg.CanvasRGBA32(np.full((30, 40, 4), 128, np.uint8))
+            expected = agg.CanvasRGBA32(np.full((30, 40, 4), 128, np.uint8))
+            clipped_state = state.copy()
+            clipped_state.clip_path = (path, transform)
+            stencil_state = state.copy()
+            stencil_state.stencil = stencil.image
+            for canvas, gs in ((clipped, clipped_state),
+                               (expected, stencil_state)):
+                canvas.draw_shape(shape, agg.Transform(), gs, fill=paint)
+                canvas.draw_image(image, agg.PixelFormat.RGBA32,
+                                  agg.Transform(1, 0, 0, 1, 5, 0), gs)
+            assert_equal(expected.array, clipped.array)
+
+        # Nested clip paths intersect
+        state = agg.GraphicsState(drawing_mode=fill)
+        first, second = agg.Path(), agg.Path()
+        first.rect(5, 5, 20, 20)
+        second.rect(10, 0, 30, 12)
+        state.clip_path = first
+        state.add_clip_path(second, agg.Transform(1, 0, 0, 1, 0, 2))
+        self.assertEqual(len(state.clip_path), 2)
+        canvas = agg.CanvasG8(np.zeros((30, 40), dtype=np.uint8))
+        canvas.draw_shape(shape, agg.Transform(), state.copy(),
+                          fill=agg.SolidPaint(1, 1, 1))
+        both = agg.Path()
+        both.rect(10, 5, 15, 9)
+        expected = agg.CanvasG8(np.zeros((30, 40), dtype=np.uint8))
+        expected.draw_shape(both, agg.Transform(),
+                            agg.GraphicsState(drawing_mode=fill),
+                            fill=agg.SolidPaint(1, 1, 1))
+        # Masked edges round differently than rasterized ones
+        diff = canvas.array.astype(int) - expected.array
+        self.assertLessEqual(np.abs(diff).max(), 1)
+        assert_equal(expected.array == 255, canvas.array == 255)
+
+        # The pairs can be set on another state. Copies keep the clip which
+        # was rasterized, even after the paths change.
+        other = agg.GraphicsState(drawing_mode=fill)
+        other.clip_path = state.clip_path
+        self.assertEqual(len(other.clip_path), 2)
+        copied = state.copy()
+        first.reset()
+        first.rect(0, 0, 40, 30)
+        for gs in (other, copied):
+            other_canvas = agg.CanvasG8(np.zeros((30, 40), dtype=np.uint8))
+            other_canvas.draw_shape(shape, agg.Transform(), gs,
+                                    fill=agg.SolidPaint(1, 1, 1))
+            assert_equal(canvas.array, other_canvas.array)
+
+        # Removing the clip path draws everywhere
+        state.clip_path = None
+        self.assertEqual(state.clip_path, ())
+        canvas.draw_shape(shape, agg.Transform(), state,
+                          fill=agg.SolidPaint(1, 1, 1))
+        assert_equal(255, canvas.array)
+
+    def test_stencil_offset(self):
+        # A small stencil at an offset masks the same as a canvas sized one,
+        # whether or not it is compact
+        rs = np.random.RandomState(0)
+        small = rs.randint(0, 256, size=(12, 17)).astype(np.uint8)
+        small[2:5] = 0
+        small[6:9, 3:15] = 255
+        small[10, :] = 77
+        full = np.zeros((30, 40), dtype=np.uint8)
+        full[9:21, 5:22] = small
+
+        shape = agg.Path()
+        shape.rect(0, 0, 40, 30)
+        image = rs.randint(0, 256, size=(30, 40, 4)).astype(np.uint8)
+        paint = agg.SolidPaint(0.2, 0.4, 0.6, 0.8)
+        fill = agg.DrawingMode.DrawFill
+
+        def draw(state):
+            canvas = agg.CanvasRGBA32(np.full((30, 40, 4), 128, np.uint8))
+            canvas.draw_shape(shape, agg.Transform(), state, fill=paint)
+            canvas.draw_image(image, agg.PixelFormat.RGBA32,
+                              agg.Transform(1, 0, 0, 1, 3, 0), state)
+            return canvas.array
+
+        gray8 = agg.PixelFormat.Gray8
+        expected = draw(agg.GraphicsState(drawing_mode=fill,
+                                          stencil=agg.Image(full, gray8)))
+        for compact in (False, True):
+            state = agg.GraphicsState(drawing_mode=fill,
+                                      compact_stencil=compact)
+            state.stencil = agg.Image(small, gray8)
+            state.stencil_offset = (5, 9)
+            self.assertEqual(state.stencil_offset, (5, 9))
+            assert_equal(expected, draw(state))
+            assert_equal(expected, draw(state.copy()))
+
+        # Parts of the stencil off the canvas are ignored
+        state = agg.GraphicsState(drawing_mode=fill, compact_stencil=True,
+                                  stencil_offset=(-3, -4))
+        state.stencil = agg.Image(small, gray8)
+        full[:] = 0
+        full[:8, :14] = small[4:, 3:]
+        expected = draw(agg.GraphicsState(drawing_mode=fill,
+                                          stencil=agg.Image(full, gray8)))
+        assert_equal(expected, draw(state))
@@ -0,0 +1,200 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+import unittest
+
+import numpy as np
+from numpy.testing import assert_equal
+
+import celiagg as agg
+
+
+def _draw_scene(target, size):
+    # `target` is either a canvas or a Picture. They share a drawing API.
+    transform = agg.Transform()
+    fill = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill)
+    eof_fill = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawEofFill,
+                                 anti_aliased=False)
+    stroke = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFillStroke,
+                               line_width=5.0, miter_limit=4.0,
+                               clip_box=agg.Rect(10.5, 12.25, 80, 70))
+    red = agg.SolidPaint(1.0, 0.0, 0.0, 0.5)
+    blue = agg.SolidPaint(0.0, 0.0, 1.0, 0.75)
+    gradient = agg.LinearGradientPaint(
+        0, 0, 1, 1, [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 1.0, 0.0, 1.0)],
+        agg.GradientSpread.SpreadPad, agg.GradientUnits.ObjectBoundingBox,
+    )
+
+    # A grid of small circles, with some overlaps and some off the canvas
+    circle = agg.Path()
+    circle.ellipse(0, 0, 3.3, 2.7)
+    for y in np.arange(-10, size + 10, 6.3):
+        for x in np.arange(-10, size + 10, 5.1):
+            transform = agg.Transform()
+            transform.translate(x, y)
+            paint = red if int(x) % 3 else blue
+            target.draw_shape(circle, transform, fill, fill=paint)
+            if int(y) % 4 == 0:
+                target.draw_shape(circle, transform, eof_fill, fill=paint)
+
+    star = agg.Path()
+    star.move_to(50, 5)
+    star.line_to(90, 95)
+    star.line_to(5, 35)
+    star.line_to(95, 35)
+    star.line_to(10, 95)
+    star.close()
+    target.draw_shape(star, agg.Transform(), stroke, stroke=blue,
+                      fill=gradient)
+    target.draw_shape(star, agg.Transform(), eof_fill, fill=red)
+    offscreen = agg.Transform()
+    offscreen.translate(size * 2, 0)
+    target.draw_shape(star, offscreen, stroke, stroke=blue, fill=gradient)
+
+    image = np.arange(16 * 16, dtype=np.uint8).reshape(16, 16)
+    transform = agg.Transform()
+    transform.translate(30, 40)
+    transform.rotate(0.3)
+    target.draw_image(image, agg.PixelFormat.Gray8, transform, fill)
+    transform.translate(-size, 0)
+    target.draw_image(image, agg.PixelFormat.Gray8, transform, fill)
+
+    if agg.HAS_TEXT:
+        with agg.example_font() as font_path:
+            font = agg.Font(font_path, 14.0)
+            for i in range(3):
+                transform = agg.Transform()
+                transform.translate(5, 20 + 25 * i)
+                target.draw_text('Picture', font, transform, fill, fill=blue)
+                target.draw_text('Picture', font, transform, stroke,
+                                 stroke=red, fill=blue)
+
+
+class TestPicture(unittest.TestCase):
+    def test_matches_direct_drawing(self):
+        size = 100
+        for klass, shape in ((agg.CanvasRGBA32, (size, size, 4)),
+                             (agg.CanvasRGB24, (size, size, 3)),
+                             (agg.CanvasG8, (size, size))):
+            picture = agg.Picture()
+            _draw_scene(picture, size)
+
+            for threads in (1, 4):
+                expected = klass(np.zeros(shape, dtype=np.uint8))
+                _draw_scene(expected, size)
+                canvas = klass(np.zeros(shape, dtype=np.uint8),
+                               threads=threads)
+                canvas.draw_picture(picture)
+                assert_equal(expected.array, canvas.array)
+
+                # Drawing again gives the same result
+                expected.clear(1, 1, 1)
+                _draw_scene(expected, size)
+                canvas.clear(1, 1, 1)
+                canvas.draw_picture(picture)
+                assert_equal(expected.array, canvas.array)
+
+    def test_references(self):
+        canvas = agg.CanvasG8(np.zeros((10, 10), dtype=np.uint8))
+        state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill,
+                                  anti_aliased=False)
+        paint = agg.SolidPaint(1.0, 1.0, 1.0)
+        path = agg.Path()
+        path.rect(0, 0, 5, 5)
+        transform = agg.Transform()
+
+        picture = agg.Picture()
+        picture.draw_shape(path, transform, state, fill=paint)
+        self.assertEqual(len(picture), 1)
+
+        # The transform is copied, but the shape is not
+        transform.translate(5, 5)
+        path.reset()
+        path.rect(0, 0, 10, 5)
+        canvas.draw_picture(picture)
+        expected = agg.CanvasG8(np.zeros((10, 10), dtype=np.uint8))
+        expected.draw_shape(path, agg.Transform(), state, fill=paint)
+        assert_equal(expected.array, canvas.array)
+
+        picture.clear()
+        self.assertEqual(len(picture), 0)
+        canvas.clear(0, 0, 0)
+        canvas.draw_picture(picture)
+        assert_equal(np.zeros((10, 10), dtype=np.uint8), canvas.array)
+
+    def test_converted_references(self):
+        # Images and paints converted to the canvas's pixel format still
+        # follow changes made to them after recording, once the images are
+        # invalidated
+        canvas = agg.CanvasRGB24(np.zeros((4, 8, 3), dtype=np.uint8))
+        state = agg.GraphicsState(drawing_mode=agg.DrawingMode.DrawFill,
+                                  image_filter=agg.ImageFilter.Nearest)
+        pixels = np.zeros((4, 4, 4), dtype=np.uint8)
+        pixels[..., 3] = 255
+        image = agg.Image(pixels, agg.PixelFormat.RGBA32)
+        pattern_image = agg.Image(pixels.copy(), agg.PixelFormat.RGBA32)
+        pattern = agg.PatternPaint(agg.PatternStyle.StyleRepeat,
+                                   pattern_image)
+        path = agg.Path()
+        path.rect(4, 0, 4, 4)
+
+        picture = agg.Picture()
+        picture.draw_image(image, None, agg.Transform(), state)
+        picture.draw_shape(path, agg.Transform(), state, fill=pattern)
+        canvas.draw_picture(picture)
+        assert_equal(canvas.array, 0)
+
+        pixels[..., 0] = 255
+        image.invalidate()
+        pattern_image.pixels = [0, 255, 0, 255]
+        canvas.draw_picture(picture)
+        assert_equal(canvas.array[:, :3], [[[255, 0, 0]] * 3] * 4)
+        assert_equal(canvas.array[:, 5:], [[[0, 255, 0]] * 3] * 4)
+
+    def test_stencil_size_mismatch(self):
+        # Stencils larger than the canvas are clipped to it
+        canvas = agg.CanvasRGB24(np.zeros((1, 2, 3), dtype=np.uint8))
+        stencil = np.array([[0, 255, 255]], dtype=np.uint8)
+        state = agg.GraphicsState(stencil=agg.Image(stencil,
+                                                    agg.PixelFormat.Gray8),
+                                  drawing_mode=agg.DrawingMode.DrawFill)
+        path = agg.Path()
+        path.rect(0, 0, 2, 1)
+        picture = agg.Picture()
+        picture.draw_shape(path, agg.Transform(), state,
+                           fill=agg.SolidPaint(1, 1, 1))
+
+        canvas.draw_picture(picture)
+        assert_equal([[[0, 0, 0], [255, 255, 255]]], canvas.array)
+
+    def test_bad_arguments(self):
+        canvas = agg.CanvasG8(np.zeros((10, 10), dtype=np.uint8))
+        picture = agg.Picture()
+        with self.assertRaises(TypeError):
+            canvas.draw_picture(None)
+        with self.assertRaises(TypeError):
+            picture.draw_shape(None, agg.Transform(), agg.GraphicsState())
+        with self.assertRaises(TypeError):
+            picture.draw_shape(agg.Path(), agg.Transform(), None)
+        with self.assertRaises(TypeError):
+            picture.draw_image(None, agg.PixelFormat.Gray8, agg.Transform(),
+                               agg.GraphicsState())
@@ -25,8 +25,9 @@ import unittest
 
 import numpy as np
 
-from celiagg import (GraphicsState, BlendMode, DrawingMode, Image, InnerJoin,
-                     LineCap, LineJoin, PixelFormat, Rect, TextDrawingMode)
+from celiagg import (GraphicsState, BlendMode, DrawingMode, Image,
+                     ImageFilter, InnerJoin, LineCap, LineJoin, PixelFormat,
+                     Rect, TextDrawingMode)
 
 
 def array_bases_equal(arr0, arr1):
@@ -67,6 +68,14 @@ class TestGraphicsState(unittest.TestCase):
         gs.anti_aliased = False
         self.assertFalse(gs.anti_aliased)
 
+        self.assertFalse(gs.fast_hairlines)
+        gs.fast_hairlines = True
+        self.assertTrue(gs.fast_hairlines)
+
+        self.assertFalse(gs.decimate_lines)
+        gs.decimate_lines = True
+        self.assertTrue(gs.decimate_lines)
+
         gs.drawing_mode = DrawingMode.DrawEofFill
         self.assertEqual(gs.drawing_mode, DrawingMode.DrawEofFill)
         gs.drawing_mode = DrawingMode.DrawFillStroke
@@ -89,6 +98,12 @@ class TestGraphicsState(unittest.TestCase):
         gs.image_blend_mode = BlendMode.BlendLighten
         self.assertEqual(gs.image_blend_mode, BlendMode.BlendLighten)
 
+        gs.image_filter = ImageFilter.Lanczos
+        self.assertEqual(gs.image_filter, ImageFilter.Lanczos)
+        self.assertEqual(gs.image_filter_radius, 4.0)
+        gs.image_filter_radius = 3.0
+        self.assertEqual(gs.image_filter_radius, 3.0)
+
         gs.line_cap = LineCap.CapSquare
         self.assertEqual(gs.line_cap, LineCap.CapSquare)
         gs.line_cap = LineCap.CapRound
@@ -150,6 +165,8 @@ class TestGraphicsState(unittest.TestCase):
         img = Image(np.zeros((10, 10), dtype=np.uint8), PixelFormat.Gray8)
         gs = GraphicsState(
             anti_aliased=True,
+            fast_hairlines=True,
+            decimate_lines=True,
             drawing_mode=DrawingMode.DrawEofFill,
             text_drawing_mode=TextDrawingMode.TextDrawFillStroke,
             blend_mode=BlendMode.BlendXor,
@@ -168,6 +185,8 @@ class TestGraphicsState(unittest.TestCase):
         )
 
         self.assertTrue(gs.anti_aliased)
+        self.assertTrue(gs.fast_hairlines)
+        self.assertTrue(gs.decimate_lines)
         self.assertEqual(gs.drawing_mode, DrawingMode.DrawEofFill)
         self.assertEqual(gs.text_drawing_mode,
                          TextDrawingMode.TextDrawFillStroke)
@@ -191,6 +210,8 @@ class TestGraphicsState(unittest.TestCase):
         img = Image(np.zeros((10, 10), dtype=np.uint8), PixelFormat.Gray8)
         gs = GraphicsState(
             anti_aliased=True,
+            fast_hairlines=True,
+            decimate_lines=True,
             drawing_mode=DrawingMode.DrawEofFill,
             text_drawing_mode=TextDrawingMode.TextDrawFillStroke,
             blend_mode=BlendMode.BlendXor,
@@ -210,6 +231,8 @@ class TestGraphicsState(unittest.TestCase):
         cpy = gs.copy()
 
         self.assertTrue(cpy.anti_aliased)
+        self.assertTrue(cpy.fast_hairlines)
+        self.assertTrue(cpy.decimate_lines)
         self.assertEqual(cpy.drawing_mode, DrawingMode.DrawEofFill)
         self.assertEqual(cpy.text_drawing_mode,
                          TextDrawingMode.TextDrawFillStroke)
@@ -0,0 +1,188 @@
+# The MIT License (MIT)
+#
+# Copyright (c) 2016-2021 Celiagg Contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+from concurrent.futures import ThreadPoolExecutor
+import os
+import time
+import unittest
+
+import numpy as np
+from numpy.testing import assert_equal
+
+import celiagg as agg
+
+CPU_COUNT = os.cpu_count() or 1
+# Timing tests are too noisy for shared CI machines, so they only run when
+# this is set.
+RUN_BENCHMARKS = bool(os.environ.get('CELIAGG_BENCHMARKS'))
+
+
+def _star(count, radius, cx, cy):
+    path = agg.Path()
+    angles = np.linspace(0, 2 * np.pi * (count // 2), count, endpoint=False)
+    path.move_to(cx + radius * np.cos(angles[0]),
+                 cy + radius * np.sin(angles[0]))
+    for a in angles[1:]:
+        path.line_to(cx + radius * np.cos(a), cy + radius * np.sin(a))
+    path.close()
+    return path
+
+
+def _render(state, transform, size=256, repeat=1):
+    # Shapes and paints are created per call. States and transforms are
+    # shared between threads.
+    canvas = agg.CanvasRGBA32(np.zeros((size, size, 4), dtype=np.uint8))
+    star = _star(101, size * 0.45, size / 2, size / 2)
+    stroke = agg.SolidPaint(0.0, 0.0, 1.0, 0.75)
+    fill = agg.LinearGradientPaint(
+        0, 0, size, size,
+        [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 1.0, 0.0, 1.0)],
+        agg.GradientSpread.SpreadPad, agg.GradientUnits.UserSpace,
+    )
+    for _ in range(repeat):
+        canvas.clear(1, 1, 1)
+        canvas.draw_shape(star, transform, state, stroke=stroke, fill=fill)
+    return canvas.array.copy()
+
+
+class TestThreadedDrawing(unittest.TestCase):
+    def setUp(self):
+        self.state = agg.GraphicsState(
+            drawing_mode=agg.DrawingMode.DrawFillStroke, line_width=3.0
+        )
+        self.transform = agg.Transform()
+
+    def test_results_match(self):
+        expected = _render(self.state, self.transform)
+        count = 8
+        with ThreadPoolExecutor(max_workers=count) as pool:
+            futures = [
+                pool.submit(_render, self.state, self.transform)
+                for _ in range(count)
+            ]
+            results = [f.result() for f in futures]
+
+        for result in results:
+            assert_equal(expected, result)
+
+    @unittest.skipIf(not agg.HAS_TEXT, 'Text support is not available')
+    def test_shared_font_cache(self):
+        font_cache = agg.FontCache()
+        state = agg.GraphicsState()
+        paint = agg.SolidPaint(0.0, 0.0, 0.0)
+        transform = agg.Transform()
+        transform.translate(4, 30)
+
+        with agg.example_font() as font_path:
+            font = agg.Font(font_path, 24.0)
+
+            def draw(text):
+                canvas = agg.CanvasG8(
+                    np.zeros((40, 200), dtype=np.uint8), font_cache=font_cache
+                )
+                for _ in range(20):
+                    canvas.clear(1, 1, 1)
+                    canvas.draw_text(text, font, transform, state, fill=paint)
+                return canvas.array.copy(), font_cache.width(font, text)
+
+            texts = ['Hello', 'threaded', 'world!'] * 4
+            expected = [draw(t) for t in texts]
+            with ThreadPoolExecutor(max_workers=4) as pool:
+                results = list(pool.map(draw, texts))
+
+        for (exp_array, exp_width), (array, width) in zip(expected, results):
+            assert_equal(exp_array, array)
+            self.assertEqual(exp_width, width)
+
+    @unittest.skipIf(not RUN_BENCHMARKS, 'Set CELIAGG_BENCHMARKS to run')
+    @unittest.skipIf(CPU_COUNT < 2, 'Needs more than one CPU')
+    def test_scaling(self):
+        workers = min(CPU_COUNT, 4)
+        args = (self.state, self.transform, 512, 20)
+
+        start = time.perf_counter()
+        for _ in range(workers):
+            _render(*args)
+        serial = time.perf_counter() - start
+
+        with ThreadPoolExecutor(max_workers=workers) as pool:
+            start = time.perf_counter()
+            futures = [pool.submit(_render, *args) for _ in range(workers)]
+            for f in futures:
+                f.result()
+            threaded = time.perf_counter() - start
+
+        # Drawing releases the GIL, so threads should beat serial drawing
+        speedup = serial / threaded
+        self.assertGreater(speedup, 0.5 * workers)
+
+
+class TestBandedDrawing(unittest.TestCase):
+    def _draw_scene(self, canvas):
+        size = canvas.width
+        star = _star(151, size * 0.48, size / 2, size / 2)
+        stops = [(0.0, 1.0, 0.0, 0.0, 1.0), (1.0, 0.0, 0.0, 1.0, 0.5)]
+        pattern = agg.PatternPaint(
+            agg.PatternStyle.StyleRepeat,
+            agg.Image(np.arange(64, dtype=np.uint8).reshape(8, 8),
+                      agg.PixelFormat.Gray8),
+        )
+        paints = [
+            agg.SolidPaint(0.2, 0.4, 0.6, 0.8),
+            agg.LinearGradientPaint(
+                0, 0, size, size, stops,
+                agg.GradientSpread.SpreadReflect, agg.GradientUnits.UserSpace,
+            ),
+            agg.RadialGradientPaint(
+                0.5, 0.5, 0.5, 0.3, 0.3, stops,
+                agg.GradientSpread.SpreadPad,
+                agg.GradientUnits.ObjectBoundingBox,
+            ),
+            pattern,
+        ]
+        transform = agg.Transform()
+        transform.rotate(0.1)
+        for anti_aliased in (True, False):
+            state = agg.GraphicsState(
+                drawing_mode=agg.DrawingMode.DrawFillStroke,
+                anti_aliased=anti_aliased, line_width=7.0,
+            )
+            for stroke, fill in zip(paints, paints[::-1]):
+                canvas.draw_shape(star, transform, state,
+                                  stroke=stroke, fill=fill)
+
+    def test_bit_identical(self):
+        for klass, shape in ((agg.CanvasRGBA32, (600, 600, 4)),
+                             (agg.CanvasRGB24, (600, 600, 3)),
+                             (agg.CanvasG8, (600, 600))):
+            serial = klass(np.zeros(shape, dtype=np.uint8))
+            banded = klass(np.zeros(shape, dtype=np.uint8), threads=4)
+            self.assertEqual(serial.threads, 1)
+            self.assertEqual(banded.threads, 4)
+
+            self._draw_scene(serial)
+            self._draw_scene(banded)
+            assert_equal(serial.array, banded.array)
+
+    def test_bad_thread_count(self):
+        with self.assertRaises(ValueError):
+            agg.CanvasRGB24(np.zeros((10, 10, 3), dtype=np.uint8), threads=0)
@@ -23,6 +23,8 @@
 //
 // Authors: John Wiggins
 
+#include <algorithm>
+
 #include <agg_bezier_arc.h>
 #include "vertex_source.h"
 
@@ -189,6 +191,100 @@ void PathSource::_normalize(double& x, double& y)
 
 // ----------------------------------------------------------------------------
 
+DecimatedSource::DecimatedSource(VertexSource& source, const agg::trans_affine& mtx)
+: m_source(&source)
+, m_mtx(mtx)
+, m_output_count(0)
+, m_output_pos(0)
+, m_column(0.0)
+, m_index(0)
+, m_in_run(false)
+{
+}
+
+void
+DecimatedSource::rewind(unsigned path_id)
+{
+    m_output_count = m_output_pos = 0;
+    m_index = 0;
+    m_in_run = false;
+    m_source->rewind(path_id);
+}
+
+unsigned
+DecimatedSource::vertex(double* x, double* y)
+{
+    for (;;)
+    {
+        if (m_output_pos < m_output_count)
+        {
+            const Vertex& out = m_output[m_output_pos++];
+            *x = out.x;
+            *y = out.y;
+            return out.cmd;
+        }
+        m_output_count = m_output_pos = 0;
+
+        Vertex vert;
+        vert.cmd = m_source->vertex(&vert.x, &vert.y);
+        if (!agg::is_vertex(vert.cmd))
+        {
+            // The end of a polygon or of the path
+            _flush_run();
+            m_output[m_output_count++] = vert;
+            continue;
+        }
+
+        double dev_x = vert.x;
+        vert.device_y = vert.y;
+        m_mtx.transform(&dev_x, &vert.device_y);
+        vert.index = m_index++;
+
+        const double column = std::floor(dev_x);
+        if (m_in_run && agg::is_line_to(vert.cmd) && column == m_column)
+        {
+            m_run[1] = vert;
+            if (vert.device_y < m_run[2].device_y) m_run[2] = vert;
+            if (vert.device_y > m_run[3].device_y) m_run[3] = vert;
+            continue;
+        }
+
+        _flush_run();
+        m_run[0] = m_run[1] = m_run[2] = m_run[3] = vert;
+        m_column = column;
+        m_in_run = true;
+    }
+}
+
+unsigned
+DecimatedSource::total_vertices() const
+{
+    return m_source->total_vertices();
+}
+
+void
+DecimatedSource::_flush_run()
+{
+    if (!m_in_run)
+    {
+        return;
+    }
+
+    Vertex run[4] = {m_run[0], m_run[1], m_run[2], m_run[3]};
+    std::sort(run, run + 4,
+              [](const Vertex& a, const Vertex& b) { return a.index < b.index; });
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == 0 || run[i].index != run[i-1].index)
+        {
+            m_output[m_output_count++] = run[i];
+        }
+    }
+    m_in_run = false;
+}
+
+// ----------------------------------------------------------------------------
+
 RepeatedSource::RepeatedSource(VertexSource& source, const double* points, const size_t point_count)
 : m_source(&source)
 , m_points(points, point_count, false, false)
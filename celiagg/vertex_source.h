@@ -115,6 +115,45 @@ private:
     const PathSource& operator=(const PathSource&);
 };
 
+// Reduces each run of line_to vertices which fall in the same device pixel
+// column to its first, last, lowest and highest vertex, in their original
+// order. Dense polylines look the same after this, but stroking them costs no
+// more than the number of columns they cross.
+class DecimatedSource : public VertexSource
+{
+    struct Vertex
+    {
+        double x, y;
+        double device_y;
+        size_t index;
+        unsigned cmd;
+    };
+
+    VertexSource* m_source;
+    agg::trans_affine m_mtx;
+    Vertex m_run[4];    // first, last, lowest, highest
+    Vertex m_output[5];
+    unsigned m_output_count;
+    unsigned m_output_pos;
+    double m_column;
+    size_t m_index;
+    bool m_in_run;
+
+public:
+    DecimatedSource(VertexSource& source, const agg::trans_affine& mtx);
+
+    virtual void        rewind(unsigned path_id);
+    virtual unsigned    vertex(double* x, double* y);
+    virtual unsigned    total_vertices() const;
+
+private:
+    void _flush_run();
+
+    // disable
+    DecimatedSource(const DecimatedSource&);
+    const DecimatedSource& operator=(const DecimatedSource&);
+};
+
 class RepeatedSource : public VertexSource
 {
     VertexSource* m_source;